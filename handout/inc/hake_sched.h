@@ -10,41 +10,246 @@
 #ifndef HAKE_SCHED_H
 #define HAKE_SCHED_H
 
+#include <stdio.h>
+#include <sys/types.h>
 #include "vm_settings.h"
 
+// Process State Bits [R,U,S,T,C] (upper 5 bits) and Exit Code (lower 27 bits)
+#define HAKE_STATE_READY      0x80000000
+#define HAKE_STATE_RUNNING    0x40000000
+#define HAKE_STATE_SUSPENDED  0x20000000
+#define HAKE_STATE_TERMINATED 0x10000000
+#define HAKE_STATE_CRITICAL   0x08000000
+#define HAKE_STATE_FLAGS      0xF8000000
+#define HAKE_STATE_EXIT_CODE  0x07FFFFFF
+
+// Ready Queue Engine Sizing (one bit per priority level, MIN_PRIORITY..MAX_PRIORITY)
+#define HAKE_LEVELS       (MAX_PRIORITY + 1)
+#define HAKE_BITMAP_WORDS ((HAKE_LEVELS + 63) / 64)
+
+// PID Index Sizing (open addressing, capacity is always a power of 2)
+#define HAKE_INDEX_MIN_CAPACITY 64
+
+// Node Arena Sizing (process nodes are carved from large chunks of cache-line aligned slots)
+#define HAKE_CACHE_LINE      64    // Slot alignment in bytes
+#define HAKE_INLINE_CMD      64    // Commands shorter than this are stored inside the node's slot
+#define HAKE_CHUNK_SLOTS     1024  // Slots per arena chunk
+#define HAKE_TEXT_CHUNK_SIZE 65536 // Bytes per chunk of interned (long) command strings
+
+// Scheduling Policies
+#define HAKE_DEFAULT_POLICY  "hake"        // Built-in policy every new schedule starts with
+#define HAKE_POLICY_SYMBOL   "hake_policy" // Hake_policy_s a policy shared object must export
+#define HAKE_MAX_POLICIES    16            // Built-in plus loaded policies
+#define HAKE_CFS_POLICY      "cfs"         // Built-in weighted fair share policy
+#define HAKE_NICE_0_WEIGHT   1024          // Fair share weight of DEFAULT_PRIORITY
+#define HAKE_SOA_POLICY      "soa"         // Built-in policy scanning packed keys with SIMD
+
+// Structure of Arrays Ready Set Sizing (keys pack class:2, priority:8, pid:HAKE_SOA_PID_BITS)
+#define HAKE_SOA_PID_BITS     22 // Linux PIDs are below 2^22 (PID_MAX_LIMIT)
+#define HAKE_SOA_MIN_CAPACITY 64 // Initial slots, always a multiple of the widest SIMD step
+#define HAKE_SOA_TICKETS      (1U << 30) // Starving tickets fit below the class bits
+
+// Earliest Deadline First (processes admitted with a deadline run EDF ahead of other Critical ones)
+#define HAKE_EDF_CAPACITY_PPM 1000000 // Admission limit per schedule: sum of runtime/deadline (1.0 = one CPU)
+#define HAKE_EDF_MIN_CAPACITY 16      // Initial size of the EDF heap
+
+// Adaptive Quantum (each process' slice follows how much of its last slice it used, within SLEEP_MIN_USEC..SLEEP_MAX_USEC)
+#define HAKE_QUANTUM_GROW_PCT   90 // Using at least this much of a slice on CPU doubles the next one
+#define HAKE_QUANTUM_SHRINK_PCT 50 // Using less than this much of a slice (blocking early) halves the next one
+
 // Process Node Definition
 typedef struct process_node {
   pid_t pid;          // PID of the Process you're Tracking
-  char *cmd;          // Name of the Process being run
+  char *cmd;          // Name of the Process being run (owned by the node arena, do not free)
   unsigned int state; // Contains the Process Flags [R,U,S,T,C] AND Exit Code
   int priority;       // The Priority Level of the Process
-  int age;            // How long this has been in the Ready Queue.
+  int age;            // How long this has been in the Ready Queue (see hake_get_age while Ready).
+  unsigned long enqueue_epoch; // Select epoch this process would have entered Ready at age 0.
+  long long start_ns; // Wall clock time (ns since the Unix epoch) the process was created.
+  long long end_ns;   // Wall clock time (ns since the Unix epoch) the process terminated.
+  long long first_run_ns; // Wall clock time (ns since the Unix epoch) it was first selected (0 until then).
+  int runs;               // Number of times the process has been selected to run.
+  long long run_start_ns; // Monotonic time (ns) the process was last selected to run.
+  long long last_run_ns;  // Length (ns) of its last run while hake_insert hands it to the policy off the CPU (0 otherwise).
+  long long quantum_ns;   // Its own slice length (ns), adapted by hake_adapt_quantum (0 until the first).
+  long long cpu_ns;       // CPU time (ns) measured over all of its slices so far (see hake_charge_cpu).
+  long long slice_cpu_ns; // CPU time (ns) measured over its last slice, or -1 if it was not measured.
+  long long ready_since_ns; // Monotonic time (ns) it last entered the Ready Queue (0 while not Ready).
+  long long wait_ns;        // Time (ns) spent Ready, waiting to be selected, over finished waits.
+  long long run_ns;         // Time (ns) it held the CPU (selected until inserted back or exited).
+  unsigned long long vruntime; // Weighted runtime (ns) charged by fair share policies.
+  long long deadline_ns;     // Relative deadline (ns) of each job, or 0 if the process has none.
+  long long runtime_ns;      // Expected runtime (ns) of each job, reserved at admission.
+  long long abs_deadline_ns; // Monotonic time (ns) the current job must finish by (0 before its first job).
+  long long job_ns;          // Runtime (ns) the current job has used so far.
+  int deadline_misses;       // Jobs that finished late or ran out of time before their deadline.
+  int edf_reserved;          // 1 while the process' utilization is reserved in a schedule.
+  int heap_slot;             // Position in the EDF heap or soa arrays while Ready there, otherwise -1.
+  unsigned int starving_ticket; // Order it started Starving in, while Ready under the soa policy.
   struct process_node *next; // Pointer to next Process Node in a linked list.
+  struct process_node *prev; // Pointer to previous Process Node in a doubly linked list.
+  struct process_node *age_next; // Pointer to next Process Node in the same aging wheel slot.
+  struct process_node *age_prev; // Pointer to previous Process Node in the same aging wheel slot.
+  struct process_node *left;     // Left child in a tree based policy's Ready tree.
+  struct process_node *right;    // Right child in a tree based policy's Ready tree.
+  struct process_node *parent;   // Parent in a tree based policy's Ready tree.
+  int red;                       // Node color in a red-black tree (1 for red, 0 for black).
 } Hake_process_s;
 
 // Queue Header Definition
 typedef struct queue_header {
   int count;            // How many Nodes are in this linked list?
   Hake_process_s *head; // Points to FIRST node of linked list.  No Dummy Nodes.
+  Hake_process_s *tail; // Points to LAST node of linked list (fast path for ordered appends).
 } Hake_queue_s;
 
+// Ready Lane Definition (doubly linked, ascending PID order, except the Starving lane which is FIFO)
+typedef struct ready_lane {
+  Hake_process_s *head; // Lowest PID in this lane (first to start Starving in the Starving lane).
+  Hake_process_s *tail; // Highest PID in this lane (fast path for appends).
+} Hake_lane_s;
+
+// Ready Queue Engine Definition (state of the default "hake" policy)
+// - Selection order: EDF heap, Critical lane, Starving lane, then lowest occupied priority level.
+// - The EDF heap holds Critical processes with a deadline, earliest absolute deadline on top.
+// - Every lane is kept in ascending PID order, except the Starving lane, which is kept in the order
+//   processes started Starving (a cohort starting together by PID), so the winner is always a heap top or lane head.
+// - Ages are lazy: a Ready process' age is (epoch - enqueue_epoch), with epoch counting selects.
+// - Priority level processes also sit in the aging wheel slot (enqueue_epoch % STARVING_AGE),
+//   so the slot that just reached STARVING_AGE is the only one checked on each select.
+typedef struct ready_engine {
+  Hake_lane_s critical;                              // Critical processes (any priority)
+  Hake_lane_s starving;                              // Non-critical processes with age >= STARVING_AGE
+  Hake_lane_s levels[HAKE_LEVELS];                   // One lane per priority level
+  unsigned long long occupied[HAKE_BITMAP_WORDS];    // Bit p is set when levels[p] is non-empty
+  unsigned long epoch;                               // Number of successful selects (plus STARVING_AGE)
+  Hake_process_s *wheel[STARVING_AGE];               // Aging wheel, one unordered list per epoch slot
+  Hake_process_s **edf;                              // EDF min-heap (by abs_deadline_ns, then pid)
+  int edf_count;                                     // Processes in the EDF heap
+  int edf_capacity;                                  // Slots allocated for the EDF heap
+} Hake_ready_s;
+
+// Fair Share Policy Definition (state of the "cfs" policy)
+// - Ready processes sit in a red-black tree ordered by (Critical first, vruntime, pid),
+//   except that Critical processes with deadlines go first, earliest deadline first.
+// - Each run is charged as runtime * HAKE_NICE_0_WEIGHT / weight, so heavier (higher priority)
+//   processes accumulate vruntime more slowly and are picked more often.
+// - Slices split CFS_LATENCY_USEC across the Ready processes in proportion to weight.
+typedef struct cfs_tree {
+  Hake_process_s *root;            // Root of the red-black tree
+  Hake_process_s *leftmost;        // Next process to run (cached for O(1) peeks)
+  unsigned long long min_vruntime; // Never decreases; floor for returning processes
+  long long total_weight;          // Sum of the weights in the tree
+  unsigned long epoch;             // Number of selects, so a Ready age is (epoch - enqueue_epoch)
+} Hake_cfs_s;
+
+// Structure of Arrays Ready Set Definition (state of the "soa" policy)
+// - Same selection order as the default policy, but deadlines are not used (EDF runs as Critical).
+// - Slot i holds one Ready process as parallel arrays, so a select is a branch free min reduction
+//   over 32 bit keys: (class << 30 | priority << HAKE_SOA_PID_BITS | pid), class 0 Critical,
+//   1 Starving (class << 30 | starving_ticket instead), 2 everything else.
+// - Tickets are handed out as processes start Starving (a cohort by PID), matching the default
+//   policy's Starving order, and are renumbered from 0 before they would run out.
+// - Slots count..capacity-1 hold padding keys (all bits set) so SIMD kernels never need a tail loop.
+// - Processes that could not get a slot (out of memory) wait in an overflow list instead.
+typedef struct soa_ready {
+  unsigned int *key;             // Key while not Starving
+  unsigned int *starving_key;    // Key once age >= STARVING_AGE (equal to key for Critical)
+  unsigned int *enqueue;         // Low 32 bits of each enqueue_epoch (ages subtract correctly across wraps)
+  Hake_process_s **nodes;        // The process in each slot
+  int count;                     // Slots in use
+  int capacity;                  // Slots allocated
+  Hake_process_s *listed;        // Process hake_ready_first last returned (listed first, then by slot)
+  unsigned long epoch;           // Number of selects, so a Ready age is (epoch - enqueue_epoch)
+  Hake_process_s *wheel[STARVING_AGE]; // Aging wheel of processes not yet Starving (as in the default policy)
+  unsigned int next_ticket;      // Next Starving ticket to hand out (see starving_ticket)
+  Hake_process_s *overflow;      // Ready processes without a slot (unordered, linked by next/prev)
+  int (*argmin)(const struct soa_ready *soa); // Kernel returning the slot with the lowest key, or -1
+  const char *kernel;            // Name of that kernel ("avx2", "sse4.1", or "scalar")
+} Hake_soa_s;
+
+// PID Index Definition (open addressing with linear probing, no tombstones)
+// - Maps each tracked PID to its node, whichever queue it is in (or on the CPU).
+typedef struct pid_index {
+  int capacity;           // Number of slots (power of 2)
+  int count;              // Number of occupied slots
+  Hake_process_s **slots; // NULL marks an empty slot; the key is slots[i]->pid
+} Hake_index_s;
+
+// Terminated Queue Retention Definition
+// - Only the most recent keep Terminated processes stay in memory; older ones are archived.
+typedef struct terminated_archive {
+  int keep;             // Max Terminated processes kept in the Terminated Queue
+  int retained;         // Terminated processes currently in the Terminated Queue
+  int archived;         // Terminated processes evicted from the Terminated Queue
+  FILE *log;            // Append-only CSV archive of evicted processes (NULL to drop them)
+  char path[MAX_PATH];  // Path of the CSV archive
+} Hake_archive_s;
+
+// Scheduling Policy Definition
+// - A policy owns the Ready Queue: where Ready processes are kept and which one runs next.
+// - Each schedule holds its own policy data, made with create and released with destroy.
+// - The Ready process links (next, prev, age_next, age_prev, enqueue_epoch) belong to the policy.
+// - A shared object policy exports a const Hake_policy_s named HAKE_POLICY_SYMBOL.
+typedef struct hake_policy {
+  const char *name;                                             // Unique name used to switch to it
+  void *(*create)();                                            // New, empty policy data (NULL on error)
+  void (*destroy)(void *data);                                  // Frees policy data (nodes are not freed)
+  void (*insert)(void *data, Hake_process_s *process);          // Adds a Ready process, keeping its age
+  Hake_process_s *(*select)(void *data);                        // Removes and returns the next to run
+  void (*remove)(void *data, Hake_process_s *process);          // Removes a Ready process, updating its age
+  void (*tick)(void *data);                                     // Called after every successful select
+  Hake_process_s *(*first)(void *data);                         // First Ready process in selection order
+  Hake_process_s *(*next)(void *data, Hake_process_s *process); // Following Ready process, or NULL
+  int (*age_of)(void *data, Hake_process_s *process);           // Optional, current age of a Ready process
+  long long (*slice)(void *data, Hake_process_s *process);      // Optional, run length (ns) for a selected process
+  int (*outranks)(void *data, Hake_process_s *ready, Hake_process_s *running); // Optional, 1 if ready should preempt running
+  Hake_process_s *(*drain)(void *data); // Optional, removes every Ready process, returned in selection order through age_next
+} Hake_policy_s;
+
 // Schedule Header Definition
 typedef struct hake_schedule {
-  Hake_queue_s *ready_queue;      // Linked List of Processes ready to Run on CPU
+  Hake_queue_s *ready_queue;      // Count of Processes ready to Run on CPU (nodes live in the policy)
+  const Hake_policy_s *policy;    // Scheduling Policy holding the Ready Processes
+  void *policy_data;              // This schedule's policy data
   Hake_queue_s *suspended_queue;  // Linked List of Suspended Processes
-  Hake_queue_s *terminated_queue; // Linked List of Terminated Processes 
+  Hake_queue_s *terminated_queue; // Linked List of Terminated Processes (count includes archived)
+  Hake_index_s *index;            // PID to Process lookup across all Queues
+  Hake_archive_s *archive;        // Retention policy for the Terminated Queue
+  int edf_util_ppm;               // Reserved EDF utilization (parts per million of one CPU)
+  int edf_misses;                 // Deadline misses of every process this schedule has run
 } Hake_schedule_s;
 
 // Prototypes
 Hake_schedule_s *hake_create();
 Hake_process_s *hake_new_process(char *command, pid_t pid, int priority, int is_critical);
+void hake_free_process(Hake_process_s *process);
 int hake_insert(Hake_schedule_s *schedule, Hake_process_s *process);
 int hake_get_count(Hake_queue_s *queue);
 Hake_process_s *hake_select(Hake_schedule_s *schedule);
 int hake_suspend(Hake_schedule_s *header, pid_t pid);
 int hake_resume(Hake_schedule_s *header, pid_t pid);
-int hake_exited(Hake_schedule_s *schedule, Hake_process_s *process, int exit_code);
-int hake_terminated(Hake_schedule_s *schedule, pid_t pid, int exit_code);
+int hake_exited(Hake_schedule_s *schedule, Hake_process_s *process, int exit_code); // May free process (keep == 0)
+int hake_terminated(Hake_schedule_s *schedule, pid_t pid, int exit_code); // May free the process (keep == 0)
+int hake_detach(Hake_schedule_s *schedule, Hake_process_s *process);
 void hake_deallocate(Hake_schedule_s *schedule);
+int hake_set_retention(Hake_schedule_s *schedule, int keep, const char *archive_path);
+Hake_process_s *hake_find(Hake_schedule_s *schedule, pid_t pid);
+int hake_get_age(Hake_schedule_s *schedule, Hake_process_s *process);
+Hake_process_s *hake_ready_first(Hake_schedule_s *schedule);
+Hake_process_s *hake_ready_next(Hake_schedule_s *schedule, Hake_process_s *process);
+int hake_register_policy(const Hake_policy_s *policy);
+const Hake_policy_s *hake_load_policy(const char *path);
+const Hake_policy_s *hake_get_policy(const char *name);
+const Hake_policy_s *hake_get_policy_at(int index);
+int hake_set_policy(Hake_schedule_s *schedule, const Hake_policy_s *policy);
+long long hake_get_slice(Hake_schedule_s *schedule, Hake_process_s *process);
+long long hake_adapt_quantum(Hake_process_s *process, long long base_ns, long long ran_ns, long long cpu_ns);
+int hake_charge_cpu(Hake_process_s *process, long long total_cpu_ns);
+long long hake_get_wait(Hake_process_s *process);
+int hake_outranks(Hake_schedule_s *schedule, Hake_process_s *ready, Hake_process_s *running);
+const char *hake_set_soa_kernel(const char *name);
+void hake_set_clock(long long (*clock_ns)());
+int hake_admit(Hake_schedule_s *schedule, Hake_process_s *process, long long deadline_ns, long long runtime_ns);
 
 #endif
@@ -21,6 +21,8 @@ typedef struct process_data {
   int is_critical;          // 1 If the process is run with critical permissions
   pid_t pid;                // OS Generated, Guaranteed Unique
   struct process_data *next;// Singly Linked List
+  long long deadline_ns;    // Relative deadline from -d (0 for none); kept after next for the library
+  long long runtime_ns;     // Expected runtime per deadline from -e (0 for the runtime quantum)
 } Process_data_s;
 
 // Prototypes
@@ -0,0 +1,50 @@
+/* vm_record.h (Trilby VM Session Recorder)
+ *
+ *   Records what drove a VM session (started with: ./vm -R file) to a compact binary file:
+ *   every shell command, process start and exit, suspend, resume, and terminate, and every
+ *   start and stop of the CS system, each stamped with the monotonic time since recording began.
+ *   sim_hake -R file replays a recording against any policy and settings on its virtual clock.
+ *
+ *   File: RECORD_MAGIC, then Record_event_s events in time order, each followed by len bytes
+ *   of text (not NUL terminated).
+ */
+#ifndef VM_RECORD_H
+#define VM_RECORD_H
+
+#include <sys/types.h>
+
+#define RECORD_MAGIC     "TRILBYR1" // First 8 bytes of every recording (the 1 is the format version)
+#define RECORD_MAGIC_LEN 8
+
+// Record Event Types
+enum record_events {
+  RECORD_BEGIN,     // Recording began (arg: CPUs, value: runtime quantum in ns, text: policy)
+  RECORD_COMMAND,   // A line entered at the shell (text: the line)
+  RECORD_START,     // A process was added to the schedule (arg: priority, arg2: 1 if critical, text: command)
+  RECORD_EXIT,      // A process exited (arg: exit code, arg2: times selected, value: CPU ns, value2: Ready ns)
+  RECORD_SUSPEND,   // The shell suspended a process (pid 0 is the default process)
+  RECORD_RESUME,    // The shell resumed a process (pid 0 is the default process)
+  RECORD_TERMINATE, // The shell terminated a process (its exit follows)
+  RECORD_CS_START,  // The CS system started
+  RECORD_CS_STOP,   // The CS system stopped
+  NUM_RECORD_EVENTS
+};
+
+// Record Event Definition (fixed size, any text follows it in the file)
+typedef struct record_event {
+  long long ns;        // Monotonic time (ns) since the recording began
+  long long value;     // Type specific detail (see enum record_events)
+  long long value2;
+  pid_t pid;           // Process it is about (0 if none)
+  int arg;
+  int arg2;
+  unsigned short type; // One of enum record_events
+  unsigned short len;  // Bytes of text that follow
+} Record_event_s;
+
+// Prototypes
+int record_open(const char *path);
+void record_event(int type, pid_t pid, int arg, int arg2, long long value, long long value2, const char *text);
+void record_close();
+
+#endif
@@ -24,15 +24,47 @@
 #define MAX_PRIORITY 255
 #define STARVING_AGE 5           // If age >= STARVING_AGE, it's starving
 
+// Context Switch CPUs (each CPU has its own dispatcher thread and local Ready Queue)
+#define DEFAULT_CPUS 1   // Number of CPUs, override with: ./vm -n <cpus>
+#define MAX_CPUS     64  // Upper limit for -n
+#define PIN_CHILDREN 0   // Set to 1 to also pin each child to its CPU's host core while it runs (dispatchers are always pinned)
+
+// Terminated Queue Retention (older records are appended to TERMINATED_LOG as CSV)
+#define TERMINATED_KEEP 64                      // Terminated Processes kept in memory
+#define TERMINATED_LOG  "trilby_terminated.csv" // Set to NULL to drop older records instead
+
+// Accounting Statistics (shown by the stats command, and rewritten periodically as Prometheus text)
+#define STATS_FILE          "trilby_stats.prom" // Set to NULL to not write the file
+#define STATS_INTERVAL_USEC 5000000             // 5000000 = 5 sec between rewrites
+
+// Scheduler Event Trace (a ring per recording thread, written out as Chrome JSON by: trace dump <file>)
+#define TRACE_RING_EVENTS 16384          // Events kept per thread, a power of 2 (older ones are overwritten)
+#define TRACE_MAX_RINGS   (MAX_CPUS + 4) // Threads that can record (the dispatchers and the shell)
+
 // Time to run each Process for between Context Switching
 #define SLEEP_USEC        250000 //   250000 = 250ms
 #define SLEEP_MIN_USEC    100000 //   100000 = 100ms
 #define SLEEP_MAX_USEC  10000000 // 10000000 = 10sec
+#define ADAPTIVE_QUANTUM       1 // 1 lets each process' slice adapt within MIN..MAX, 0 gives every process the runtime
 
 // Time to wait between Context Switches before Running Next Process
 #define BETWEEN_USEC      1000000 //  1000000 =  1000ms = 1 sec
 #define BETWEEN_MIN_USEC   100000 //   100000 =   100ms = 0.1 sec
 #define BETWEEN_MAX_USEC 10000000 // 10000000 = 10000ms = 10 sec
+#define PIPELINED_DISPATCH 1      // 1 switches straight to the next process, 0 waits the Between time (debugging)
+
+// Confirming each stop (the next process only runs once the last one is seen stopped)
+#define STOP_CONFIRM_USEC 2000 // 2000 = 2ms for SIGTSTP to take, then again for SIGSTOP
+#define STOP_POLL_USEC      20 //   20 = 20us between checks of /proc/<pid>/stat
+
+// Watching the running child, to end its slice early once it blocks (eg. in sleep)
+#define BLOCK_POLL_USEC       5000 //   5000 =   5ms between checks of /proc/<pid>/stat (0 = off)
+#define BLOCK_POLL_MIN_USEC   1000 //   1000 =   1ms
+#define BLOCK_POLL_MAX_USEC 100000 // 100000 = 100ms
+
+// Fair Share (cfs) Policy: each Ready process runs once per latency period, weighted by priority
+#define CFS_LATENCY_USEC   1000000        // Target period for every Ready process to run once
+#define CFS_MIN_SLICE_USEC SLEEP_MIN_USEC // Shortest slice, however many processes are Ready
 
 
 //////////////////////////////////////////////////////////////////////
@@ -59,6 +59,9 @@ void print_trilby_banner();
 void print_hake_debug(Hake_schedule_s *schedule, Hake_process_s *on_cpu);
 void print_schedule(Hake_schedule_s *schedule, Hake_process_s *on_cpu);
 void print_hake_queue(Hake_queue_s *queue);
+void print_hake_ready(Hake_schedule_s *schedule);
 void print_process_node(Hake_process_s *node);
+long long monotonic_ns();
+long long extract_duration(const char *str, char **end);
 
 #endif
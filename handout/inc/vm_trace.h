@@ -0,0 +1,41 @@
+/* vm_trace.h (Trilby VM Scheduler Event Trace)
+ *
+ *   Always-on binary trace of what the scheduler did, kept in one fixed-size ring per thread,
+ *   and converted to Chrome trace JSON (for Perfetto or chrome://tracing) by the trace command.
+ */
+#ifndef VM_TRACE_H
+#define VM_TRACE_H
+
+#include <sys/types.h>
+
+// Trace Event Types
+enum trace_events {
+  TRACE_INSERT,    // Put in a Ready Queue (arg: priority)
+  TRACE_SELECT,    // Selected to run (arg: 1 if stolen from another CPU, 2 if reselected in place)
+  TRACE_SUSPEND,   // Moved to the Suspended Queue
+  TRACE_RESUME,    // Moved back to Ready from the Suspended Queue
+  TRACE_EXIT,      // Left the CPU it was running on for good (arg: exit code)
+  TRACE_TERMINATE, // Terminated while in a Ready or Suspended Queue (arg: exit code)
+  TRACE_SIGCONT,   // Sent SIGCONT to start its slice
+  TRACE_SIGTSTP,   // Sent SIGTSTP to end its slice
+  TRACE_IDLE,      // The CPU found nothing to run and parked
+  TRACE_WAKE,      // The CPU woke up from idle
+  NUM_TRACE_EVENTS
+};
+
+// Trace Event Definition (fixed size, so recording one is a few stores)
+typedef struct trace_event {
+  long long ns;        // Monotonic time (ns) it was recorded
+  pid_t pid;           // Process it is about (0 if none)
+  int arg;             // Type specific detail (see enum trace_events)
+  short cpu;           // CPU it happened on (-1 if none)
+  unsigned char type;  // One of enum trace_events
+} Trace_event_s;
+
+// Prototypes
+void trace_event(int type, int cpu, pid_t pid, int arg);
+void trace_clear();
+int trace_dump(const char *path);
+void print_trace_status();
+
+#endif
@@ -0,0 +1,396 @@
+/* bench_hake.c (Hake Scheduler Benchmarks, built and run with: make bench)
+ *
+ *   Usage: ./bench_hake [policies|api]  (both tables if neither is given)
+ *   Like test_hake_sched.c, this runs the Hake library without any of the TRILBY code.
+ *
+ *   policies: Times the Ready Queue policies the way the dispatcher drives them: with N processes
+ *   Ready, each operation is one hake_select followed by hake_insert of the chosen process.
+ *   The mixed workload spreads priorities and makes 1% Critical; the single one puts every process
+ *   at DEFAULT_PRIORITY, as the VM does unless told otherwise.
+ *   One row per policy, workload, and size, whitespace separated, for comparing runs:
+ *     policy kernel mix entries ns_per_op ops
+ *
+ *   api: Times each Hake API call on its own against a queue of N (10 to 1M) Ready processes,
+ *   making the calls in random, ascending, descending, or clustered (runs of consecutive) PID order.
+ *   The rest of the queue is set up untimed, so every call sees a full-size steady state queue.
+ *   One row per call, order, and size:
+ *     function order entries ns_per_op allocs_per_op peak_rss_kb ops
+ *   - allocs_per_op counts malloc, calloc, realloc, and posix_memalign calls (wrapped at link time).
+ *   - peak_rss_kb is the peak resident set since the round of calls began (VmHWM, reset each round).
+ */
+
+/* Standard Library Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+/* Local Includes */
+#include "hake_sched.h"
+#include "vm_support.h"
+
+/* Globals (static means it's private to this file only) */
+int g_debug_mode = 0; // Keeps the library quiet while timing
+static long long bench_allocs = 0; // Allocation calls so far (counted by the __wrap_ functions)
+
+#define BENCH_MIN_NS  250000000LL // Time each case for at least this long
+#define BENCH_MIN_OPS 16          // and for at least this many operations
+#define BENCH_BATCH   16          // Operations between clock reads
+#define BENCH_API_SAMPLE  1024    // Calls timed per round against a queue of N (all of them if N is smaller)
+#define BENCH_API_MIN_OPS 65536   // API rounds repeat until each call has been timed this often
+#define BENCH_CLUSTER 64          // PIDs in each run of the clustered order
+
+// The API calls timed, in the order each round makes them
+enum bench_calls {
+  CALL_NEW_PROCESS, CALL_INSERT, CALL_SUSPEND, CALL_RESUME, CALL_TERMINATED, CALL_SELECT,
+  CALL_EXITED, CALL_DEALLOCATE, NUM_CALLS
+};
+static const char *bench_call_names[NUM_CALLS] = {
+  "hake_new_process", "hake_insert", "hake_suspend", "hake_resume", "hake_terminated", "hake_select",
+  "hake_exited", "hake_deallocate"
+};
+
+// PID orders
+enum bench_orders { ORDER_RANDOM, ORDER_ASCENDING, ORDER_DESCENDING, ORDER_CLUSTERED, NUM_ORDERS };
+static const char *bench_order_names[NUM_ORDERS] = { "random", "ascending", "descending", "clustered" };
+
+// Totals for one API call over every round of a case
+typedef struct bench_total {
+  long long ns;
+  long long allocs;
+  long long ops;
+  long peak_kb;
+} Bench_total_s;
+
+/* Local Prototypes */
+static unsigned int bench_random(unsigned int *seed);
+static void bench_policies();
+static void bench_select_insert(const char *policy, const char *kernel, int single, int entries);
+static void bench_api();
+static void bench_fill_pids(pid_t *pids, int entries, int order, unsigned int *seed);
+static int bench_compare_pids(const void *a, const void *b);
+static void bench_make_processes(Hake_process_s **nodes, pid_t *pids, int entries, unsigned int *seed);
+static void bench_api_round(Hake_process_s **nodes, pid_t *pids, pid_t *sorted, int entries, Bench_total_s *totals);
+static void bench_peak_reset();
+static long bench_peak_kb();
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+int __real_posix_memalign(void **ptr, size_t alignment, size_t size);
+
+int main(int argc, char *argv[]) {
+  const char *table = (argc > 1) ? argv[1] : NULL;
+
+  if(table != NULL && strcmp(table, "policies") != 0 && strcmp(table, "api") != 0) {
+    fprintf(stderr, "Usage: %s [policies|api]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  if(table == NULL || strcmp(table, "policies") == 0) {
+    bench_policies();
+  }
+  if(table == NULL) {
+    printf("\n");
+  }
+  if(table == NULL || strcmp(table, "api") == 0) {
+    bench_api();
+  }
+  return 0;
+}
+
+/* Counting allocators: the Makefile links with --wrap, so every allocation call (Hake's included) comes here first. */
+void *__wrap_malloc(size_t size) {
+  bench_allocs++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  bench_allocs++;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  bench_allocs++;
+  return __real_realloc(ptr, size);
+}
+
+int __wrap_posix_memalign(void **ptr, size_t alignment, size_t size) {
+  bench_allocs++;
+  return __real_posix_memalign(ptr, alignment, size);
+}
+
+/* Prints the policies table: select and insert pairs under each policy (and soa kernel). */
+static void bench_policies() {
+  const int sizes[] = {64, 1024, 65536, 1048576};
+  const char *kernels[] = {"scalar", "sse4.1", "avx2"};
+  int i = 0;
+  int k = 0;
+  int single = 0;
+
+  printf("%-8s %-8s %-6s %10s %12s %10s\n", "policy", "kernel", "mix", "entries", "ns_per_op", "ops");
+  for(single = 0; single <= 1; single++) {
+    for(i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+      bench_select_insert(HAKE_DEFAULT_POLICY, "lanes", single, sizes[i]);
+      for(k = 0; k < (int)(sizeof(kernels) / sizeof(kernels[0])); k++) {
+        // Kernels this CPU lacks fall back to another one, which is already on the table
+        if(strcmp(hake_set_soa_kernel(kernels[k]), kernels[k]) == 0) {
+          bench_select_insert(HAKE_SOA_POLICY, kernels[k], single, sizes[i]);
+        }
+      }
+    }
+  }
+  hake_set_soa_kernel(NULL);
+}
+
+/* Returns the next value of a small deterministic generator (xorshift32), so every run sees the same workload. */
+static unsigned int bench_random(unsigned int *seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+}
+
+/* Fills a schedule with entries Ready processes (random priorities and 1% Critical, or all at
+ *   DEFAULT_PRIORITY if single), then times select and insert pairs and prints one row.
+ * - With far more Ready processes than selects, nearly all of them are Starving in steady state,
+ *   so the schedule starts out that way (filled in PID order, which is also the fastest fill).
+ */
+static void bench_select_insert(const char *policy, const char *kernel, int single, int entries) {
+  Hake_schedule_s *header = hake_create();
+  unsigned int seed = 2463534242U;
+  long long start = 0;
+  long long elapsed = 0;
+  long long ops = 0;
+  int i = 0;
+
+  if(header == NULL || hake_set_policy(header, hake_get_policy(policy)) != 0) {
+    ABORT_ERROR("...could not set up the benchmark schedule!");
+  }
+  for(i = 0; i < entries; i++) {
+    int priority = bench_random(&seed) % MAX_PRIORITY + 1;
+    int critical = bench_random(&seed) % 100 == 0;
+    Hake_process_s *process = hake_new_process("bench", i + 1, single ? DEFAULT_PRIORITY : priority, critical && !single);
+    if(process != NULL) {
+      process->age = STARVING_AGE + bench_random(&seed) % STARVING_AGE;
+    }
+    if(hake_insert(header, process) != 0) {
+      ABORT_ERROR("...hake_insert failed while filling the benchmark schedule!");
+    }
+  }
+
+  start = monotonic_ns();
+  while(ops < BENCH_MIN_OPS || elapsed < BENCH_MIN_NS) {
+    for(i = 0; i < BENCH_BATCH; i++) {
+      hake_insert(header, hake_select(header));
+    }
+    ops += BENCH_BATCH;
+    elapsed = monotonic_ns() - start;
+  }
+  printf("%-8s %-8s %-6s %10d %12.1f %10lld\n", policy, kernel, single ? "single" : "mixed", entries,
+      (double)elapsed / ops, ops);
+  fflush(stdout);
+
+  hake_deallocate(header);
+}
+
+/* Prints the API table: every call, under every PID order, at queue sizes from 10 to 1M. */
+static void bench_api() {
+  const int sizes[] = {10, 100, 1000, 10000, 100000, 1000000};
+  const int largest = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+  Hake_process_s **nodes = malloc(largest * sizeof(Hake_process_s *));
+  pid_t *pids = malloc(largest * sizeof(pid_t));
+  pid_t *sorted = malloc((largest + BENCH_API_SAMPLE) * sizeof(pid_t)); // Room for the PIDs a round exits
+  unsigned int seed = 2463534242U;
+
+  if(nodes == NULL || pids == NULL || sorted == NULL) {
+    ABORT_ERROR("...out of memory for the API benchmark!");
+  }
+  printf("%-16s %-10s %8s %12s %13s %11s %8s\n", "function", "order", "entries", "ns_per_op", "allocs_per_op",
+      "peak_rss_kb", "ops");
+  for(int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+    for(int order = 0; order < NUM_ORDERS; order++) {
+      Bench_total_s totals[NUM_CALLS];
+      long long start_ns = monotonic_ns();
+      int sample = (sizes[i] < BENCH_API_SAMPLE) ? sizes[i] : BENCH_API_SAMPLE;
+
+      memset(totals, 0, sizeof(totals));
+      bench_fill_pids(pids, sizes[i], order, &seed);
+      // The untimed part of the queue goes in by rising PID, so setting it up stays linear
+      memcpy(sorted, pids + sample, (sizes[i] - sample) * sizeof(pid_t));
+      qsort(sorted, sizes[i] - sample, sizeof(pid_t), bench_compare_pids);
+      // Small queues are run again and again, so each call is timed over enough operations
+      do {
+        bench_api_round(nodes, pids, sorted, sizes[i], totals);
+      } while(totals[CALL_INSERT].ops < BENCH_API_MIN_OPS && monotonic_ns() - start_ns < BENCH_MIN_NS);
+
+      for(int call = 0; call < NUM_CALLS; call++) {
+        printf("%-16s %-10s %8d %12.1f %13.3f %11ld %8lld\n", bench_call_names[call], bench_order_names[order],
+            sizes[i], (double)totals[call].ns / totals[call].ops, (double)totals[call].allocs / totals[call].ops,
+            totals[call].peak_kb, totals[call].ops);
+      }
+      fflush(stdout);
+    }
+  }
+  free(nodes);
+  free(pids);
+  free(sorted);
+}
+
+/* Fills pids with entries distinct PIDs in the given order.
+ * - clustered: runs of BENCH_CLUSTER consecutive PIDs, far apart, with the runs in random order.
+ */
+static void bench_fill_pids(pid_t *pids, int entries, int order, unsigned int *seed) {
+  for(int i = 0; i < entries; i++) {
+    switch(order) {
+      case ORDER_DESCENDING: pids[i] = entries - i; break;
+      case ORDER_CLUSTERED:  pids[i] = (i / BENCH_CLUSTER) * 4096 + i % BENCH_CLUSTER + 1; break;
+      default:               pids[i] = i + 1; break;
+    }
+  }
+  // Random shuffles single PIDs; clustered shuffles whole runs
+  if(order == ORDER_RANDOM) {
+    for(int i = entries - 1; i > 0; i--) {
+      int j = bench_random(seed) % (i + 1);
+      pid_t swap = pids[i];
+      pids[i] = pids[j];
+      pids[j] = swap;
+    }
+  }
+  else if(order == ORDER_CLUSTERED) {
+    int runs = entries / BENCH_CLUSTER; // A short last run stays where it is
+    for(int i = runs - 1; i > 0; i--) {
+      int j = bench_random(seed) % (i + 1);
+      for(int k = 0; k < BENCH_CLUSTER; k++) {
+        pid_t swap = pids[i * BENCH_CLUSTER + k];
+        pids[i * BENCH_CLUSTER + k] = pids[j * BENCH_CLUSTER + k];
+        pids[j * BENCH_CLUSTER + k] = swap;
+      }
+    }
+  }
+}
+
+/* qsort comparison for PIDs in ascending order. */
+static int bench_compare_pids(const void *a, const void *b) {
+  pid_t pid_a = *(const pid_t *)a;
+  pid_t pid_b = *(const pid_t *)b;
+  return (pid_a > pid_b) - (pid_a < pid_b);
+}
+
+/* Makes a process for each PID (random priorities, 1% Critical), untimed. */
+static void bench_make_processes(Hake_process_s **nodes, pid_t *pids, int entries, unsigned int *seed) {
+  for(int i = 0; i < entries; i++) {
+    nodes[i] = hake_new_process("bench", pids[i], bench_random(seed) % MAX_PRIORITY + 1, bench_random(seed) % 100 == 0);
+    if(nodes[i] == NULL) {
+      ABORT_ERROR("...hake_new_process failed!");
+    }
+  }
+}
+
+/* Times one pass of a call over count operations, adding it to its total. */
+#define BENCH_TIME(total, count, loop) do {  \
+  long long allocs_ = bench_allocs;           \
+  long long start_ = monotonic_ns();        \
+  loop;                                       \
+  (total).ns += monotonic_ns() - start_;    \
+  (total).allocs += bench_allocs - allocs_;   \
+  (total).ops += (count);                     \
+  long peak_kb_ = bench_peak_kb();            \
+  if(peak_kb_ > (total).peak_kb) {            \
+    (total).peak_kb = peak_kb_;               \
+  }                                           \
+} while(0)
+
+/* Runs one round of every API call against a queue of entries Ready processes.
+ * - The first BENCH_API_SAMPLE PIDs (in pids order) are the timed ones; the rest (sorted) fill the
+ *   queue up untimed and are aged once, so the queue looks like one that has been running a while.
+ * - new_process is timed for every process, and deallocate per process of a full queue.
+ */
+static void bench_api_round(Hake_process_s **nodes, pid_t *pids, pid_t *sorted, int entries, Bench_total_s *totals) {
+  Hake_schedule_s *header = NULL;
+  Hake_process_s *process = NULL;
+  int sample = (entries < BENCH_API_SAMPLE) ? entries : BENCH_API_SAMPLE;
+  unsigned int seed = 88675123U;
+  int i = 0;
+
+  bench_peak_reset();
+  BENCH_TIME(totals[CALL_NEW_PROCESS], entries, for(i = 0; i < entries; i++) {
+    nodes[i] = hake_new_process("bench", (i < sample) ? pids[i] : sorted[i - sample],
+        bench_random(&seed) % MAX_PRIORITY + 1, bench_random(&seed) % 100 == 0);
+  });
+  header = hake_create();
+  if(header == NULL || nodes[entries - 1] == NULL) {
+    ABORT_ERROR("...could not set up the benchmark schedule!");
+  }
+  for(i = sample; i < entries; i++) {
+    hake_insert(header, nodes[i]);
+  }
+  for(i = 0; i < STARVING_AGE && (process = hake_select(header)) != NULL; i++) {
+    hake_insert(header, process);
+  }
+
+  BENCH_TIME(totals[CALL_INSERT], sample, for(i = 0; i < sample; i++) {
+    hake_insert(header, nodes[i]);
+  });
+  BENCH_TIME(totals[CALL_SUSPEND], sample, for(i = 0; i < sample; i++) {
+    hake_suspend(header, pids[i]);
+  });
+  BENCH_TIME(totals[CALL_RESUME], sample, for(i = 0; i < sample; i++) {
+    hake_resume(header, pids[i]);
+  });
+  BENCH_TIME(totals[CALL_TERMINATED], sample, for(i = 0; i < sample; i++) {
+    hake_terminated(header, pids[i], 0);
+  });
+
+  // Select and exit a sample's worth, whichever processes the policy picks
+  bench_make_processes(nodes, pids, sample, &seed);
+  for(i = 0; i < sample; i++) {
+    hake_insert(header, nodes[i]);
+  }
+  BENCH_TIME(totals[CALL_SELECT], sample, for(i = 0; i < sample; i++) {
+    nodes[i] = hake_select(header);
+  });
+  for(i = 0; i < sample; i++) {
+    if(nodes[i] == NULL) {
+      ABORT_ERROR("...hake_select came up empty!");
+    }
+    sorted[entries + i] = nodes[i]->pid; // Spare room past the sorted PIDs
+  }
+  BENCH_TIME(totals[CALL_EXITED], sample, for(i = 0; i < sample; i++) {
+    hake_exited(header, nodes[i], 0);
+  });
+
+  // Refill the queue with the PIDs that exited, so deallocate frees a full one
+  bench_make_processes(nodes, sorted + entries, sample, &seed);
+  for(i = 0; i < sample; i++) {
+    hake_insert(header, nodes[i]);
+  }
+  if(hake_get_count(header->ready_queue) != entries) {
+    ABORT_ERROR("...the benchmark schedule lost processes!");
+  }
+  BENCH_TIME(totals[CALL_DEALLOCATE], entries, hake_deallocate(header));
+}
+
+/* Resets the peak resident set (VmHWM) to the current one, if the kernel allows it. */
+static void bench_peak_reset() {
+  FILE *file = fopen("/proc/self/clear_refs", "w");
+  if(file != NULL) {
+    fputs("5", file);
+    fclose(file);
+  }
+}
+
+/* Returns the peak resident set (VmHWM) in KB, or 0 if it can't be read. */
+static long bench_peak_kb() {
+  char line[128];
+  long peak_kb = 0;
+  FILE *file = fopen("/proc/self/status", "r");
+
+  if(file == NULL) {
+    return 0;
+  }
+  while(fgets(line, sizeof(line), file) != NULL) {
+    if(sscanf(line, "VmHWM: %ld", &peak_kb) == 1) {
+      break;
+    }
+  }
+  fclose(file);
+  return peak_kb;
+}
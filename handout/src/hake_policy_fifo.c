@@ -0,0 +1,95 @@
+/* hake_policy_fifo.c (Example Hake Scheduling Policy, built as a shared object)
+ *
+ *   Plain round robin: processes run in the order they became Ready, ignoring priority,
+ *   criticality, and starvation.  Load it in the VM with:  policy ./hake_policy_fifo.so
+ *
+ *   Any policy follows the same pattern: implement the Hake_policy_s hooks using only the
+ *   Ready process links (next, prev, enqueue_epoch), then export them as HAKE_POLICY_SYMBOL.
+ */
+
+/* Standard Library Includes */
+#include <stdlib.h>
+/* Local Includes */
+#include "hake_sched.h"
+
+/* Policy data: one queue in arrival order, and a select counter for lazy ages. */
+typedef struct fifo_data {
+  Hake_process_s *head;  // Next process to run
+  Hake_process_s *tail;  // Most recently Ready process
+  unsigned long epoch;   // Number of selects, so a Ready age is (epoch - enqueue_epoch)
+} Fifo_data_s;
+
+static void *fifo_create() {
+  return calloc(1, sizeof(Fifo_data_s)); // Backdating below epoch 0 wraps, but ages still subtract correctly
+}
+
+static void fifo_destroy(void *data) {
+  free(data);
+}
+
+/* Appends to the tail, backdating the enqueue epoch so the process keeps its age. */
+static void fifo_insert(void *data, Hake_process_s *process) {
+  Fifo_data_s *fifo = data;
+
+  process->enqueue_epoch = fifo->epoch - process->age;
+  process->next = NULL;
+  process->prev = fifo->tail;
+  if(fifo->tail != NULL) {
+    fifo->tail->next = process;
+  }
+  else {
+    fifo->head = process;
+  }
+  fifo->tail = process;
+}
+
+/* Unlinks a process in O(1), bringing its age member up to date. */
+static void fifo_remove(void *data, Hake_process_s *process) {
+  Fifo_data_s *fifo = data;
+
+  if(process->prev != NULL) {
+    process->prev->next = process->next;
+  }
+  else {
+    fifo->head = process->next;
+  }
+  if(process->next != NULL) {
+    process->next->prev = process->prev;
+  }
+  else {
+    fifo->tail = process->prev;
+  }
+  process->next = NULL;
+  process->prev = NULL;
+  process->age = (int)(fifo->epoch - process->enqueue_epoch);
+}
+
+static Hake_process_s *fifo_select(void *data) {
+  Hake_process_s *head = ((Fifo_data_s *)data)->head;
+  if(head != NULL) {
+    fifo_remove(data, head);
+  }
+  return head;
+}
+
+static void fifo_tick(void *data) {
+  ((Fifo_data_s *)data)->epoch++;
+}
+
+static Hake_process_s *fifo_first(void *data) {
+  return ((Fifo_data_s *)data)->head;
+}
+
+static Hake_process_s *fifo_next(void *data, Hake_process_s *process) {
+  return process->next;
+}
+
+static int fifo_age_of(void *data, Hake_process_s *process) {
+  return (int)(((Fifo_data_s *)data)->epoch - process->enqueue_epoch);
+}
+
+/* The symbol the Hake library looks up after dlopen */
+const Hake_policy_s hake_policy = {
+  "fifo", fifo_create, fifo_destroy, fifo_insert, fifo_select,
+  fifo_remove, fifo_tick, fifo_first, fifo_next, fifo_age_of
+};
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
+#include <time.h>
 /* Unix System Includes */
 #include <unistd.h>
 #include <sys/types.h>
@@ -37,6 +38,11 @@
 #include <sys/time.h>
 #include <pthread.h>
 #include <sched.h>
+#include <dlfcn.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAKE_SOA_X86 1 // SIMD kernels are built with target attributes and picked at runtime
+#endif
 /* Local Includes */
 #include "hake_sched.h"
 #include "vm_support.h"
@@ -44,6 +50,1974 @@
 
 /* Feel free to create any helper functions you like! */
 
+#if STARVING_AGE < 1
+ #error "STARVING_AGE must be at least 1 (it sizes the aging wheel)"
+#endif
+
+/* Node Arena Definitions
+ * - Every node lives in a cache-line aligned slot, with room for a short command inline.
+ * - Long commands are interned, so identical strings share one copy.
+ * - The arena is shared by all live schedules and released in one step with the last of them.
+ */
+typedef union hake_slot {
+    struct {
+        Hake_process_s node;         // Must be first, so a node pointer is its slot pointer
+        char cmd[HAKE_INLINE_CMD];   // Inline storage for short commands
+    } used;
+    union hake_slot *next_free;      // Free list link while the slot is unused
+} __attribute__((aligned(HAKE_CACHE_LINE))) Hake_slot_s;
+
+typedef struct hake_chunk {
+    struct hake_chunk *next;         // Singly linked list of all slot chunks
+    Hake_slot_s slots[HAKE_CHUNK_SLOTS];
+} Hake_chunk_s;
+
+typedef struct hake_text {
+    struct hake_text *next;          // Singly linked list of all string chunks
+    size_t used;                     // Bytes handed out from data
+    char data[];
+} Hake_text_s;
+
+typedef struct hake_arena {
+    pthread_mutex_t lock;            // Nodes may be created and freed from different threads
+    int users;                       // Number of live schedules sharing the arena
+    Hake_chunk_s *chunks;            // Head chunk is the one being carved
+    int carved;                      // Slots handed out from the head chunk so far
+    Hake_slot_s *free_slots;         // Slots returned by hake_free_process
+    Hake_text_s *text;               // Head chunk is the one being carved
+    char **strings;                  // Open addressing set of interned long commands
+    int string_capacity;             // Number of string slots (power of 2)
+    int string_count;                // Number of interned strings
+} Hake_arena_s;
+
+static Hake_arena_s g_arena = { PTHREAD_MUTEX_INITIALIZER, 0, NULL, HAKE_CHUNK_SLOTS, NULL, NULL, NULL, 0, 0 };
+
+/* Local Helper Prototypes */
+static Hake_slot_s *arena_alloc_slot();
+static unsigned int arena_hash(const char *command, size_t length);
+static char *arena_intern(const char *command, size_t length);
+static int arena_grow_strings();
+static void arena_release();
+static long long wall_clock_ns();
+static long long monotonic_clock_ns();
+static void set_state_flag(Hake_process_s *process, unsigned int flag);
+static void queue_insert_ordered(Hake_queue_s *queue, Hake_process_s *process);
+static void queue_unlink(Hake_queue_s *queue, Hake_process_s *process);
+static void queue_remove(Hake_queue_s *queue, Hake_process_s *process);
+static void queue_append(Hake_queue_s *queue, Hake_process_s *process);
+static int index_home(Hake_index_s *index, pid_t pid);
+static Hake_process_s *index_find(Hake_index_s *index, pid_t pid);
+static int index_grow(Hake_index_s *index);
+static int index_put(Hake_index_s *index, Hake_process_s *process);
+static void index_delete(Hake_index_s *index, Hake_process_s *process);
+static void archive_write(Hake_archive_s *archive, Hake_process_s *process);
+static void terminated_evict(Hake_schedule_s *schedule);
+static void terminated_add(Hake_schedule_s *schedule, Hake_process_s *process, int exit_code);
+static void lane_insert(Hake_lane_s *lane, Hake_process_s *process);
+static void lane_append(Hake_lane_s *lane, Hake_process_s *process);
+static void lane_remove(Hake_lane_s *lane, Hake_process_s *process);
+static int ready_age_of(Hake_ready_s *ready, Hake_process_s *process);
+static Hake_lane_s *ready_lane_of(Hake_ready_s *ready, Hake_process_s *process);
+static void wheel_push(Hake_process_s **wheel, Hake_process_s *process);
+static void wheel_remove(Hake_process_s **wheel, Hake_process_s *process);
+static int pid_before(Hake_process_s *a, Hake_process_s *b);
+static Hake_process_s *age_list_sort(Hake_process_s *list, int (*before)(Hake_process_s *, Hake_process_s *));
+static int ready_first_level(Hake_ready_s *ready, int from);
+static void ready_enqueue(Hake_ready_s *ready, Hake_process_s *process);
+static void ready_dequeue(Hake_ready_s *ready, Hake_process_s *process);
+static Hake_process_s *ready_peek(Hake_ready_s *ready);
+static Hake_process_s *ready_lowest_pid(Hake_ready_s *ready);
+static Hake_process_s *ready_next(Hake_ready_s *ready, Hake_process_s *process);
+static void ready_add(Hake_schedule_s *schedule, Hake_process_s *process, long long now);
+static void ready_leave(Hake_process_s *process, long long now);
+static void ready_tick(Hake_ready_s *ready);
+static int edf_before(Hake_process_s *a, Hake_process_s *b);
+static void edf_place(Hake_ready_s *ready, Hake_process_s *process, int slot);
+static void edf_sift_up(Hake_ready_s *ready, int slot);
+static void edf_sift_down(Hake_ready_s *ready, int slot);
+static int edf_push(Hake_ready_s *ready, Hake_process_s *process);
+static void edf_remove(Hake_ready_s *ready, Hake_process_s *process);
+static int edf_utilization(Hake_process_s *process);
+static void edf_reserve(Hake_schedule_s *schedule, Hake_process_s *process);
+static void edf_unreserve(Hake_schedule_s *schedule, Hake_process_s *process);
+static void edf_release_job(Hake_process_s *process, long long now);
+static void edf_account(Hake_schedule_s *schedule, Hake_process_s *process, long long now);
+static void *policy_hake_create();
+static void policy_hake_destroy(void *data);
+static void policy_hake_insert(void *data, Hake_process_s *process);
+static Hake_process_s *policy_hake_select(void *data);
+static void policy_hake_remove(void *data, Hake_process_s *process);
+static void policy_hake_tick(void *data);
+static Hake_process_s *policy_hake_first(void *data);
+static Hake_process_s *policy_hake_next(void *data, Hake_process_s *process);
+static int policy_hake_age_of(void *data, Hake_process_s *process);
+static int policy_hake_outranks(void *data, Hake_process_s *ready, Hake_process_s *running);
+static Hake_process_s *policy_lowest_pid(Hake_schedule_s *schedule);
+static int rank_outranks(Hake_process_s *ready, Hake_process_s *running, int by_deadline, int by_priority);
+static int cfs_weight(int priority);
+static int cfs_before(Hake_process_s *a, Hake_process_s *b);
+static void rb_rotate_left(Hake_cfs_s *cfs, Hake_process_s *x);
+static void rb_rotate_right(Hake_cfs_s *cfs, Hake_process_s *x);
+static void rb_transplant(Hake_cfs_s *cfs, Hake_process_s *u, Hake_process_s *v);
+static Hake_process_s *rb_minimum(Hake_process_s *node);
+static Hake_process_s *rb_next(Hake_process_s *node);
+static void rb_insert(Hake_cfs_s *cfs, Hake_process_s *process);
+static void rb_erase(Hake_cfs_s *cfs, Hake_process_s *process);
+static void rb_erase_fixup(Hake_cfs_s *cfs, Hake_process_s *x, Hake_process_s *x_parent);
+static void *policy_cfs_create();
+static void policy_cfs_destroy(void *data);
+static void policy_cfs_insert(void *data, Hake_process_s *process);
+static Hake_process_s *policy_cfs_select(void *data);
+static void policy_cfs_remove(void *data, Hake_process_s *process);
+static void policy_cfs_tick(void *data);
+static Hake_process_s *policy_cfs_first(void *data);
+static Hake_process_s *policy_cfs_next(void *data, Hake_process_s *process);
+static int policy_cfs_age_of(void *data, Hake_process_s *process);
+static long long policy_cfs_slice(void *data, Hake_process_s *process);
+static int policy_cfs_outranks(void *data, Hake_process_s *ready, Hake_process_s *running);
+static unsigned int soa_key(Hake_process_s *process);
+static unsigned int soa_starving_key(Hake_process_s *process);
+static int ticket_before(Hake_process_s *a, Hake_process_s *b);
+static int soa_drained_before(Hake_process_s *a, Hake_process_s *b);
+static void soa_reserve_tickets(Hake_soa_s *soa, unsigned int count, unsigned int min_age);
+static unsigned int soa_live_key(const Hake_soa_s *soa, Hake_process_s *process);
+static int soa_argmin_scalar(const Hake_soa_s *soa);
+#ifdef HAKE_SOA_X86
+static int soa_argmin_sse41(const Hake_soa_s *soa);
+static int soa_argmin_avx2(const Hake_soa_s *soa);
+#endif
+static void soa_detect_kernel();
+static void soa_pad(Hake_soa_s *soa, int from);
+static int soa_grow(Hake_soa_s *soa);
+static void soa_place(Hake_soa_s *soa, Hake_process_s *process, int slot);
+static Hake_process_s *soa_best(Hake_soa_s *soa);
+static void *policy_soa_create();
+static void policy_soa_destroy(void *data);
+static void policy_soa_insert(void *data, Hake_process_s *process);
+static Hake_process_s *policy_soa_select(void *data);
+static void policy_soa_remove(void *data, Hake_process_s *process);
+static void policy_soa_tick(void *data);
+static Hake_process_s *policy_soa_first(void *data);
+static Hake_process_s *policy_soa_next(void *data, Hake_process_s *process);
+static int policy_soa_age_of(void *data, Hake_process_s *process);
+static int policy_soa_outranks(void *data, Hake_process_s *ready, Hake_process_s *running);
+static Hake_process_s *policy_soa_drain(void *data);
+
+/* Default Scheduling Policy (the Ready Queue Engine)
+ * - Critical first, then Starving, then lowest priority value; ties go to the lowest PID.
+ * - Starving processes run in the order they started Starving (those starting together by PID).
+ */
+static const Hake_policy_s g_hake_policy = {
+    HAKE_DEFAULT_POLICY, policy_hake_create, policy_hake_destroy, policy_hake_insert, policy_hake_select,
+    policy_hake_remove, policy_hake_tick, policy_hake_first, policy_hake_next, policy_hake_age_of, NULL,
+    policy_hake_outranks
+};
+
+/* Weighted Fair Share Scheduling Policy (red-black tree keyed by vruntime)
+ * - Critical first, then the lowest vruntime; ties go to the lowest PID.
+ */
+static const Hake_policy_s g_cfs_policy = {
+    HAKE_CFS_POLICY, policy_cfs_create, policy_cfs_destroy, policy_cfs_insert, policy_cfs_select,
+    policy_cfs_remove, policy_cfs_tick, policy_cfs_first, policy_cfs_next, policy_cfs_age_of, policy_cfs_slice,
+    policy_cfs_outranks
+};
+
+/* Structure of Arrays Scheduling Policy (packed keys, min reduced with the widest SIMD the CPU has)
+ * - Same order as the default policy without EDF: Critical, then Starving (in the order they started),
+ *   then lowest priority value; ties go to the lowest PID.
+ */
+static const Hake_policy_s g_soa_policy = {
+    HAKE_SOA_POLICY, policy_soa_create, policy_soa_destroy, policy_soa_insert, policy_soa_select,
+    policy_soa_remove, policy_soa_tick, policy_soa_first, policy_soa_next, policy_soa_age_of, NULL,
+    policy_soa_outranks, policy_soa_drain
+};
+
+/* Min reduction kernels for the soa policy, widest first (the first one the CPU supports is the default) */
+typedef struct soa_kernel {
+    const char *name;                        // Name for hake_set_soa_kernel and the benchmarks
+    const char *feature;                     // __builtin_cpu_supports feature, or NULL if always available
+    int (*argmin)(const Hake_soa_s *soa);
+} Hake_soa_kernel_s;
+
+static const Hake_soa_kernel_s g_soa_kernels[] = {
+#ifdef HAKE_SOA_X86
+    { "avx2", "avx2", soa_argmin_avx2 },
+    { "sse4.1", "sse4.1", soa_argmin_sse41 },
+#endif
+    { "scalar", NULL, soa_argmin_scalar }
+};
+#define HAKE_SOA_KERNELS ((int)(sizeof(g_soa_kernels) / sizeof(g_soa_kernels[0])))
+
+static pthread_once_t g_soa_detect = PTHREAD_ONCE_INIT;
+static const Hake_soa_kernel_s *g_soa_best = NULL;   // Widest kernel this CPU supports (set once)
+static const Hake_soa_kernel_s *g_soa_kernel = NULL; // Kernel new soa ready sets use
+
+// Clock every schedule reads (NULL reads the system clocks), set with hake_set_clock
+static long long (*g_clock)() = NULL;
+
+/* Fair share weights, one per 5% CPU step (the Linux nice -20..19 table), index 20 is DEFAULT_PRIORITY */
+static const int g_cfs_weights[40] = {
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,  3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,   335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,    36,    29,    23,    18,    15
+};
+
+/* Policy Registry (built-in policies first, then any registered or loaded ones) */
+typedef struct hake_registry {
+    pthread_mutex_t lock;            // Policies may be looked up and loaded from different threads
+    int count;                       // Number of registered policies
+    const Hake_policy_s *policies[HAKE_MAX_POLICIES];
+} Hake_registry_s;
+
+static Hake_registry_s g_registry = {
+    PTHREAD_MUTEX_INITIALIZER, 3, { &g_hake_policy, &g_cfs_policy, &g_soa_policy }
+};
+
+/* Returns an unused slot from the free list or the current chunk (caller holds the arena lock).
+ * - Only when the current chunk is used up does this allocate, one chunk for HAKE_CHUNK_SLOTS nodes.
+ * Returns NULL on allocation errors.
+ */
+static Hake_slot_s *arena_alloc_slot() {
+    Hake_slot_s *slot = g_arena.free_slots;
+
+    if (slot != NULL) {
+        g_arena.free_slots = slot->next_free;
+        return slot;
+    }
+    if (g_arena.carved == HAKE_CHUNK_SLOTS) {
+        Hake_chunk_s *chunk = NULL;
+        if (posix_memalign((void **)&chunk, HAKE_CACHE_LINE, sizeof(Hake_chunk_s)) != 0) {
+            return NULL;
+        }
+        chunk->next = g_arena.chunks;
+        g_arena.chunks = chunk;
+        g_arena.carved = 0;
+    }
+    return &g_arena.chunks->slots[g_arena.carved++];
+}
+
+/* Returns the FNV-1a hash of a command string. */
+static unsigned int arena_hash(const char *command, size_t length) {
+    unsigned int hash = 2166136261u;
+    size_t i = 0;
+
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)command[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* Doubles the interned string set and rehashes it (caller holds the arena lock).
+ * Returns a 0 on success or a -1 on any error.
+ */
+static int arena_grow_strings() {
+    int capacity = (g_arena.string_capacity == 0) ? HAKE_INDEX_MIN_CAPACITY : g_arena.string_capacity * 2;
+    char **strings = (char **)calloc(capacity, sizeof(char *));
+    int i = 0;
+
+    if (strings == NULL) {
+        return -1;
+    }
+    for (i = 0; i < g_arena.string_capacity; i++) {
+        if (g_arena.strings[i] != NULL) {
+            unsigned int hash = arena_hash(g_arena.strings[i], strlen(g_arena.strings[i]));
+            int slot = (int)(hash & (unsigned int)(capacity - 1));
+            while (strings[slot] != NULL) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            strings[slot] = g_arena.strings[i];
+        }
+    }
+    free(g_arena.strings);
+    g_arena.strings = strings;
+    g_arena.string_capacity = capacity;
+    return 0;
+}
+
+/* Returns the shared copy of a long command, copying it into the text chunks on first use
+ * (caller holds the arena lock).
+ * Returns NULL on allocation errors.
+ */
+static char *arena_intern(const char *command, size_t length) {
+    int slot = 0;
+    char *copy = NULL;
+
+    if ((g_arena.string_count + 1) * 2 > g_arena.string_capacity && arena_grow_strings() == -1) {
+        return NULL;
+    }
+
+    // Linear probing for an identical string
+    slot = (int)(arena_hash(command, length) & (unsigned int)(g_arena.string_capacity - 1));
+    while (g_arena.strings[slot] != NULL) {
+        if (strcmp(g_arena.strings[slot], command) == 0) {
+            return g_arena.strings[slot];
+        }
+        slot = (slot + 1) & (g_arena.string_capacity - 1);
+    }
+
+    // First use, carve a copy out of the current text chunk (or a new one)
+    if (g_arena.text == NULL || g_arena.text->used + length + 1 > HAKE_TEXT_CHUNK_SIZE) {
+        size_t size = (length + 1 > HAKE_TEXT_CHUNK_SIZE) ? length + 1 : HAKE_TEXT_CHUNK_SIZE;
+        Hake_text_s *text = (Hake_text_s *)malloc(sizeof(Hake_text_s) + size);
+        if (text == NULL) {
+            return NULL;
+        }
+        text->used = 0;
+        // An oversized string gets a chunk of its own behind the current one
+        if (g_arena.text != NULL && size > HAKE_TEXT_CHUNK_SIZE) {
+            text->next = g_arena.text->next;
+            g_arena.text->next = text;
+        } else {
+            text->next = g_arena.text;
+            g_arena.text = text;
+        }
+        copy = text->data;
+        text->used = length + 1;
+    } else {
+        copy = g_arena.text->data + g_arena.text->used;
+        g_arena.text->used += length + 1;
+    }
+    memcpy(copy, command, length + 1);
+
+    g_arena.strings[slot] = copy;
+    g_arena.string_count++;
+    return copy;
+}
+
+/* Frees every chunk of the arena at once (caller holds the arena lock). */
+static void arena_release() {
+    while (g_arena.chunks != NULL) {
+        Hake_chunk_s *next = g_arena.chunks->next;
+        free(g_arena.chunks);
+        g_arena.chunks = next;
+    }
+    while (g_arena.text != NULL) {
+        Hake_text_s *next = g_arena.text->next;
+        free(g_arena.text);
+        g_arena.text = next;
+    }
+    free(g_arena.strings);
+    g_arena.strings = NULL;
+    g_arena.string_capacity = 0;
+    g_arena.string_count = 0;
+    g_arena.carved = HAKE_CHUNK_SLOTS;
+    g_arena.free_slots = NULL;
+}
+
+/* Returns the wall clock time in nanoseconds since the Unix epoch. */
+static long long wall_clock_ns() {
+    struct timespec now;
+
+    if (g_clock != NULL) {
+        return g_clock();
+    }
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/* Returns the monotonic clock time in nanoseconds (for measuring runs). */
+static long long monotonic_clock_ns() {
+    if (g_clock != NULL) {
+        return g_clock();
+    }
+    return monotonic_ns();
+}
+
+/* Clears the R, U, S, and T bits and sets the given one.
+ * - The Critical bit and the Exit Code are left unchanged.
+ */
+static void set_state_flag(Hake_process_s *process, unsigned int flag) {
+    process->state = (process->state & (HAKE_STATE_CRITICAL | HAKE_STATE_EXIT_CODE)) | flag;
+}
+
+/* Inserts a process into a Queue in Ascending PID Order and updates the count.
+ * - Walks backwards from the tail, so appending a new (higher) PID is O(1).
+ */
+static void queue_insert_ordered(Hake_queue_s *queue, Hake_process_s *process) {
+    Hake_process_s *after = queue->tail;
+
+    while (after != NULL && after->pid > process->pid) {
+        after = after->prev;
+    }
+
+    process->prev = after;
+    if (after == NULL) {
+        // Insert at the beginning of the Queue
+        process->next = queue->head;
+        queue->head = process;
+    } else {
+        // Insert after 'after'
+        process->next = after->next;
+        after->next = process;
+    }
+
+    if (process->next == NULL) {
+        queue->tail = process;
+    } else {
+        process->next->prev = process;
+    }
+    queue->count++;
+}
+
+/* Unlinks a process from a Queue in O(1), leaving the count alone. */
+static void queue_unlink(Hake_queue_s *queue, Hake_process_s *process) {
+    if (process->prev != NULL) {
+        process->prev->next = process->next;
+    } else {
+        queue->head = process->next;
+    }
+    if (process->next != NULL) {
+        process->next->prev = process->prev;
+    } else {
+        queue->tail = process->prev;
+    }
+    process->next = NULL;
+    process->prev = NULL;
+}
+
+/* Unlinks a process from a Queue in O(1) and updates the count. */
+static void queue_remove(Hake_queue_s *queue, Hake_process_s *process) {
+    queue_unlink(queue, process);
+    queue->count--;
+}
+
+/* Appends a process to the tail of a Queue in O(1) and updates the count. */
+static void queue_append(Hake_queue_s *queue, Hake_process_s *process) {
+    process->next = NULL;
+    process->prev = queue->tail;
+    if (queue->tail != NULL) {
+        queue->tail->next = process;
+    } else {
+        queue->head = process;
+    }
+    queue->tail = process;
+    queue->count++;
+}
+
+/* Returns the home slot of a pid (Fibonacci hashing, folded to the table size). */
+static int index_home(Hake_index_s *index, pid_t pid) {
+    unsigned int hash = (unsigned int)pid * 2654435761u;
+
+    return (int)((hash ^ (hash >> 16)) & (unsigned int)(index->capacity - 1));
+}
+
+/* Returns the indexed process with matching pid, or NULL if it is not tracked. */
+static Hake_process_s *index_find(Hake_index_s *index, pid_t pid) {
+    int slot = index_home(index, pid);
+
+    while (index->slots[slot] != NULL) {
+        if (index->slots[slot]->pid == pid) {
+            return index->slots[slot];
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    return NULL;
+}
+
+/* Doubles the capacity of the index and rehashes every entry.
+ * Returns a 0 on success or a -1 on any error.
+ */
+static int index_grow(Hake_index_s *index) {
+    Hake_process_s **old_slots = index->slots;
+    int old_capacity = index->capacity;
+    int i = 0;
+
+    index->slots = (Hake_process_s **)calloc(old_capacity * 2, sizeof(Hake_process_s *));
+    if (index->slots == NULL) {
+        index->slots = old_slots;
+        return -1;
+    }
+    index->capacity = old_capacity * 2;
+
+    for (i = 0; i < old_capacity; i++) {
+        if (old_slots[i] != NULL) {
+            int slot = index_home(index, old_slots[i]->pid);
+            while (index->slots[slot] != NULL) {
+                slot = (slot + 1) & (index->capacity - 1);
+            }
+            index->slots[slot] = old_slots[i];
+        }
+    }
+    free(old_slots);
+    return 0;
+}
+
+/* Adds a process to the index, replacing any entry with the same pid.
+ * - The table is kept at most half full so probe runs stay short.
+ * Returns a 0 on success or a -1 on any error.
+ */
+static int index_put(Hake_index_s *index, Hake_process_s *process) {
+    int slot = 0;
+
+    if ((index->count + 1) * 2 > index->capacity && index_grow(index) == -1) {
+        return -1;
+    }
+
+    slot = index_home(index, process->pid);
+    while (index->slots[slot] != NULL && index->slots[slot]->pid != process->pid) {
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    if (index->slots[slot] == NULL) {
+        index->count++;
+    }
+    index->slots[slot] = process;
+    return 0;
+}
+
+/* Inserts a process into a Ready Lane in Ascending PID Order.
+ * - Walks in from both ends at once, so it costs the distance from the closer end: O(1) both for
+ *   appending a new (higher) PID and for re-inserting the lowest PID the dispatcher just selected.
+ */
+static void lane_insert(Hake_lane_s *lane, Hake_process_s *process) {
+    Hake_process_s *before = lane->head;
+    Hake_process_s *after = lane->tail;
+
+    // before walks forward to the first higher PID, after walks back to the last lower one
+    while (after != NULL && after->pid > process->pid && before->pid < process->pid) {
+        before = before->next;
+        after = after->prev;
+    }
+    if (after != NULL && after->pid > process->pid) {
+        after = before->prev; // The forward walk got there first
+    }
+
+    process->prev = after;
+    if (after == NULL) {
+        // New lowest PID, becomes the head
+        process->next = lane->head;
+        lane->head = process;
+    } else {
+        process->next = after->next;
+        after->next = process;
+    }
+
+    if (process->next == NULL) {
+        lane->tail = process;
+    } else {
+        process->next->prev = process;
+    }
+}
+
+/* Appends a process at the tail of a Ready Lane in O(1) (the Starving lane is kept in arrival order). */
+static void lane_append(Hake_lane_s *lane, Hake_process_s *process) {
+    process->next = NULL;
+    process->prev = lane->tail;
+    if (lane->tail == NULL) {
+        lane->head = process;
+    } else {
+        lane->tail->next = process;
+    }
+    lane->tail = process;
+}
+
+/* Unlinks a process from a Ready Lane in O(1). */
+static void lane_remove(Hake_lane_s *lane, Hake_process_s *process) {
+    if (process->prev != NULL) {
+        process->prev->next = process->next;
+    } else {
+        lane->head = process->next;
+    }
+    if (process->next != NULL) {
+        process->next->prev = process->prev;
+    } else {
+        lane->tail = process->prev;
+    }
+    process->next = NULL;
+    process->prev = NULL;
+}
+
+/* Returns the current age of a Ready process from the select epoch. */
+static int ready_age_of(Hake_ready_s *ready, Hake_process_s *process) {
+    return (int)(ready->epoch - process->enqueue_epoch);
+}
+
+/* Returns the Ready Lane a process belongs in based on its Critical bit, age, and priority. */
+static Hake_lane_s *ready_lane_of(Hake_ready_s *ready, Hake_process_s *process) {
+    if (process->state & HAKE_STATE_CRITICAL) {
+        return &ready->critical;
+    }
+    if (ready_age_of(ready, process) >= STARVING_AGE) {
+        return &ready->starving;
+    }
+    return &ready->levels[process->priority];
+}
+
+/* Adds a process to the aging wheel slot for its enqueue epoch. */
+static void wheel_push(Hake_process_s **wheel, Hake_process_s *process) {
+    Hake_process_s **slot = &wheel[process->enqueue_epoch % STARVING_AGE];
+
+    process->age_prev = NULL;
+    process->age_next = *slot;
+    if (*slot != NULL) {
+        (*slot)->age_prev = process;
+    }
+    *slot = process;
+}
+
+/* Unlinks a process from its aging wheel slot in O(1). */
+static void wheel_remove(Hake_process_s **wheel, Hake_process_s *process) {
+    if (process->age_prev != NULL) {
+        process->age_prev->age_next = process->age_next;
+    } else {
+        wheel[process->enqueue_epoch % STARVING_AGE] = process->age_next;
+    }
+    if (process->age_next != NULL) {
+        process->age_next->age_prev = process->age_prev;
+    }
+    process->age_next = NULL;
+    process->age_prev = NULL;
+}
+
+/* Orders two processes by PID, for sorting a cohort that starts Starving together. */
+static int pid_before(Hake_process_s *a, Hake_process_s *b) {
+    return a->pid < b->pid;
+}
+
+/* Sorts a list linked through age_next (a stable merge sort, O(k log k) for k processes).
+ * - Used on wheel slots once they are detached, so age_prev is left stale.
+ * Returns the new head of the list.
+ */
+static Hake_process_s *age_list_sort(Hake_process_s *list, int (*before)(Hake_process_s *, Hake_process_s *)) {
+    Hake_process_s *slow = list;
+    Hake_process_s *fast = NULL;
+    Hake_process_s *second = NULL;
+    Hake_process_s *head = NULL;
+    Hake_process_s **tail = &head;
+
+    if (list == NULL || list->age_next == NULL) {
+        return list;
+    }
+
+    // Split the list in half and sort each half
+    for (fast = list->age_next; fast != NULL && fast->age_next != NULL; fast = fast->age_next->age_next) {
+        slow = slow->age_next;
+    }
+    second = slow->age_next;
+    slow->age_next = NULL;
+    list = age_list_sort(list, before);
+    second = age_list_sort(second, before);
+
+    // Merge them, taking from the first half on ties to keep the sort stable
+    while (list != NULL && second != NULL) {
+        if (before(second, list)) {
+            *tail = second;
+            second = second->age_next;
+        } else {
+            *tail = list;
+            list = list->age_next;
+        }
+        tail = &(*tail)->age_next;
+    }
+    *tail = (list != NULL) ? list : second;
+    return head;
+}
+
+/* Returns the lowest occupied priority level >= from, or -1 if there are none.
+ * - Uses find-first-set on each 64-bit word of the occupancy bitmap.
+ */
+static int ready_first_level(Hake_ready_s *ready, int from) {
+    int word = from / 64;
+    unsigned long long bits;
+
+    if (from >= HAKE_LEVELS) {
+        return -1;
+    }
+
+    // Mask off the levels below from in the first word examined
+    bits = ready->occupied[word] & (~0ULL << (from % 64));
+    while (1) {
+        if (bits != 0) {
+            return word * 64 + __builtin_ctzll(bits);
+        }
+        if (++word >= HAKE_BITMAP_WORDS) {
+            return -1;
+        }
+        bits = ready->occupied[word];
+    }
+}
+
+/* Places a process into its Ready Lane and marks the level occupied.
+ * - The process keeps the age it already had by backdating its enqueue epoch.
+ */
+static void ready_enqueue(Hake_ready_s *ready, Hake_process_s *process) {
+    Hake_lane_s *lane = NULL;
+
+    process->enqueue_epoch = ready->epoch - process->age;
+    // Critical processes with a deadline run EDF (the Critical lane is the fallback if the heap can't grow)
+    if ((process->state & HAKE_STATE_CRITICAL) && process->deadline_ns > 0 && edf_push(ready, process) == 0) {
+        return;
+    }
+    lane = ready_lane_of(ready, process);
+    if (lane == &ready->starving) {
+        // Already Starving (such as on resume), so it joins the back of the Starving lane
+        lane_append(lane, process);
+        return;
+    }
+    lane_insert(lane, process);
+    if (lane != &ready->critical) {
+        ready->occupied[process->priority / 64] |= 1ULL << (process->priority % 64);
+        wheel_push(ready->wheel, process);
+    }
+}
+
+/* Removes a process from its Ready Lane, clearing the level bit if it empties.
+ * - The age member is brought up to date, since it is not maintained while Ready.
+ */
+static void ready_dequeue(Hake_ready_s *ready, Hake_process_s *process) {
+    Hake_lane_s *lane = NULL;
+
+    if (process->heap_slot >= 0) {
+        edf_remove(ready, process);
+        process->age = ready_age_of(ready, process);
+        return;
+    }
+    lane = ready_lane_of(ready, process);
+    lane_remove(lane, process);
+    if (lane != &ready->critical && lane != &ready->starving) {
+        wheel_remove(ready->wheel, process);
+        if (lane->head == NULL) {
+            ready->occupied[process->priority / 64] &= ~(1ULL << (process->priority % 64));
+        }
+    }
+    process->age = ready_age_of(ready, process);
+}
+
+/* Returns the process hake_select would choose, without removing it.
+ * Earliest deadline first, then Critical, then Starving, then the lowest priority level; each lane head is its winner
+ *   (the lowest PID, or in the Starving lane the process that started Starving first).
+ */
+static Hake_process_s *ready_peek(Hake_ready_s *ready) {
+    int level;
+
+    if (ready->edf_count > 0) {
+        return ready->edf[0];
+    }
+    if (ready->critical.head != NULL) {
+        return ready->critical.head;
+    }
+    if (ready->starving.head != NULL) {
+        return ready->starving.head;
+    }
+    level = ready_first_level(ready, 0);
+    return (level < 0) ? NULL : ready->levels[level].head;
+}
+
+/* Returns the process with the lowest PID in the Ready Queue (the head of a PID ordered list).
+ * - Only the lane heads (and the few EDF processes) need to be compared, except in the Starving
+ *   lane, which is in the order processes started Starving and so is scanned in full.
+ */
+static Hake_process_s *ready_lowest_pid(Hake_ready_s *ready) {
+    Hake_process_s *lowest = ready->critical.head;
+    Hake_process_s *current = NULL;
+    int level;
+    int slot;
+
+    for (slot = 0; slot < ready->edf_count; slot++) {
+        if (lowest == NULL || ready->edf[slot]->pid < lowest->pid) {
+            lowest = ready->edf[slot];
+        }
+    }
+    for (current = ready->starving.head; current != NULL; current = current->next) {
+        if (lowest == NULL || current->pid < lowest->pid) {
+            lowest = current;
+        }
+    }
+    for (level = ready_first_level(ready, 0); level >= 0; level = ready_first_level(ready, level + 1)) {
+        if (lowest == NULL || ready->levels[level].head->pid < lowest->pid) {
+            lowest = ready->levels[level].head;
+        }
+    }
+    return lowest;
+}
+
+/* Removes a process from the index if it is the entry for its pid.
+ * - Uses backward shift deletion, so lookups never need tombstones.
+ */
+static void index_delete(Hake_index_s *index, Hake_process_s *process) {
+    int mask = index->capacity - 1;
+    int hole = index_home(index, process->pid);
+    int next = 0;
+
+    while (index->slots[hole] != NULL && index->slots[hole] != process) {
+        hole = (hole + 1) & mask;
+    }
+    if (index->slots[hole] == NULL) {
+        return; // Not indexed (e.g. its pid was reused by a newer process)
+    }
+
+    // Shift back any entry in the run that would no longer be reachable across the hole
+    next = hole;
+    while (1) {
+        int home = 0;
+        next = (next + 1) & mask;
+        if (index->slots[next] == NULL) {
+            break;
+        }
+        home = index_home(index, index->slots[next]->pid);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            index->slots[hole] = index->slots[next];
+            hole = next;
+        }
+    }
+    index->slots[hole] = NULL;
+    index->count--;
+}
+
+/* Appends one Terminated process to the CSV archive.
+ * - Columns: pid,priority,critical,exit_code,start_ns,end_ns,cmd (cmd quoted, quotes doubled)
+ */
+static void archive_write(Hake_archive_s *archive, Hake_process_s *process) {
+    const char *c = NULL;
+
+    fprintf(archive->log, "%d,%d,%d,%u,%lld,%lld,\"", process->pid, process->priority,
+            (process->state & HAKE_STATE_CRITICAL) ? 1 : 0, process->state & HAKE_STATE_EXIT_CODE,
+            process->start_ns, process->end_ns);
+    for (c = process->cmd; *c != '\0'; c++) {
+        if (*c == '"') {
+            fputc('"', archive->log);
+        }
+        fputc(*c, archive->log);
+    }
+    fputs("\"\n", archive->log);
+}
+
+/* Evicts the oldest Terminated process, archiving it if a log is open.
+ * - It still counts as Terminated, so only the retained count goes down.
+ */
+static void terminated_evict(Hake_schedule_s *schedule) {
+    Hake_process_s *oldest = schedule->terminated_queue->head;
+
+    queue_unlink(schedule->terminated_queue, oldest);
+    schedule->archive->retained--;
+    schedule->archive->archived++;
+    if (schedule->archive->log != NULL) {
+        archive_write(schedule->archive, oldest);
+    }
+    index_delete(schedule->index, oldest);
+    hake_free_process(oldest);
+}
+
+/* Marks a process Terminated with the Exit Code and appends it to the Terminated Queue in O(1).
+ * - Keeps at most archive->keep Terminated processes in memory.
+ */
+static void terminated_add(Hake_schedule_s *schedule, Hake_process_s *process, int exit_code) {
+    edf_unreserve(schedule, process);
+    process->state = (process->state & HAKE_STATE_CRITICAL) | HAKE_STATE_TERMINATED |
+                     (exit_code & HAKE_STATE_EXIT_CODE);
+    process->end_ns = wall_clock_ns();
+    queue_append(schedule->terminated_queue, process);
+    schedule->archive->retained++;
+    while (schedule->archive->retained > schedule->archive->keep) {
+        terminated_evict(schedule);
+    }
+}
+
+/* Sets the Ready State bit of a process and hands it to the schedule's policy, starting its wait at now. */
+static void ready_add(Hake_schedule_s *schedule, Hake_process_s *process, long long now) {
+    set_state_flag(process, HAKE_STATE_READY);
+    process->ready_since_ns = now;
+    schedule->policy->insert(schedule->policy_data, process);
+    schedule->ready_queue->count++;
+}
+
+/* Ends the wait of a process leaving the Ready Queue at now, adding it to its total wait time. */
+static void ready_leave(Hake_process_s *process, long long now) {
+    if (process->ready_since_ns > 0) {
+        process->wait_ns += now - process->ready_since_ns;
+    }
+    process->ready_since_ns = 0;
+}
+
+/* Ages every process left in the Ready Queue by advancing the select epoch.
+ * - Only the wheel slot enqueued STARVING_AGE epochs ago can hold newly Starving processes,
+ *   so those move over to the Starving lane and the rest of the Ready Queue is untouched.
+ * - They join the back of the Starving lane in PID order, so it stays in the order processes
+ *   started Starving and each move is O(1) (plus sorting the cohort).
+ */
+static void ready_tick(Hake_ready_s *ready) {
+    Hake_process_s *current = NULL;
+
+    ready->epoch++;
+    current = age_list_sort(ready->wheel[ready->epoch % STARVING_AGE], pid_before);
+    ready->wheel[ready->epoch % STARVING_AGE] = NULL;
+    while (current != NULL) {
+        Hake_process_s *next = current->age_next;
+        Hake_lane_s *lane = &ready->levels[current->priority];
+
+        lane_remove(lane, current);
+        if (lane->head == NULL) {
+            ready->occupied[current->priority / 64] &= ~(1ULL << (current->priority % 64));
+        }
+        current->age_next = NULL;
+        current->age_prev = NULL;
+        lane_append(&ready->starving, current);
+        current = next;
+    }
+}
+
+/* Returns the process following the given one in selection order, crossing lanes as needed.
+ * - Order is the EDF heap (in heap order, so only its top is exact), Critical lane,
+ *   Starving lane, then each occupied priority level in turn.
+ */
+static Hake_process_s *ready_next(Hake_ready_s *ready, Hake_process_s *process) {
+    Hake_lane_s *lane = NULL;
+    int level = -1;
+
+    if (process->heap_slot >= 0) {
+        if (process->heap_slot + 1 < ready->edf_count) {
+            return ready->edf[process->heap_slot + 1];
+        }
+        if (ready->critical.head != NULL) {
+            return ready->critical.head;
+        }
+        if (ready->starving.head != NULL) {
+            return ready->starving.head;
+        }
+        level = ready_first_level(ready, 0);
+        return (level < 0) ? NULL : ready->levels[level].head;
+    }
+    if (process->next != NULL) {
+        return process->next;
+    }
+
+    // End of this lane, move on to the next non-empty lane
+    lane = ready_lane_of(ready, process);
+    if (lane == &ready->critical && ready->starving.head != NULL) {
+        return ready->starving.head;
+    }
+    if (lane == &ready->critical || lane == &ready->starving) {
+        level = ready_first_level(ready, 0);
+    } else {
+        level = ready_first_level(ready, process->priority + 1);
+    }
+    return (level < 0) ? NULL : ready->levels[level].head;
+}
+
+/* Default policy hooks, adapting the Ready Queue Engine to Hake_policy_s. */
+static void *policy_hake_create() {
+    Hake_ready_s *ready = (Hake_ready_s *)calloc(1, sizeof(Hake_ready_s));
+
+    if (ready != NULL) {
+        // Start the epoch past STARVING_AGE so backdated enqueue epochs never wrap below 0
+        ready->epoch = STARVING_AGE;
+    }
+    return ready;
+}
+
+static void policy_hake_destroy(void *data) {
+    free(((Hake_ready_s *)data)->edf);
+    free(data);
+}
+
+static void policy_hake_insert(void *data, Hake_process_s *process) {
+    ready_enqueue((Hake_ready_s *)data, process);
+}
+
+static Hake_process_s *policy_hake_select(void *data) {
+    Hake_process_s *best = ready_peek((Hake_ready_s *)data);
+
+    if (best != NULL) {
+        ready_dequeue((Hake_ready_s *)data, best);
+    }
+    return best;
+}
+
+static void policy_hake_remove(void *data, Hake_process_s *process) {
+    ready_dequeue((Hake_ready_s *)data, process);
+}
+
+static void policy_hake_tick(void *data) {
+    ready_tick((Hake_ready_s *)data);
+}
+
+static Hake_process_s *policy_hake_first(void *data) {
+    return ready_peek((Hake_ready_s *)data);
+}
+
+static Hake_process_s *policy_hake_next(void *data, Hake_process_s *process) {
+    return ready_next((Hake_ready_s *)data, process);
+}
+
+static int policy_hake_age_of(void *data, Hake_process_s *process) {
+    return ready_age_of((Hake_ready_s *)data, process);
+}
+
+static int policy_hake_outranks(void *data, Hake_process_s *ready, Hake_process_s *running) {
+    return rank_outranks(ready, running, 1, 1);
+}
+
+/* Returns 1 if a Ready process should take the CPU from a running one right away, else 0.
+ * - Classes: Critical with a deadline (EDF), other Critical, then everything else.
+ *   A higher class always wins; within a class, an earlier deadline (by_deadline) or a
+ *   lower priority value (by_priority) wins.  Starving never preempts, since aging
+ *   already bounds that wait to the end of the running quantum.
+ * - Ties never preempt, so equals keep round-robining at quantum ends.
+ */
+static int rank_outranks(Hake_process_s *ready, Hake_process_s *running, int by_deadline, int by_priority) {
+    int ready_class = 2;
+    int running_class = 2;
+
+    if (ready->state & HAKE_STATE_CRITICAL) {
+        ready_class = (by_deadline && ready->deadline_ns > 0) ? 0 : 1;
+    }
+    if (running->state & HAKE_STATE_CRITICAL) {
+        running_class = (by_deadline && running->deadline_ns > 0) ? 0 : 1;
+    }
+    if (ready_class != running_class) {
+        return ready_class < running_class;
+    }
+    if (ready_class == 0) {
+        return ready->abs_deadline_ns < running->abs_deadline_ns;
+    }
+    if (ready_class == 2 && by_priority) {
+        return ready->priority < running->priority;
+    }
+    return 0;
+}
+
+/* Returns the Ready process with the lowest PID (the default for hake_suspend).
+ * - The default policy only compares lane heads; any other policy is scanned in full.
+ */
+static Hake_process_s *policy_lowest_pid(Hake_schedule_s *schedule) {
+    Hake_process_s *lowest = NULL;
+    Hake_process_s *current = NULL;
+
+    if (schedule->policy == &g_hake_policy) {
+        return ready_lowest_pid((Hake_ready_s *)schedule->policy_data);
+    }
+    for (current = hake_ready_first(schedule); current != NULL; current = hake_ready_next(schedule, current)) {
+        if (lowest == NULL || current->pid < lowest->pid) {
+            lowest = current;
+        }
+    }
+    return lowest;
+}
+
+/* Returns whether a runs before b under EDF: the earliest absolute deadline, then the lowest PID. */
+static int edf_before(Hake_process_s *a, Hake_process_s *b) {
+    if (a->abs_deadline_ns != b->abs_deadline_ns) {
+        return a->abs_deadline_ns < b->abs_deadline_ns;
+    }
+    return a->pid < b->pid;
+}
+
+/* Stores a process in an EDF heap slot, keeping its heap_slot in step. */
+static void edf_place(Hake_ready_s *ready, Hake_process_s *process, int slot) {
+    ready->edf[slot] = process;
+    process->heap_slot = slot;
+}
+
+/* Moves the process in slot up until its parent runs before it. */
+static void edf_sift_up(Hake_ready_s *ready, int slot) {
+    Hake_process_s *process = ready->edf[slot];
+
+    while (slot > 0 && edf_before(process, ready->edf[(slot - 1) / 2])) {
+        edf_place(ready, ready->edf[(slot - 1) / 2], slot);
+        slot = (slot - 1) / 2;
+    }
+    edf_place(ready, process, slot);
+}
+
+/* Moves the process in slot down until it runs before both children. */
+static void edf_sift_down(Hake_ready_s *ready, int slot) {
+    Hake_process_s *process = ready->edf[slot];
+
+    while (2 * slot + 1 < ready->edf_count) {
+        int child = 2 * slot + 1;
+        if (child + 1 < ready->edf_count && edf_before(ready->edf[child + 1], ready->edf[child])) {
+            child++;
+        }
+        if (!edf_before(ready->edf[child], process)) {
+            break;
+        }
+        edf_place(ready, ready->edf[child], slot);
+        slot = child;
+    }
+    edf_place(ready, process, slot);
+}
+
+/* Adds a process to the EDF heap in O(log n), doubling the heap when full.
+ * Returns a 0 on success or a -1 if the heap could not grow.
+ */
+static int edf_push(Hake_ready_s *ready, Hake_process_s *process) {
+    if (ready->edf_count == ready->edf_capacity) {
+        int capacity = (ready->edf_capacity == 0) ? HAKE_EDF_MIN_CAPACITY : ready->edf_capacity * 2;
+        Hake_process_s **edf = (Hake_process_s **)realloc(ready->edf, capacity * sizeof(Hake_process_s *));
+        if (edf == NULL) {
+            return -1;
+        }
+        ready->edf = edf;
+        ready->edf_capacity = capacity;
+    }
+    process->next = NULL;
+    process->prev = NULL;
+    edf_place(ready, process, ready->edf_count++);
+    edf_sift_up(ready, process->heap_slot);
+    return 0;
+}
+
+/* Removes any process from the EDF heap in O(log n), moving the last one into its slot. */
+static void edf_remove(Hake_ready_s *ready, Hake_process_s *process) {
+    int slot = process->heap_slot;
+    Hake_process_s *last = ready->edf[--ready->edf_count];
+
+    process->heap_slot = -1;
+    if (last == process) {
+        return;
+    }
+    edf_place(ready, last, slot);
+    edf_sift_up(ready, slot);
+    edf_sift_down(ready, last->heap_slot);
+}
+
+/* Returns the share of a CPU a deadline process needs, in parts per million (rounded up). */
+static int edf_utilization(Hake_process_s *process) {
+    return (int)((process->runtime_ns * 1000000LL + process->deadline_ns - 1) / process->deadline_ns);
+}
+
+/* Counts a deadline process against this schedule's EDF capacity (once). */
+static void edf_reserve(Hake_schedule_s *schedule, Hake_process_s *process) {
+    if (process->deadline_ns > 0 && !process->edf_reserved) {
+        schedule->edf_util_ppm += edf_utilization(process);
+        process->edf_reserved = 1;
+    }
+}
+
+/* Gives back a deadline process' share of this schedule's EDF capacity. */
+static void edf_unreserve(Hake_schedule_s *schedule, Hake_process_s *process) {
+    if (process->edf_reserved) {
+        schedule->edf_util_ppm -= edf_utilization(process);
+        process->edf_reserved = 0;
+    }
+}
+
+/* Starts a new job for a deadline process, due one relative deadline from now. */
+static void edf_release_job(Hake_process_s *process, long long now) {
+    process->abs_deadline_ns = now + process->deadline_ns;
+    process->job_ns = 0;
+}
+
+/* Charges the last run to the current job of a deadline process.
+ * - A job that used its expected runtime is done; it is a miss if that was after its deadline.
+ * - A job whose deadline passed with work left is also a miss.
+ * - Either way the next job is due one relative deadline after the last (periodic jobs).
+ */
+static void edf_account(Hake_schedule_s *schedule, Hake_process_s *process, long long now) {
+    if (process->deadline_ns <= 0 || process->abs_deadline_ns == 0) {
+        return;
+    }
+    process->job_ns += process->last_run_ns;
+    if (process->job_ns < process->runtime_ns && now <= process->abs_deadline_ns) {
+        return; // Job still in progress and on time
+    }
+    if (now > process->abs_deadline_ns) {
+        process->deadline_misses++;
+        schedule->edf_misses++;
+    }
+    process->abs_deadline_ns += process->deadline_ns;
+    process->job_ns = 0;
+    if (process->abs_deadline_ns < now) {
+        edf_release_job(process, now); // Fell more than a period behind, start over from now
+    }
+}
+
+/* Maps a priority (MIN_PRIORITY..MAX_PRIORITY, lower runs first) onto the fair share weight table. */
+static int cfs_weight(int priority) {
+    int range = MAX_PRIORITY - MIN_PRIORITY;
+    int step = ((priority - MIN_PRIORITY) * 39 + range / 2) / range;
+
+    return g_cfs_weights[step < 0 ? 0 : step > 39 ? 39 : step];
+}
+
+/* Returns whether a runs before b: Critical first (earliest deadline first among those with deadlines),
+ * then the lowest vruntime, then the lowest PID.
+ */
+static int cfs_before(Hake_process_s *a, Hake_process_s *b) {
+    int a_critical = (a->state & HAKE_STATE_CRITICAL) ? 1 : 0;
+    int b_critical = (b->state & HAKE_STATE_CRITICAL) ? 1 : 0;
+
+    if (a_critical != b_critical) {
+        return a_critical;
+    }
+    if (a_critical && (a->deadline_ns > 0) != (b->deadline_ns > 0)) {
+        return a->deadline_ns > 0; // Deadline processes come first among Critical ones
+    }
+    if (a_critical && a->deadline_ns > 0 && a->abs_deadline_ns != b->abs_deadline_ns) {
+        return a->abs_deadline_ns < b->abs_deadline_ns;
+    }
+    if (a->vruntime != b->vruntime) {
+        return a->vruntime < b->vruntime;
+    }
+    return a->pid < b->pid;
+}
+
+/* Rotates x down to the left, its right child taking its place. */
+static void rb_rotate_left(Hake_cfs_s *cfs, Hake_process_s *x) {
+    Hake_process_s *y = x->right;
+
+    x->right = y->left;
+    if (y->left != NULL) {
+        y->left->parent = x;
+    }
+    rb_transplant(cfs, x, y);
+    y->left = x;
+    x->parent = y;
+}
+
+/* Rotates x down to the right, its left child taking its place. */
+static void rb_rotate_right(Hake_cfs_s *cfs, Hake_process_s *x) {
+    Hake_process_s *y = x->left;
+
+    x->left = y->right;
+    if (y->right != NULL) {
+        y->right->parent = x;
+    }
+    rb_transplant(cfs, x, y);
+    y->right = x;
+    x->parent = y;
+}
+
+/* Puts v (which may be NULL) where u hangs from its parent. */
+static void rb_transplant(Hake_cfs_s *cfs, Hake_process_s *u, Hake_process_s *v) {
+    if (u->parent == NULL) {
+        cfs->root = v;
+    } else if (u == u->parent->left) {
+        u->parent->left = v;
+    } else {
+        u->parent->right = v;
+    }
+    if (v != NULL) {
+        v->parent = u->parent;
+    }
+}
+
+/* Returns the first node of a subtree in order. */
+static Hake_process_s *rb_minimum(Hake_process_s *node) {
+    while (node->left != NULL) {
+        node = node->left;
+    }
+    return node;
+}
+
+/* Returns the in order successor of a node, or NULL after the last one. */
+static Hake_process_s *rb_next(Hake_process_s *node) {
+    if (node->right != NULL) {
+        return rb_minimum(node->right);
+    }
+    while (node->parent != NULL && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+/* Inserts a process into the tree in O(log n), keeping the cached leftmost node. */
+static void rb_insert(Hake_cfs_s *cfs, Hake_process_s *process) {
+    Hake_process_s *parent = NULL;
+    Hake_process_s *current = cfs->root;
+    int leftmost = 1;
+
+    while (current != NULL) {
+        parent = current;
+        if (cfs_before(process, current)) {
+            current = current->left;
+        } else {
+            current = current->right;
+            leftmost = 0;
+        }
+    }
+    process->parent = parent;
+    process->left = NULL;
+    process->right = NULL;
+    process->red = 1;
+    if (parent == NULL) {
+        cfs->root = process;
+    } else if (cfs_before(process, parent)) {
+        parent->left = process;
+    } else {
+        parent->right = process;
+    }
+    if (leftmost) {
+        cfs->leftmost = process;
+    }
+
+    // Restore the red-black properties (no red node has a red child)
+    while (process->parent != NULL && process->parent->red) {
+        Hake_process_s *p = process->parent;
+        Hake_process_s *g = p->parent; // Exists, since a red node is never the root
+        Hake_process_s *uncle = (p == g->left) ? g->right : g->left;
+
+        if (uncle != NULL && uncle->red) {
+            p->red = 0;
+            uncle->red = 0;
+            g->red = 1;
+            process = g;
+        } else if (p == g->left) {
+            if (process == p->right) {
+                rb_rotate_left(cfs, p);
+                p = process;
+            }
+            p->red = 0;
+            g->red = 1;
+            rb_rotate_right(cfs, g);
+            break; // p now heads this subtree and is black
+        } else {
+            if (process == p->left) {
+                rb_rotate_right(cfs, p);
+                p = process;
+            }
+            p->red = 0;
+            g->red = 1;
+            rb_rotate_left(cfs, g);
+            break;
+        }
+    }
+    cfs->root->red = 0;
+}
+
+/* Removes a process from the tree in O(log n), keeping the cached leftmost node. */
+static void rb_erase(Hake_cfs_s *cfs, Hake_process_s *process) {
+    Hake_process_s *y = process;
+    Hake_process_s *x = NULL;
+    Hake_process_s *x_parent = NULL;
+    int removed_red = process->red;
+
+    if (cfs->leftmost == process) {
+        cfs->leftmost = rb_next(process);
+    }
+
+    if (process->left == NULL) {
+        x = process->right;
+        x_parent = process->parent;
+        rb_transplant(cfs, process, process->right);
+    } else if (process->right == NULL) {
+        x = process->left;
+        x_parent = process->parent;
+        rb_transplant(cfs, process, process->left);
+    } else {
+        // Two children: the successor takes this node's place and color
+        y = rb_minimum(process->right);
+        removed_red = y->red;
+        x = y->right;
+        if (y->parent == process) {
+            x_parent = y;
+        } else {
+            x_parent = y->parent;
+            rb_transplant(cfs, y, y->right);
+            y->right = process->right;
+            y->right->parent = y;
+        }
+        rb_transplant(cfs, process, y);
+        y->left = process->left;
+        y->left->parent = y;
+        y->red = process->red;
+    }
+    if (!removed_red) {
+        rb_erase_fixup(cfs, x, x_parent);
+    }
+    process->left = NULL;
+    process->right = NULL;
+    process->parent = NULL;
+}
+
+/* Restores equal black heights after a black node was removed above x (x may be NULL). */
+static void rb_erase_fixup(Hake_cfs_s *cfs, Hake_process_s *x, Hake_process_s *x_parent) {
+    while (x != cfs->root && (x == NULL || !x->red)) {
+        if (x == x_parent->left) {
+            Hake_process_s *w = x_parent->right;
+            if (w->red) {
+                w->red = 0;
+                x_parent->red = 1;
+                rb_rotate_left(cfs, x_parent);
+                w = x_parent->right;
+            }
+            if ((w->left == NULL || !w->left->red) && (w->right == NULL || !w->right->red)) {
+                w->red = 1;
+                x = x_parent;
+                x_parent = x->parent;
+            } else {
+                if (w->right == NULL || !w->right->red) {
+                    w->left->red = 0;
+                    w->red = 1;
+                    rb_rotate_right(cfs, w);
+                    w = x_parent->right;
+                }
+                w->red = x_parent->red;
+                x_parent->red = 0;
+                if (w->right != NULL) {
+                    w->right->red = 0;
+                }
+                rb_rotate_left(cfs, x_parent);
+                x = cfs->root;
+            }
+        } else {
+            Hake_process_s *w = x_parent->left;
+            if (w->red) {
+                w->red = 0;
+                x_parent->red = 1;
+                rb_rotate_right(cfs, x_parent);
+                w = x_parent->left;
+            }
+            if ((w->left == NULL || !w->left->red) && (w->right == NULL || !w->right->red)) {
+                w->red = 1;
+                x = x_parent;
+                x_parent = x->parent;
+            } else {
+                if (w->left == NULL || !w->left->red) {
+                    w->right->red = 0;
+                    w->red = 1;
+                    rb_rotate_left(cfs, w);
+                    w = x_parent->left;
+                }
+                w->red = x_parent->red;
+                x_parent->red = 0;
+                if (w->left != NULL) {
+                    w->left->red = 0;
+                }
+                rb_rotate_right(cfs, x_parent);
+                x = cfs->root;
+            }
+        }
+    }
+    if (x != NULL) {
+        x->red = 0;
+    }
+}
+
+/* Fair share policy hooks. */
+static void *policy_cfs_create() {
+    return calloc(1, sizeof(Hake_cfs_s));
+}
+
+static void policy_cfs_destroy(void *data) {
+    free(data);
+}
+
+/* Charges the last run (if any) at the process' weight, then places it by vruntime.
+ * - A process coming back from a long Suspension (or another CPU) is lifted to within one
+ *   latency period of min_vruntime, so it can't monopolize the CPU to catch up.
+ */
+static void policy_cfs_insert(void *data, Hake_process_s *process) {
+    Hake_cfs_s *cfs = (Hake_cfs_s *)data;
+    unsigned long long floor = 0;
+    int weight = cfs_weight(process->priority);
+
+    process->vruntime += (unsigned long long)process->last_run_ns * HAKE_NICE_0_WEIGHT / weight;
+    if (cfs->min_vruntime > CFS_LATENCY_USEC * 1000ULL) {
+        floor = cfs->min_vruntime - CFS_LATENCY_USEC * 1000ULL;
+    }
+    if (process->vruntime < floor) {
+        process->vruntime = floor;
+    }
+
+    process->enqueue_epoch = cfs->epoch - process->age;
+    rb_insert(cfs, process);
+    cfs->total_weight += weight;
+}
+
+static void policy_cfs_remove(void *data, Hake_process_s *process) {
+    Hake_cfs_s *cfs = (Hake_cfs_s *)data;
+
+    rb_erase(cfs, process);
+    cfs->total_weight -= cfs_weight(process->priority);
+    process->age = (int)(cfs->epoch - process->enqueue_epoch);
+}
+
+/* Takes the leftmost process, moving min_vruntime up to it. */
+static Hake_process_s *policy_cfs_select(void *data) {
+    Hake_cfs_s *cfs = (Hake_cfs_s *)data;
+    Hake_process_s *best = cfs->leftmost;
+
+    if (best == NULL) {
+        return NULL;
+    }
+    if (best->vruntime > cfs->min_vruntime) {
+        cfs->min_vruntime = best->vruntime;
+    }
+    policy_cfs_remove(cfs, best);
+    return best;
+}
+
+static void policy_cfs_tick(void *data) {
+    ((Hake_cfs_s *)data)->epoch++;
+}
+
+static Hake_process_s *policy_cfs_first(void *data) {
+    return ((Hake_cfs_s *)data)->leftmost;
+}
+
+static Hake_process_s *policy_cfs_next(void *data, Hake_process_s *process) {
+    return rb_next(process);
+}
+
+static int policy_cfs_age_of(void *data, Hake_process_s *process) {
+    return (int)(((Hake_cfs_s *)data)->epoch - process->enqueue_epoch);
+}
+
+/* CFS keeps fairness through vruntime, so only Critical arrivals preempt (a lower vruntime waits for the slice end). */
+static int policy_cfs_outranks(void *data, Hake_process_s *ready, Hake_process_s *running) {
+    return rank_outranks(ready, running, 0, 0);
+}
+
+/* Splits the latency period across the selected process and the Ready ones, by weight. */
+static long long policy_cfs_slice(void *data, Hake_process_s *process) {
+    Hake_cfs_s *cfs = (Hake_cfs_s *)data;
+    long long weight = cfs_weight(process->priority);
+    long long slice = CFS_LATENCY_USEC * 1000LL * weight / (cfs->total_weight + weight);
+
+    return (slice < CFS_MIN_SLICE_USEC * 1000LL) ? CFS_MIN_SLICE_USEC * 1000LL : slice;
+}
+
+/* Returns a process' soa key while it is not Starving: Critical by PID, otherwise by priority then PID. */
+static unsigned int soa_key(Hake_process_s *process) {
+    unsigned int pid = (unsigned int)process->pid & ((1U << HAKE_SOA_PID_BITS) - 1);
+
+    if (process->state & HAKE_STATE_CRITICAL) {
+        return pid;
+    }
+    return (2U << 30) | ((unsigned int)process->priority << HAKE_SOA_PID_BITS) | pid;
+}
+
+/* Returns a process' soa key once it is Starving (Critical processes never starve).
+ * - Its ticket is only current once it has started Starving, which is the only time the key is used.
+ */
+static unsigned int soa_starving_key(Hake_process_s *process) {
+    unsigned int pid = (unsigned int)process->pid & ((1U << HAKE_SOA_PID_BITS) - 1);
+
+    if (process->state & HAKE_STATE_CRITICAL) {
+        return pid;
+    }
+    return (1U << 30) | process->starving_ticket;
+}
+
+/* Orders two processes by Starving ticket, for renumbering them. */
+static int ticket_before(Hake_process_s *a, Hake_process_s *b) {
+    return a->starving_ticket < b->starving_ticket;
+}
+
+/* Orders two processes just removed from soa (so their age is current) by their soa key. */
+static int soa_drained_before(Hake_process_s *a, Hake_process_s *b) {
+    unsigned int key_a = (a->age >= STARVING_AGE) ? soa_starving_key(a) : soa_key(a);
+    unsigned int key_b = (b->age >= STARVING_AGE) ? soa_starving_key(b) : soa_key(b);
+
+    return key_a < key_b;
+}
+
+/* Makes room for count more Starving tickets, renumbering the live ones from 0 if they would run out.
+ * - Ready processes at least min_age old already hold a ticket, and keep their order.
+ */
+static void soa_reserve_tickets(Hake_soa_s *soa, unsigned int count, unsigned int min_age) {
+    Hake_process_s *list = NULL;
+    Hake_process_s *current = NULL;
+    int i = 0;
+
+    if (soa->next_ticket <= HAKE_SOA_TICKETS - count) {
+        return;
+    }
+    for (i = 0; i < soa->count; i++) {
+        current = soa->nodes[i];
+        if (!(current->state & HAKE_STATE_CRITICAL) && (unsigned int)(soa->epoch - current->enqueue_epoch) >= min_age) {
+            current->age_next = list;
+            list = current;
+        }
+    }
+    for (current = soa->overflow; current != NULL; current = current->next) {
+        if (!(current->state & HAKE_STATE_CRITICAL) && (unsigned int)(soa->epoch - current->enqueue_epoch) >= min_age) {
+            current->age_next = list;
+            list = current;
+        }
+    }
+
+    soa->next_ticket = 0;
+    for (current = age_list_sort(list, ticket_before); current != NULL; current = list) {
+        list = current->age_next;
+        current->age_next = NULL;
+        current->starving_ticket = soa->next_ticket++;
+        if (current->heap_slot >= 0) {
+            soa->starving_key[current->heap_slot] = soa_starving_key(current);
+        }
+    }
+}
+
+/* Returns the key a Ready process competes with right now. */
+static unsigned int soa_live_key(const Hake_soa_s *soa, Hake_process_s *process) {
+    if ((unsigned int)(soa->epoch - process->enqueue_epoch) >= STARVING_AGE) {
+        return soa_starving_key(process);
+    }
+    return soa_key(process);
+}
+
+/* Returns the slot with the lowest live key, one slot at a time, or -1 if there are none. */
+static int soa_argmin_scalar(const Hake_soa_s *soa) {
+    unsigned int epoch = (unsigned int)soa->epoch;
+    unsigned int best = 0xFFFFFFFFU;
+    int best_slot = -1;
+    int i = 0;
+
+    for (i = 0; i < soa->count; i++) {
+        unsigned int key = (epoch - soa->enqueue[i] >= STARVING_AGE) ? soa->starving_key[i] : soa->key[i];
+        if (key < best) {
+            best = key;
+            best_slot = i;
+        }
+    }
+    return best_slot;
+}
+
+#ifdef HAKE_SOA_X86
+/* Returns the slot with the lowest live key, four slots at a time, or -1 if there are none.
+ * - Each lane keeps its own minimum and slot; keys are unique, so the lanes reduce without ties.
+ */
+__attribute__((target("sse4.1")))
+static int soa_argmin_sse41(const Hake_soa_s *soa) {
+    const __m128i epoch = _mm_set1_epi32((int)(unsigned int)soa->epoch);
+    const __m128i starving = _mm_set1_epi32(STARVING_AGE);
+    const __m128i step = _mm_set1_epi32(4);
+    __m128i slot = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i best = _mm_set1_epi32(-1);
+    __m128i best_slot = _mm_set1_epi32(-1);
+    unsigned int keys[4];
+    int slots[4];
+    int i = 0;
+    int lane = 0;
+    int found = -1;
+
+    for (i = 0; i < soa->count; i += 4) {
+        __m128i age = _mm_sub_epi32(epoch, _mm_load_si128((const __m128i *)(soa->enqueue + i)));
+        __m128i is_starving = _mm_cmpeq_epi32(_mm_max_epu32(age, starving), age);
+        __m128i key = _mm_blendv_epi8(_mm_load_si128((const __m128i *)(soa->key + i)),
+                                      _mm_load_si128((const __m128i *)(soa->starving_key + i)), is_starving);
+        __m128i lower = _mm_min_epu32(best, key);
+
+        best_slot = _mm_blendv_epi8(slot, best_slot, _mm_cmpeq_epi32(lower, best));
+        best = lower;
+        slot = _mm_add_epi32(slot, step);
+    }
+    _mm_storeu_si128((__m128i *)keys, best);
+    _mm_storeu_si128((__m128i *)slots, best_slot);
+    for (lane = 0; lane < 4; lane++) {
+        if (slots[lane] >= 0 && slots[lane] < soa->count && (found < 0 || keys[lane] < keys[found])) {
+            found = lane;
+        }
+    }
+    return (found < 0) ? -1 : slots[found];
+}
+
+/* Returns the slot with the lowest live key, eight slots at a time, or -1 if there are none. */
+__attribute__((target("avx2")))
+static int soa_argmin_avx2(const Hake_soa_s *soa) {
+    const __m256i epoch = _mm256_set1_epi32((int)(unsigned int)soa->epoch);
+    const __m256i starving = _mm256_set1_epi32(STARVING_AGE);
+    const __m256i step = _mm256_set1_epi32(8);
+    __m256i slot = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i best = _mm256_set1_epi32(-1);
+    __m256i best_slot = _mm256_set1_epi32(-1);
+    unsigned int keys[8];
+    int slots[8];
+    int i = 0;
+    int lane = 0;
+    int found = -1;
+
+    for (i = 0; i < soa->count; i += 8) {
+        __m256i age = _mm256_sub_epi32(epoch, _mm256_load_si256((const __m256i *)(soa->enqueue + i)));
+        __m256i is_starving = _mm256_cmpeq_epi32(_mm256_max_epu32(age, starving), age);
+        __m256i key = _mm256_blendv_epi8(_mm256_load_si256((const __m256i *)(soa->key + i)),
+                                         _mm256_load_si256((const __m256i *)(soa->starving_key + i)), is_starving);
+        __m256i lower = _mm256_min_epu32(best, key);
+
+        best_slot = _mm256_blendv_epi8(slot, best_slot, _mm256_cmpeq_epi32(lower, best));
+        best = lower;
+        slot = _mm256_add_epi32(slot, step);
+    }
+    _mm256_storeu_si256((__m256i *)keys, best);
+    _mm256_storeu_si256((__m256i *)slots, best_slot);
+    for (lane = 0; lane < 8; lane++) {
+        if (slots[lane] >= 0 && slots[lane] < soa->count && (found < 0 || keys[lane] < keys[found])) {
+            found = lane;
+        }
+    }
+    return (found < 0) ? -1 : slots[found];
+}
+#endif
+
+/* Picks the widest kernel this CPU supports (run once, before the first soa ready set). */
+static void soa_detect_kernel() {
+    int i = 0;
+
+#ifdef HAKE_SOA_X86
+    __builtin_cpu_init();
+#endif
+    for (i = 0; i < HAKE_SOA_KERNELS && g_soa_best == NULL; i++) {
+        if (g_soa_kernels[i].feature == NULL) {
+            g_soa_best = &g_soa_kernels[i];
+        }
+#ifdef HAKE_SOA_X86
+        else if (strcmp(g_soa_kernels[i].feature, "avx2") == 0 ? __builtin_cpu_supports("avx2")
+                                                                : __builtin_cpu_supports("sse4.1")) {
+            g_soa_best = &g_soa_kernels[i];
+        }
+#endif
+    }
+    if (g_soa_kernel == NULL) {
+        g_soa_kernel = g_soa_best;
+    }
+}
+
+/* Fills slots from..capacity-1 with padding that never wins (and never starves into winning). */
+static void soa_pad(Hake_soa_s *soa, int from) {
+    int i = 0;
+
+    for (i = from; i < soa->capacity; i++) {
+        soa->key[i] = 0xFFFFFFFFU;
+        soa->starving_key[i] = 0xFFFFFFFFU;
+        soa->enqueue[i] = 0;
+        soa->nodes[i] = NULL;
+    }
+}
+
+/* Doubles the slot arrays (cache line aligned, so kernels use aligned loads).
+ * Returns a 0 on success or a -1 if any array could not grow (the old ones are kept).
+ */
+static int soa_grow(Hake_soa_s *soa) {
+    int capacity = (soa->capacity == 0) ? HAKE_SOA_MIN_CAPACITY : soa->capacity * 2;
+    size_t bytes = (size_t)capacity * sizeof(unsigned int);
+    void *key = NULL;
+    void *starving_key = NULL;
+    void *enqueue = NULL;
+    Hake_process_s **nodes = (Hake_process_s **)malloc(capacity * sizeof(Hake_process_s *));
+
+    if (posix_memalign(&key, HAKE_CACHE_LINE, bytes) != 0) {
+        key = NULL;
+    }
+    if (posix_memalign(&starving_key, HAKE_CACHE_LINE, bytes) != 0) {
+        starving_key = NULL;
+    }
+    if (posix_memalign(&enqueue, HAKE_CACHE_LINE, bytes) != 0) {
+        enqueue = NULL;
+    }
+    if (key == NULL || starving_key == NULL || enqueue == NULL || nodes == NULL) {
+        free(key);
+        free(starving_key);
+        free(enqueue);
+        free(nodes);
+        return -1;
+    }
+    if (soa->count > 0) {
+        memcpy(key, soa->key, soa->count * sizeof(unsigned int));
+        memcpy(starving_key, soa->starving_key, soa->count * sizeof(unsigned int));
+        memcpy(enqueue, soa->enqueue, soa->count * sizeof(unsigned int));
+        memcpy(nodes, soa->nodes, soa->count * sizeof(Hake_process_s *));
+    }
+    free(soa->key);
+    free(soa->starving_key);
+    free(soa->enqueue);
+    free(soa->nodes);
+    soa->key = key;
+    soa->starving_key = starving_key;
+    soa->enqueue = enqueue;
+    soa->nodes = nodes;
+    soa->capacity = capacity;
+    soa_pad(soa, soa->count);
+    return 0;
+}
+
+/* Stores a process' keys and enqueue epoch in a slot, keeping its heap_slot in step. */
+static void soa_place(Hake_soa_s *soa, Hake_process_s *process, int slot) {
+    soa->key[slot] = soa_key(process);
+    soa->starving_key[slot] = soa_starving_key(process);
+    soa->enqueue[slot] = (unsigned int)process->enqueue_epoch;
+    soa->nodes[slot] = process;
+    process->heap_slot = slot;
+}
+
+/* Returns the process hake_select would choose, without removing it (overflow is compared by hand). */
+static Hake_process_s *soa_best(Hake_soa_s *soa) {
+    int slot = soa->argmin(soa);
+    Hake_process_s *best = (slot < 0) ? NULL : soa->nodes[slot];
+    Hake_process_s *current = NULL;
+
+    for (current = soa->overflow; current != NULL; current = current->next) {
+        if (best == NULL || soa_live_key(soa, current) < soa_live_key(soa, best)) {
+            best = current;
+        }
+    }
+    return best;
+}
+
+/* Structure of arrays policy hooks. */
+static void *policy_soa_create() {
+    Hake_soa_s *soa = (Hake_soa_s *)calloc(1, sizeof(Hake_soa_s));
+
+    pthread_once(&g_soa_detect, soa_detect_kernel);
+    if (soa == NULL) {
+        return NULL;
+    }
+    if (soa_grow(soa) == -1) {
+        free(soa);
+        return NULL;
+    }
+    // Start the epoch past STARVING_AGE so backdated enqueue epochs never wrap below 0 (as the wheel needs)
+    soa->epoch = STARVING_AGE;
+    soa->argmin = g_soa_kernel->argmin;
+    soa->kernel = g_soa_kernel->name;
+    return soa;
+}
+
+static void policy_soa_destroy(void *data) {
+    Hake_soa_s *soa = (Hake_soa_s *)data;
+
+    free(soa->key);
+    free(soa->starving_key);
+    free(soa->enqueue);
+    free(soa->nodes);
+    free(soa);
+}
+
+/* Appends a process to the next free slot, backdating its enqueue epoch so it keeps its age.
+ * - One already Starving (such as on resume) gets the next ticket; any other joins the aging wheel.
+ * - If the arrays can't grow, the process waits in the overflow list rather than being lost.
+ */
+static void policy_soa_insert(void *data, Hake_process_s *process) {
+    Hake_soa_s *soa = (Hake_soa_s *)data;
+
+    process->enqueue_epoch = soa->epoch - process->age;
+    if (!(process->state & HAKE_STATE_CRITICAL) && process->age >= STARVING_AGE) {
+        soa_reserve_tickets(soa, 1, STARVING_AGE);
+        process->starving_ticket = soa->next_ticket++;
+    } else if (!(process->state & HAKE_STATE_CRITICAL)) {
+        wheel_push(soa->wheel, process);
+    }
+    process->next = NULL;
+    process->prev = NULL;
+    if (soa->count == soa->capacity && soa_grow(soa) == -1) {
+        process->heap_slot = -1;
+        process->next = soa->overflow;
+        if (soa->overflow != NULL) {
+            soa->overflow->prev = process;
+        }
+        soa->overflow = process;
+        return;
+    }
+    soa_place(soa, process, soa->count++);
+}
+
+/* Removes a process in O(1): the last slot moves into its place and is padded out. */
+static void policy_soa_remove(void *data, Hake_process_s *process) {
+    Hake_soa_s *soa = (Hake_soa_s *)data;
+    int slot = process->heap_slot;
+
+    if (slot < 0) {
+        if (process->prev != NULL) {
+            process->prev->next = process->next;
+        } else {
+            soa->overflow = process->next;
+        }
+        if (process->next != NULL) {
+            process->next->prev = process->prev;
+        }
+        process->next = NULL;
+        process->prev = NULL;
+    } else {
+        soa->count--;
+        if (slot != soa->count) {
+            soa_place(soa, soa->nodes[soa->count], slot);
+        }
+        soa->key[soa->count] = 0xFFFFFFFFU;
+        soa->starving_key[soa->count] = 0xFFFFFFFFU;
+        soa->nodes[soa->count] = NULL;
+        process->heap_slot = -1;
+    }
+    process->age = (int)(soa->epoch - process->enqueue_epoch);
+    if (!(process->state & HAKE_STATE_CRITICAL) && process->age < STARVING_AGE) {
+        wheel_remove(soa->wheel, process);
+    }
+}
+
+static Hake_process_s *policy_soa_select(void *data) {
+    Hake_process_s *best = soa_best((Hake_soa_s *)data);
+
+    if (best != NULL) {
+        policy_soa_remove(data, best);
+    }
+    return best;
+}
+
+/* Advances the epoch; the wheel slot that just reached STARVING_AGE starts Starving, taking tickets in PID order. */
+static void policy_soa_tick(void *data) {
+    Hake_soa_s *soa = (Hake_soa_s *)data;
+    Hake_process_s *current = NULL;
+    Hake_process_s *next = NULL;
+    unsigned int cohort = 0;
+
+    soa->epoch++;
+    current = age_list_sort(soa->wheel[soa->epoch % STARVING_AGE], pid_before);
+    soa->wheel[soa->epoch % STARVING_AGE] = NULL;
+    for (next = current; next != NULL; next = next->age_next) {
+        cohort++;
+    }
+    soa_reserve_tickets(soa, cohort, STARVING_AGE + 1);
+    while (current != NULL) {
+        next = current->age_next;
+        current->age_next = NULL;
+        current->age_prev = NULL;
+        current->starving_ticket = soa->next_ticket++;
+        if (current->heap_slot >= 0) {
+            soa->starving_key[current->heap_slot] = soa_starving_key(current);
+        }
+        current = next;
+    }
+}
+
+/* Lists the winner first, then every other slot in slot order, then the overflow list. */
+static Hake_process_s *policy_soa_first(void *data) {
+    Hake_soa_s *soa = (Hake_soa_s *)data;
+
+    soa->listed = soa_best(soa);
+    return soa->listed;
+}
+
+static Hake_process_s *policy_soa_next(void *data, Hake_process_s *process) {
+    Hake_soa_s *soa = (Hake_soa_s *)data;
+    Hake_process_s *next = NULL;
+    int slot = (process == soa->listed) ? 0 : process->heap_slot + 1;
+
+    if (process != soa->listed && process->heap_slot < 0) {
+        next = process->next;
+    } else {
+        if (slot < soa->count && soa->nodes[slot] == soa->listed) {
+            slot++;
+        }
+        next = (slot < soa->count) ? soa->nodes[slot] : soa->overflow;
+    }
+    return (next != NULL && next == soa->listed) ? next->next : next;
+}
+
+static int policy_soa_age_of(void *data, Hake_process_s *process) {
+    return (int)(((Hake_soa_s *)data)->epoch - process->enqueue_epoch);
+}
+
+static int policy_soa_outranks(void *data, Hake_process_s *ready, Hake_process_s *running) {
+    return rank_outranks(ready, running, 0, 1);
+}
+
+/* Removes every Ready process at once and sorts them by key, in O(n log n) rather than the
+ *   O(n^2) of taking the best one (a full argmin) at a time.
+ */
+static Hake_process_s *policy_soa_drain(void *data) {
+    Hake_soa_s *soa = (Hake_soa_s *)data;
+    Hake_process_s *list = NULL;
+    Hake_process_s *current = NULL;
+
+    // Removing the last slot (or the overflow head) never moves another process
+    while (soa->overflow != NULL || soa->count > 0) {
+        current = (soa->overflow != NULL) ? soa->overflow : soa->nodes[soa->count - 1];
+        policy_soa_remove(soa, current);
+        current->age_next = list;
+        list = current;
+    }
+    return age_list_sort(list, soa_drained_before);
+}
+
 /*** Hake Library API Functions to Complete ***/
 
 /* Initializes the Hake_schedule_s Struct and all of the Hake_queue_s Structs
@@ -51,111 +2025,188 @@
  * Returns a pointer to the new Hake_schedule_s or NULL on any error.
  */
 Hake_schedule_s *hake_create() {
-  Hake_schedule_s *schedule = (Hake_schedule_s *)malloc(sizeof(Hake_schedule_s));
-  // Check if memory allocation was successful
+    Hake_schedule_s *schedule = (Hake_schedule_s *)calloc(1, sizeof(Hake_schedule_s));
+    // Check if memory allocation was successful
     if (schedule == NULL) {
         perror("Failed to allocate memory for Hake_schedule_s");
         return NULL;
     }
-   // Initialize ready_queue
-    schedule->ready_queue = (Hake_queue_s *)malloc(sizeof(Hake_queue_s));
-    if (schedule->ready_queue == NULL) {
-        perror("Failed to allocate memory for ready_queue");
-        free(schedule);
-        return NULL;
-    }
-  schedule->suspended_queue = (Hake_queue_s *)malloc(sizeof(Hake_queue_s));
-    if (schedule->suspended_queue == NULL) {
-        perror("Failed to allocate memory for terminated_queue");
-        free(schedule);
-        return NULL;
+
+    // Initialize the three queues and the ready engine (calloc zeroes counts, heads, and lanes)
+    schedule->ready_queue = (Hake_queue_s *)calloc(1, sizeof(Hake_queue_s));
+    schedule->suspended_queue = (Hake_queue_s *)calloc(1, sizeof(Hake_queue_s));
+    schedule->terminated_queue = (Hake_queue_s *)calloc(1, sizeof(Hake_queue_s));
+    schedule->policy = &g_hake_policy;
+    schedule->policy_data = g_hake_policy.create();
+    schedule->index = (Hake_index_s *)calloc(1, sizeof(Hake_index_s));
+    schedule->archive = (Hake_archive_s *)calloc(1, sizeof(Hake_archive_s));
+    if (schedule->index != NULL) {
+        schedule->index->capacity = HAKE_INDEX_MIN_CAPACITY;
+        schedule->index->slots = (Hake_process_s **)calloc(HAKE_INDEX_MIN_CAPACITY, sizeof(Hake_process_s *));
     }
-   // Initialize terminated_queue
-    schedule->terminated_queue = (Hake_queue_s *)malloc(sizeof(Hake_queue_s));
-    if (schedule->terminated_queue == NULL) {
-        perror("Failed to allocate memory for terminated_queue");
+    if (schedule->ready_queue == NULL || schedule->suspended_queue == NULL ||
+        schedule->terminated_queue == NULL || schedule->policy_data == NULL ||
+        schedule->index == NULL || schedule->index->slots == NULL || schedule->archive == NULL) {
+        perror("Failed to allocate memory for the Hake queues");
+        free(schedule->ready_queue);
+        free(schedule->suspended_queue);
+        free(schedule->terminated_queue);
+        if (schedule->policy_data != NULL) {
+            g_hake_policy.destroy(schedule->policy_data);
+        }
+        if (schedule->index != NULL) {
+            free(schedule->index->slots);
+        }
+        free(schedule->index);
+        free(schedule->archive);
         free(schedule);
         return NULL;
     }
-  // Initialize the counts to 0 for each queue
-    schedule->ready_queue->count = 0;
-    schedule->suspended_queue->count = 0;
-    schedule->terminated_queue->count = 0;
+    // Keep the default number of Terminated processes, with no archive until one is set
+    schedule->archive->keep = TERMINATED_KEEP;
 
-    // Initialize the head pointers to NULL for each queue
-    schedule->ready_queue->head = NULL;
-    schedule->suspended_queue->head = NULL;
-    schedule->terminated_queue->head = NULL;
+    // Join the schedules sharing the node arena
+    pthread_mutex_lock(&g_arena.lock);
+    g_arena.users++;
+    pthread_mutex_unlock(&g_arena.lock);
 
     return schedule;
 }
 
 /* Allocate and Initialize a new Hake_process_s with the given information.
- * - Malloc and copy the command string, don't just assign it!
+ * - The node comes from the node arena and the command is copied, not just assigned.
+ * - Commands shorter than HAKE_INLINE_CMD are stored in the node's slot, longer ones are interned.
  * Follow the project documentation for this function.
  * - You may assume all arguments are Legal and Correct for this Function Only
  * Returns a pointer to the Hake_process_s on success or a NULL on any error.
  */
 Hake_process_s *hake_new_process(char *command, pid_t pid, int priority, int is_critical) {
-   Hake_process_s *new_process = (Hake_process_s *)malloc(sizeof(Hake_process_s));
-  // Check if memory allocation was successful
-    if (new_process == NULL) {
+    Hake_process_s *new_process = NULL;
+    Hake_slot_s *slot = NULL;
+    size_t length = strlen(command);
+
+    pthread_mutex_lock(&g_arena.lock);
+    slot = arena_alloc_slot();
+    if (slot != NULL && length < HAKE_INLINE_CMD) {
+        memcpy(slot->used.cmd, command, length + 1);
+        slot->used.node.cmd = slot->used.cmd;
+    } else if (slot != NULL) {
+        slot->used.node.cmd = arena_intern(command, length);
+        if (slot->used.node.cmd == NULL) {
+            slot->next_free = g_arena.free_slots;
+            g_arena.free_slots = slot;
+            slot = NULL;
+        }
+    }
+    pthread_mutex_unlock(&g_arena.lock);
+
+    // Check if memory allocation was successful
+    if (slot == NULL) {
         perror("Failed to allocate memory for Hake_process_s");
         return NULL; // Return NULL on error
     }
-      // Initialize the state with the Ready State bit set to 1 and the Critical bit set accordingly
-    new_process->state = (is_critical ? 0x88000000 : 0x80000000);
-   // Initialize priority, age, and pid
+    new_process = &slot->used.node;
+    // Initialize the state with the Ready State bit set to 1 and the Critical bit set accordingly
+    new_process->state = HAKE_STATE_READY | (is_critical ? HAKE_STATE_CRITICAL : 0);
+    // Initialize priority, age, and pid
     new_process->priority = priority;
     new_process->age = 0;
+    new_process->enqueue_epoch = 0;
+    new_process->start_ns = wall_clock_ns();
+    new_process->end_ns = 0;
+    new_process->first_run_ns = 0;
+    new_process->runs = 0;
+    new_process->run_start_ns = 0;
+    new_process->last_run_ns = 0;
+    new_process->quantum_ns = 0;
+    new_process->cpu_ns = 0;
+    new_process->slice_cpu_ns = -1;
+    new_process->ready_since_ns = 0;
+    new_process->wait_ns = 0;
+    new_process->run_ns = 0;
+    new_process->vruntime = 0;
+    new_process->deadline_ns = 0;
+    new_process->runtime_ns = 0;
+    new_process->abs_deadline_ns = 0;
+    new_process->job_ns = 0;
+    new_process->deadline_misses = 0;
+    new_process->edf_reserved = 0;
+    new_process->heap_slot = -1;
     new_process->pid = pid;
 
-    // Allocate memory for the cmd member and copy the command
-    new_process->cmd = (char *)malloc(strlen(command) + 1);
-    if (new_process->cmd == NULL) {
-        perror("Failed to allocate memory for cmd");
-        free(new_process);
-        return NULL; // Return NULL on error
-    }
-    strncpy(new_process->cmd, command, strlen(command) + 1);
-   // Initialize the next member to NULL
+    // Initialize the list links to NULL
     new_process->next = NULL;
+    new_process->prev = NULL;
+    new_process->age_next = NULL;
+    new_process->age_prev = NULL;
+    new_process->left = NULL;
+    new_process->right = NULL;
+    new_process->parent = NULL;
+    new_process->red = 0;
 
     return new_process;
 }
 
-/* Inserts a process into the Ready Queue (singly linked list).
+/* Returns a node that is not in any schedule (e.g. one that was never inserted) to the node arena.
+ * - Interned command strings stay until the arena is released.
+ */
+void hake_free_process(Hake_process_s *process) {
+    Hake_slot_s *slot = (Hake_slot_s *)process;
+
+    if (process == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&g_arena.lock);
+    slot->next_free = g_arena.free_slots;
+    g_arena.free_slots = slot;
+    pthread_mutex_unlock(&g_arena.lock);
+}
+
+/* Inserts a process into the Ready Queue (held by the schedule's policy).
  * Follow the project documentation for this function.
  * - Do not create a new process to insert, insert the SAME process passed in.
- * Returns a 0 on success or a -1 on any error.
+ * - A process is either new (its pid is untracked or only Terminated) or coming back off the CPU.
+ * Returns a 0 on success or a -1 on any error (including a duplicate pid).
  */
 int hake_insert(Hake_schedule_s *schedule, Hake_process_s *process) {
- // Set the Ready State bit of the state member to 1
-    // (Keep other state bits unchanged)
-    process->state &= 0xFFFFFFFF
-    process->state |= 0x80000000;
-    // Insert the Process Node in Ascending PID Order
-    Hake_queue_s *ready_queue = schedule->ready_queue;
-    Hake_process_s *current = ready_queue->head;
-    Hake_process_s *prev = NULL;
-
-    while (current != NULL && current->pid < process->pid) {
-        prev = current;
-        current = current->next;
-    }
-
-    if (prev == NULL) {
-        // Insert at the beginning of the Ready Queue
-        process->next = ready_queue->head;
-        ready_queue->head = process;
-    } else {
-        // Insert after 'prev'
-        prev->next = process;
-        process->next = current;
+    Hake_process_s *existing = NULL;
+    long long now = 0;
+
+    if (schedule == NULL || schedule->policy == NULL || process == NULL ||
+        process->priority < MIN_PRIORITY || process->priority > MAX_PRIORITY) {
+        return -1;
+    }
+
+    // Reject duplicates with one index probe
+    existing = index_find(schedule->index, process->pid);
+    if (existing == process) {
+        if (!(process->state & HAKE_STATE_RUNNING)) {
+            return -1; // Already in one of the Queues
+        }
+    } else if (existing != NULL && !(existing->state & HAKE_STATE_TERMINATED)) {
+        return -1; // Another live process already has this pid
+    } else if (index_put(schedule->index, process) == -1) {
+        return -1; // New pid (or a reused pid of a Terminated process)
+    }
+
+    // Coming back off the CPU, so measure the run for policies that charge for it
+    // (the CPU time it really used, if the caller measured it, rather than the time it held the CPU)
+    now = monotonic_clock_ns();
+    if (process->state & HAKE_STATE_RUNNING) {
+        process->last_run_ns = (process->slice_cpu_ns >= 0) ? process->slice_cpu_ns : now - process->run_start_ns;
+        process->run_ns += now - process->run_start_ns;
+        edf_account(schedule, process, now);
+    }
+    // hake_admit already reserved a deadline process' capacity; this reserves it again after hake_detach
+    edf_reserve(schedule, process);
+    if (process->deadline_ns > 0 && process->abs_deadline_ns == 0) {
+        edf_release_job(process, now);
     }
 
-    // Update the Ready Queue's count member
-    ready_queue->count++;
+    // Set the Ready State bit and hand the Process Node to the policy
+    ready_add(schedule, process, now);
+    // The policy has seen the run, so a later insert (a resume or a policy switch) can't charge it again
+    process->last_run_ns = 0;
 
     return 0; // Return 0 on success
 }
@@ -165,7 +2216,7 @@ int hake_insert(Hake_schedule_s *schedule, Hake_process_s *process) {
  * Returns the number of processes in the list or -1 on any errors.
  */
 int hake_get_count(Hake_queue_s *queue) {
-  if (queue == NULL) {
+    if (queue == NULL) {
         // Check for NULL pointer
         return -1; // Return -1 on error
     }
@@ -174,262 +2225,154 @@ int hake_get_count(Hake_queue_s *queue) {
     return queue->count;
 }
 
-/* Selects the best process to run from the Ready Queue (singly linked list).
+/* Selects the best process to run from the Ready Queue.
  * Follow the project documentation for this function.
+ * - The schedule's policy picks the winner; by default Critical first, then Starving, then lowest
+ *   priority value, ties going to the lowest PID (a lane head, found in O(1) with the bitmap).
  * Returns a pointer to the process selected or NULL if none available or on any errors.
  * - Do not create a new process to return, return a pointer to the SAME process removed.
  */
 Hake_process_s *hake_select(Hake_schedule_s *schedule) {
-  if (schedule == NULL || schedule->ready_queue == NULL || schedule->ready_queue->head == NULL) {
-        // Check for NULL pointers or an empty Ready Queue
-        return NULL; // Return NULL on error or if the Ready Queue is empty
-    }
-  // Initialize variables to find the best process
     Hake_process_s *best_process = NULL;
-    Hake_process_s *current = schedule->ready_queue->head;
-    Hake_process_s *prev = NULL;
-    Hake_process_s *best_prev = NULL;
-
-    Hake_process_s  critical = NULL;
-    Hake_process_s  starving = NULL;
-  while (current != NULL) {
-        // Check if the process is critical or starving
-        if (current->state & 0x40000000) {
-            critical = current;
-            if (best_process == NULL || critical == NULL || current->pid < critical->pid) {
-                best_process = current;
-                best_prev = prev;
-            }
-        } else if (current->age >= STARVING_AGE) {
-            starving = current;
-          if (critical == NULL && (best_process == NULL || starving == NULL || current->pid < starving->pid)) {
-                best_process = current;
-                best_prev = prev;
-            }
-        }
-        else {
-            if (critical == NULL && starving == NULL && (best_process == NULL || current->priority < best_process->priority ||
-                (current->priority == best_process->priority && current->pid < best_process->pid))) {
-                best_process = current;
-                best_prev = prev;
-            }
-        }
-        // Move to the next process
-        prev = current;
-        current = current->next;
-  }
-    if (best_process != NULL) {
-        // Remove the best process from the Ready Queue
-        if (best_prev != NULL) {
-            best_prev->next = best_process->next;
-        } else {
-            schedule->ready_queue->head = best_process->next;
-        }
 
-        // Set the chosen process' age to 0, state to Running, and next to NULL
-        best_process->age = 0;
-        best_process->state = (best_process->state & 0xFFFFFFF) | 0x40000000;
-        best_process->next = NULL;
-  // Increment the age member for all remaining processes in the Ready Queue
-        current = schedule->ready_queue->head;
-        while (current != NULL) {
-            current->age++;
-            current = current->next;
-        }
+    if (schedule == NULL || schedule->policy == NULL) {
+        return NULL; // Return NULL on error
+    }
 
-        // Return a pointer to the chosen process
-        return best_process;
+    // Remove the best process from the Ready Queue
+    best_process = schedule->policy->select(schedule->policy_data);
+    if (best_process == NULL) {
+        return NULL; // Return NULL if the Ready Queue is empty
     }
+    schedule->ready_queue->count--;
+
+    // Set the chosen process' age to 0 and state to Running
+    best_process->age = 0;
+    best_process->run_start_ns = monotonic_clock_ns();
+    ready_leave(best_process, best_process->run_start_ns);
+    best_process->slice_cpu_ns = -1; // Not measured until hake_charge_cpu
+    if (best_process->runs++ == 0) {
+        best_process->first_run_ns = wall_clock_ns();
+    }
+    set_state_flag(best_process, HAKE_STATE_RUNNING);
 
-    return NULL; // Return NULL if no suitable process was found
-      
-            
-         
+    // Age all remaining processes in the Ready Queue (lazily, by advancing the epoch)
+    schedule->policy->tick(schedule->policy_data);
 
+    // Return a pointer to the chosen process
+    return best_process;
 }
 
 /* Move the process with matching pid from Ready to Suspended Queue.
  * Follow the specification for this function.
  * - Do not create a copy of the process in the Suspended Queue.  
  * - Insert the SAME process removed from the Ready Queue to the Suspended Queue
+ * - A pid of 0 suspends the Ready process with the lowest PID.
  * Returns a 0 on success or a -1 on any error (such as process not found).
  */
 int hake_suspend(Hake_schedule_s *schedule, pid_t pid) {
-   if (schedule == NULL || schedule->ready_queue == NULL || schedule->suspended_queue == NULL) {
+    Hake_process_s *process_to_suspend = NULL;
+
+    if (schedule == NULL || schedule->policy == NULL || schedule->suspended_queue == NULL) {
         // Check for NULL pointers
         return -1; // Return -1 on error
     }
 
-    // Search for the process in the Ready Queue or suspend the first process
-    Hake_process_s *process_to_suspend = NULL;
-    Hake_process_s *prev = NULL;
-   if (pid == 0) {
-        // Suspend the first (head) process in the Ready Queue
-        process_to_suspend = schedule->ready_queue->head;
-        if (process_to_suspend != NULL) {
-            schedule->ready_queue->head = process_to_suspend->next;
-        }
+    // Look up the process in the Ready Queue or suspend the first process
+    if (pid == 0) {
+        process_to_suspend = policy_lowest_pid(schedule);
     } else {
-        // Search for the process with the given PID in the Ready Queue
-        Hake_process_s *current = schedule->ready_queue->head;
-
-        while (current != NULL) {
-            if (current->pid == pid) {
-                if (prev != NULL) {
-                    prev->next = current->next;
-                } else {
-                    schedule->ready_queue->head = current->next;
-                }
-                process_to_suspend = current;
-                break;
-            }
-            prev = current;
-            current = current->next;
-        }
+        process_to_suspend = index_find(schedule->index, pid);
+    }
+    if (process_to_suspend == NULL || !(process_to_suspend->state & HAKE_STATE_READY)) {
+        return -1; // Return -1 if the process was not found in the Ready Queue
     }
 
-    if (process_to_suspend != NULL) {
-        // Set the Suspended State bit of the state member to 1
-        process_to_suspend->state = (process_to_suspend->state & 0xFFFFFFF) | 0x20000000;
-
-        // Set the next of the removed process to NULL
-        process_to_suspend->next = NULL;
-
-        // Insert the suspended process in ascending PID order to the Suspended Queue
-        Hake_process_s *current = schedule->suspended_queue->head;
-        Hake_process_s *prev = NULL;
-
-        while (current != NULL && current->pid < process_to_suspend->pid) {
-            prev = current;
-            current = current->next;
-        }
+    schedule->policy->remove(schedule->policy_data, process_to_suspend);
+    schedule->ready_queue->count--;
+    ready_leave(process_to_suspend, monotonic_clock_ns());
 
-        if (prev == NULL) {
-            // Insert at the beginning of the Suspended Queue
-            process_to_suspend->next = schedule->suspended_queue->head;
-            schedule->suspended_queue->head = process_to_suspend;
-        } else {
-            // Insert after 'prev'
-            prev->next = process_to_suspend;
-            process_to_suspend->next = current;
-        }
+    // Set the Suspended State bit of the state member to 1
+    set_state_flag(process_to_suspend, HAKE_STATE_SUSPENDED);
 
-        return 0; // Return 0 on success
-    }
+    // Insert the suspended process in ascending PID order to the Suspended Queue
+    queue_insert_ordered(schedule->suspended_queue, process_to_suspend);
 
-    return -1; // Return -1 if the process was not found
+    return 0; // Return 0 on success
 }
 
 /* Move the process with matching pid from Suspended to Ready Queue.
  * Follow the specification for this function.
  * - Do not create a copy of the process in the Ready Queue.  
  * - Insert the SAME process removed from the Suspended Queue to the Ready Queue
+ * - A pid of 0 resumes the head of the Suspended Queue.
  * Returns a 0 on success or a -1 on any error (such as process not found).
  */
 int hake_resume(Hake_schedule_s *schedule, pid_t pid) {
-  if (schedule == NULL || schedule->ready_queue == NULL || schedule->suspended_queue == NULL) {
+    Hake_process_s *process_to_resume = NULL;
+    long long now = 0;
+
+    if (schedule == NULL || schedule->policy == NULL || schedule->suspended_queue == NULL) {
         // Check for NULL pointers
         return -1; // Return -1 on error
     }
 
-    // Search for the process in the Suspended Queue or resume the first process
-    Hake_process_s *process_to_resume = NULL;
-    Hake_process_s *prev = NULL;
-
+    // Look up the process in the Suspended Queue or resume the first process
     if (pid == 0) {
-        // Resume the first (head) process in the Suspended Queue
         process_to_resume = schedule->suspended_queue->head;
-        if (process_to_resume != NULL) {
-            schedule->suspended_queue->head = process_to_resume->next;
-        }
     } else {
-        // Search for the process with the given PID in the Suspended Queue
-        Hake_process_s *current = schedule->suspended_queue->head;
-
-        while (current != NULL) {
-            if (current->pid == pid) {
-                if (prev != NULL) {
-                    prev->next = current->next;
-                } else {
-                    schedule->suspended_queue->head = current->next;
-                }
-                process_to_resume = current;
-                break;
-            }
-            prev = current;
-            current = current->next;
-        }
+        process_to_resume = index_find(schedule->index, pid);
     }
+    if (process_to_resume == NULL || !(process_to_resume->state & HAKE_STATE_SUSPENDED)) {
+        return -1; // Return -1 if the process was not found in the Suspended Queue
+    }
+    queue_remove(schedule->suspended_queue, process_to_resume);
+    now = monotonic_clock_ns();
 
-    if (process_to_resume != NULL) {
-        // Set the Ready State bit of the state member to 1
-        process_to_resume->state = (process_to_resume->state & 0xFFFFFFF) | 0x80000000;
-
-        // Set the next of the removed process to NULL
-        process_to_resume->next = NULL;
-
-        // Insert the resumed process in ascending PID order to the Ready Queue
-        Hake_process_s *current = schedule->ready_queue->head;
-        Hake_process_s *prev = NULL;
-
-        while (current != NULL && current->pid < process_to_resume->pid) {
-            prev = current;
-            current = current->next;
-        }
-
-        if (prev == NULL) {
-            // Insert at the beginning of the Ready Queue
-            process_to_resume->next = schedule->ready_queue->head;
-            schedule->ready_queue->head = process_to_resume;
-        } else {
-            // Insert after 'prev'
-            prev->next = process_to_resume;
-            process_to_resume->next = current;
-        }
-
-        return 0; // Return 0 on success
+    // Deadlines don't run while Suspended, so a deadline process starts a fresh job
+    if (process_to_resume->deadline_ns > 0) {
+        edf_release_job(process_to_resume, now);
     }
 
-    return -1; // Return -1 if the process was not found
+    // Sets the Ready State bit and places it back into its Ready lane
+    ready_add(schedule, process_to_resume, now);
+
+    return 0; // Return 0 on success
 }
 
 /* This is called when a process exits normally that was just Running.
  * Put the given node into the Terminated Queue and set the Exit Code 
  * - Do not create a new process to insert, insert the SAME process passed in.
+ * - With a retention of keep == 0 (see hake_set_retention) the process is evicted and freed at once,
+ *   so callers must not touch it after this returns.
  * Follow the project documentation for this function.
  * Returns a 0 on success or a -1 on any error.
  */
 int hake_exited(Hake_schedule_s *schedule, Hake_process_s *process, int exit_code) {
-   if (schedule == NULL || schedule->terminated_queue == NULL || process == NULL) {
+    Hake_process_s *existing = NULL;
+
+    if (schedule == NULL || schedule->terminated_queue == NULL || process == NULL) {
         // Check for NULL pointers
         return -1; // Return -1 on error
     }
 
-    // Set the Terminated State bit of the state member to 1
-    process->state = (process->state & 0xFFFFFFF) | 0x10000000;
-
-    // Set the lower 27 bits of the state member to the exit_code
-    process->state = (process->state & 0xFF000000) | (exit_code & 0x07FFFFFF);
-
-    // Insert the process into the Terminated Queue in ascending PID order
-    Hake_process_s *current = schedule->terminated_queue->head;
-    Hake_process_s *prev = NULL;
-
-    while (current != NULL && current->pid < process->pid) {
-        prev = current;
-        current = current->next;
+    // A process that is still in one of the Queues has to go through hake_terminated instead
+    existing = index_find(schedule->index, process->pid);
+    if (existing == process && !(process->state & HAKE_STATE_RUNNING)) {
+        return -1;
     }
-
-    if (prev == NULL) {
-        // Insert at the beginning of the Terminated Queue
-        process->next = schedule->terminated_queue->head;
-        schedule->terminated_queue->head = process;
-    } else {
-        // Insert after 'prev'
-        prev->next = process;
-        process->next = current;
+    if ((existing == NULL || (existing->state & HAKE_STATE_TERMINATED)) &&
+        index_put(schedule->index, process) == -1) {
+        return -1;
+    }
+    // Its last run ends here
+    if (process->run_start_ns > 0) {
+        process->run_ns += monotonic_clock_ns() - process->run_start_ns;
     }
 
+    // Set the Terminated State bit and the Exit Code, then append it to the Terminated Queue
+    terminated_add(schedule, process, exit_code);
+
     return 0; // Return 0 on success
 }
 
@@ -438,128 +2381,473 @@ int hake_exited(Hake_schedule_s *schedule, Hake_process_s *process, int exit_cod
  * - The difference with hake_exited is that this process is in one of your Queues already.
  * Remove the process with matching pid from the Ready or Suspended Queue and add the Exit Code to it.
  * - You have to check both since it could be in either queue.
+ * - Like hake_exited, this may free the process (when keep == 0), so don't hold on to it across the call.
  * Follow the project documentation for this function.
  * Returns a 0 on success or a -1 on any error.
  */
 int hake_terminated(Hake_schedule_s *schedule, pid_t pid, int exit_code) {
-  if (schedule == NULL || schedule->terminated_queue == NULL) {
+    Hake_process_s *process_to_terminate = NULL;
+
+    if (schedule == NULL || schedule->policy == NULL || schedule->terminated_queue == NULL || pid == 0) {
         // Check for NULL pointers
         return -1; // Return -1 on error
     }
 
-    // Search for the process in the Ready Queue or Suspended Queue
-    Hake_process_s *process_to_terminate = NULL;
-    Hake_process_s *prev = NULL;
+    // One index lookup covers both the Ready and the Suspended Queue
+    process_to_terminate = index_find(schedule->index, pid);
+    if (process_to_terminate == NULL) {
+        return -1; // Return -1 if the PID was not found
+    }
+    if (process_to_terminate->state & HAKE_STATE_READY) {
+        schedule->policy->remove(schedule->policy_data, process_to_terminate);
+        schedule->ready_queue->count--;
+        ready_leave(process_to_terminate, monotonic_clock_ns());
+    } else if (process_to_terminate->state & HAKE_STATE_SUSPENDED) {
+        queue_remove(schedule->suspended_queue, process_to_terminate);
+    } else {
+        return -1; // Running or already Terminated
+    }
 
-    // Search in the Ready Queue
-    Hake_process_s *current = schedule->ready_queue->head;
-    while (current != NULL) {
-        if (current->pid == pid) {
-            if (prev != NULL) {
-                prev->next = current->next;
-            } else {
-                schedule->ready_queue->head = current->next;
-            }
-            process_to_terminate = current;
-            break;
-        }
-        prev = current;
-        current = current->next;
+    // Set the Terminated State bit and the Exit Code, then append it to the Terminated Queue
+    terminated_add(schedule, process_to_terminate, exit_code);
+
+    return 0; // Return 0 on success
+}
+
+/* Releases a Running process (one returned by hake_select) from this schedule's PID index,
+ * so it can be inserted into another schedule (e.g. when a CPU steals work).
+ * Returns a 0 on success or a -1 on any error.
+ */
+int hake_detach(Hake_schedule_s *schedule, Hake_process_s *process) {
+    if (schedule == NULL || schedule->index == NULL || process == NULL ||
+        !(process->state & HAKE_STATE_RUNNING) || index_find(schedule->index, process->pid) != process) {
+        return -1;
     }
+    index_delete(schedule->index, process);
+    edf_unreserve(schedule, process); // The new schedule reserves it on insert
+    return 0;
+}
 
-    // If not found in Ready Queue, search in the Suspended Queue
-    if (process_to_terminate == NULL) {
+/* Frees all allocated memory in the Hake_schedule_s, all of the Queues, and all of their Nodes.
+ * - When this is the last live schedule, the whole node arena is released in one step,
+ *   including any node still on the CPU or never inserted.
+ * - Otherwise, only this schedule's nodes are returned to the arena's free list.
+ * Follow the project documentation for this function.
+ * Returns void.
+ */
+void hake_deallocate(Hake_schedule_s *schedule)
+{
+    Hake_process_s *current = NULL;
+
+    if (schedule == NULL) {
+        return; // Return if the schedule is already NULL
+    }
+
+    // Flush out the archive of older Terminated processes
+    if (schedule->archive->log != NULL) {
+        fclose(schedule->archive->log);
+    }
+
+    pthread_mutex_lock(&g_arena.lock);
+    if (--g_arena.users == 0) {
+        // Last schedule out releases every node and command string at once
+        arena_release();
+        pthread_mutex_unlock(&g_arena.lock);
+    } else {
+        pthread_mutex_unlock(&g_arena.lock);
+
+        // Return all Nodes from the Ready Queue
+        current = hake_ready_first(schedule);
+        while (current != NULL) {
+            Hake_process_s *next = hake_ready_next(schedule, current);
+            hake_free_process(current);
+            current = next;
+        }
+
+        // Return all Nodes from the Suspended and Terminated Queues
         current = schedule->suspended_queue->head;
-        prev = NULL;
         while (current != NULL) {
-            if (current->pid == pid) {
-                if (prev != NULL) {
-                    prev->next = current->next;
-                } else {
-                    schedule->suspended_queue->head = current->next;
-                }
-                process_to_terminate = current;
-                break;
-            }
-            prev = current;
-            current = current->next;
+            Hake_process_s *next = current->next;
+            hake_free_process(current);
+            current = next;
+        }
+        current = schedule->terminated_queue->head;
+        while (current != NULL) {
+            Hake_process_s *next = current->next;
+            hake_free_process(current);
+            current = next;
         }
     }
 
-    if (process_to_terminate != NULL) {
-        // Set the Terminated State bit of the state member to 1
-        process_to_terminate->state = (process_to_terminate->state & 0x40000000) | 0x10000000;
+    // Free the Queues and the policy data
+    free(schedule->ready_queue);
+    free(schedule->suspended_queue);
+    free(schedule->terminated_queue);
+    schedule->policy->destroy(schedule->policy_data);
+    free(schedule->index->slots);
+    free(schedule->index);
+    free(schedule->archive);
+
+    // Free the Hake Schedule
+    free(schedule);
+}
 
-        // Set the lower 27 bits of the state member to the exit_code
-        process_to_terminate->state = (process_to_terminate->state & 0xF8000000) | (exit_code & 0x07FFFFFF);
+/* Sets how many Terminated processes stay in memory and where older ones are archived.
+ * - archive_path is opened for appending as CSV (a header is written to a new file);
+ *   NULL closes any archive, so older processes are dropped after eviction.
+ * - Lowering keep evicts the excess right away.
+ * - Evicted processes are freed, so with keep == 0 hake_exited and hake_terminated free the process they end.
+ * Returns a 0 on success or a -1 on any error (the previous archive stays in place).
+ */
+int hake_set_retention(Hake_schedule_s *schedule, int keep, const char *archive_path) {
+    FILE *log = NULL;
 
-        // Insert the terminated process in ascending PID order to the Terminated Queue
-        current = schedule->terminated_queue->head;
-        prev = NULL;
+    if (schedule == NULL || schedule->archive == NULL || keep < 0 ||
+        (archive_path != NULL && strlen(archive_path) >= MAX_PATH)) {
+        return -1;
+    }
 
-        while (current != NULL && current->pid < process_to_terminate->pid) {
-            prev = current;
-            current = current->next;
+    if (archive_path != NULL) {
+        log = fopen(archive_path, "a");
+        if (log == NULL) {
+            return -1;
         }
+        // One write per record, so several schedules can append to the same archive
+        setvbuf(log, NULL, _IOLBF, 0);
+        if (ftell(log) == 0) {
+            fputs("pid,priority,critical,exit_code,start_ns,end_ns,cmd\n", log);
+        }
+        strncpy(schedule->archive->path, archive_path, MAX_PATH);
+    } else {
+        schedule->archive->path[0] = '\0';
+    }
+    if (schedule->archive->log != NULL) {
+        fclose(schedule->archive->log);
+    }
+    schedule->archive->log = log;
 
-        if (prev == NULL) {
-            // Insert at the beginning of the Terminated Queue
-            process_to_terminate->next = schedule->terminated_queue->head;
-            schedule->terminated_queue->head = process_to_terminate;
-        } else {
-            // Insert after 'prev'
-            prev->next = process_to_terminate;
-            process_to_terminate->next = current;
+    schedule->archive->keep = keep;
+    while (schedule->archive->retained > keep) {
+        terminated_evict(schedule);
+    }
+    return 0;
+}
+
+/* Returns the tracked process with matching pid from any Queue (or on the CPU) in O(1).
+ * Returns NULL if the pid is not tracked or on any error.
+ */
+Hake_process_s *hake_find(Hake_schedule_s *schedule, pid_t pid) {
+    if (schedule == NULL || schedule->index == NULL || pid <= 0) {
+        return NULL;
+    }
+    return index_find(schedule->index, pid);
+}
+
+/* Returns the age of a process, bringing its age member up to date if it is in the Ready Queue.
+ * - Ready ages are derived from the select epoch, so the stored member is only refreshed here
+ *   and whenever the process leaves the Ready Queue (for policies that keep ages lazily).
+ * Returns the age or -1 on any error.
+ */
+int hake_get_age(Hake_schedule_s *schedule, Hake_process_s *process) {
+    if (schedule == NULL || schedule->policy == NULL || process == NULL) {
+        return -1;
+    }
+    if ((process->state & HAKE_STATE_READY) && schedule->policy->age_of != NULL) {
+        process->age = schedule->policy->age_of(schedule->policy_data, process);
+    }
+    return process->age;
+}
+
+/* Returns the first process of the Ready Queue in selection order (the one hake_select would pick).
+ * Returns NULL if the Ready Queue is empty or on any error.
+ */
+Hake_process_s *hake_ready_first(Hake_schedule_s *schedule) {
+    if (schedule == NULL || schedule->policy == NULL) {
+        return NULL;
+    }
+    return schedule->policy->first(schedule->policy_data);
+}
+
+/* Returns the process following the given one in selection order.
+ * - For the default policy: Critical lane, Starving lane, then each occupied priority level in turn.
+ * Returns NULL after the last Ready process or on any error.
+ */
+Hake_process_s *hake_ready_next(Hake_schedule_s *schedule, Hake_process_s *process) {
+    if (schedule == NULL || schedule->policy == NULL || process == NULL) {
+        return NULL;
+    }
+    return schedule->policy->next(schedule->policy_data, process);
+}
+
+/* Admits a new process as a deadline (EDF) process before it is inserted.
+ * - Each job needs runtime_ns of CPU within deadline_ns; admitted processes become Critical.
+ * - Admission fails if the reserved utilization would exceed HAKE_EDF_CAPACITY_PPM.
+ * - The utilization is reserved here, so admissions made before their inserts can't overcommit
+ *   the schedule together. The process must then be inserted into this same schedule, which
+ *   keeps the reservation until it terminates.
+ * Returns a 0 on success or a -1 on any error (including rejection).
+ */
+int hake_admit(Hake_schedule_s *schedule, Hake_process_s *process, long long deadline_ns, long long runtime_ns) {
+    long long utilization = 0;
+
+    if (schedule == NULL || schedule->index == NULL || process == NULL || deadline_ns <= 0 ||
+        runtime_ns <= 0 || runtime_ns > deadline_ns || process->edf_reserved ||
+        index_find(schedule->index, process->pid) == process) {
+        return -1;
+    }
+    utilization = (runtime_ns * 1000000LL + deadline_ns - 1) / deadline_ns;
+    if (schedule->edf_util_ppm + utilization > HAKE_EDF_CAPACITY_PPM) {
+        return -1;
+    }
+    process->deadline_ns = deadline_ns;
+    process->runtime_ns = runtime_ns;
+    process->state |= HAKE_STATE_CRITICAL;
+    edf_reserve(schedule, process);
+    return 0;
+}
+
+/* Returns how long a process just returned by hake_select should run, if its policy decides that.
+ * Returns the slice in ns, or 0 to use the caller's fixed quantum (or on any error).
+ */
+long long hake_get_slice(Hake_schedule_s *schedule, Hake_process_s *process) {
+    if (schedule == NULL || schedule->policy == NULL || process == NULL || schedule->policy->slice == NULL) {
+        return 0;
+    }
+    return schedule->policy->slice(schedule->policy_data, process);
+}
+
+/* Adapts a process' own quantum to how much of its last slice it spent on the CPU.
+ * - base_ns is the slice it starts from; ran_ns is how long its last slice ran, and cpu_ns how
+ *   much CPU time it used in it (a process that blocks, eg. sleeping on I/O, uses little).
+ * - Using nearly all of it (HAKE_QUANTUM_GROW_PCT) doubles the quantum, so batch work switches less;
+ *   blocking early (under HAKE_QUANTUM_SHRINK_PCT) halves it, so a sleeper gives the CPU back sooner.
+ * - The quantum always stays within SLEEP_MIN_USEC..SLEEP_MAX_USEC.
+ * Returns the process' quantum for its next slice in ns, or 0 on any error.
+ */
+long long hake_adapt_quantum(Hake_process_s *process, long long base_ns, long long ran_ns, long long cpu_ns) {
+    long long quantum_ns = 0;
+
+    if (process == NULL || base_ns <= 0) {
+        return 0;
+    }
+    quantum_ns = (process->quantum_ns > 0) ? process->quantum_ns : base_ns;
+    if (ran_ns > 0 && cpu_ns >= 0) {
+        if (cpu_ns * 100 >= ran_ns * HAKE_QUANTUM_GROW_PCT) {
+            quantum_ns *= 2;
+        } else if (cpu_ns * 100 < ran_ns * HAKE_QUANTUM_SHRINK_PCT) {
+            quantum_ns /= 2;
         }
+    }
+    if (quantum_ns < SLEEP_MIN_USEC * 1000LL) {
+        quantum_ns = SLEEP_MIN_USEC * 1000LL;
+    } else if (quantum_ns > SLEEP_MAX_USEC * 1000LL) {
+        quantum_ns = SLEEP_MAX_USEC * 1000LL;
+    }
+    process->quantum_ns = quantum_ns;
+    return quantum_ns;
+}
 
-        return 0; // Return 0 on success
+/* Charges a running process for the CPU time it used over its current slice, before hake_insert.
+ * - total_cpu_ns is the process' whole CPU time so far (eg. from /proc/<pid>/schedstat); the slice
+ *   is the part since the last charge, which hake_insert then uses in place of the time it held
+ *   the CPU, for the policies that charge runs (cfs vruntime, EDF jobs).
+ * Returns a 0 on success or a -1 on any error (including a total below the one already charged).
+ */
+int hake_charge_cpu(Hake_process_s *process, long long total_cpu_ns) {
+    if (process == NULL || !(process->state & HAKE_STATE_RUNNING) || total_cpu_ns < process->cpu_ns) {
+        return -1;
     }
+    process->slice_cpu_ns = total_cpu_ns - process->cpu_ns;
+    process->cpu_ns = total_cpu_ns;
+    return 0;
+}
 
-    return -1; // Return -1 if the PID was not found
+/* Returns the total time (ns) a process has spent Ready, including the wait it is in now.
+ * Returns the wait time or -1 on any error.
+ */
+long long hake_get_wait(Hake_process_s *process) {
+    if (process == NULL) {
+        return -1;
+    }
+    if (process->ready_since_ns > 0) {
+        return process->wait_ns + monotonic_clock_ns() - process->ready_since_ns;
+    }
+    return process->wait_ns;
 }
 
-/* Frees all allocated memory in the Hake_schedule_s, all of the Queues, and all of their Nodes.
- * Follow the project documentation for this function.
- * Returns void.
+/* Returns 1 if a Ready process outranks a running one under the schedule's policy, so the
+ *   caller should preempt the running process now rather than at the end of its quantum.
+ * - Policies without an outranks hook only let Critical processes preempt non-Critical ones.
+ * Returns 1 to preempt, or 0 if not (or on any error).
  */
-void hake_deallocate(Hake_schedule_s *schedule)
-{
-   if (schedule == NULL) {
-        return; // Return if the schedule is already NULL
+int hake_outranks(Hake_schedule_s *schedule, Hake_process_s *ready, Hake_process_s *running) {
+    if (schedule == NULL || schedule->policy == NULL || ready == NULL || running == NULL || ready == running) {
+        return 0;
+    }
+    if (schedule->policy->outranks != NULL) {
+        return schedule->policy->outranks(schedule->policy_data, ready, running) ? 1 : 0;
     }
+    return rank_outranks(ready, running, 0, 0);
+}
 
-    // Free all Nodes from the Ready Queue
-    Hake_process_s *current = schedule->ready_queue->head;
-    while (current != NULL) {
-        Hake_process_s *next = current->next;
-        free(current->cmd); // Free the cmd String
-        free(current); // Free the process node
-        current = next;
+/* Chooses the min reduction kernel for soa ready sets created from now on (existing ones keep theirs).
+ * - name is "avx2", "sse4.1", or "scalar"; NULL (or one this CPU lacks) picks the widest supported.
+ * Returns the name of the kernel now in use.
+ */
+const char *hake_set_soa_kernel(const char *name) {
+    const Hake_soa_kernel_s *kernel = NULL;
+    int i = 0;
+
+    pthread_once(&g_soa_detect, soa_detect_kernel);
+    for (i = 0; name != NULL && i < HAKE_SOA_KERNELS; i++) {
+        // Kernels are ordered widest first, so any at or after the best one is supported
+        if (strcmp(g_soa_kernels[i].name, name) == 0 && &g_soa_kernels[i] >= g_soa_best) {
+            kernel = &g_soa_kernels[i];
+        }
     }
+    g_soa_kernel = (kernel != NULL) ? kernel : g_soa_best;
+    return g_soa_kernel->name;
+}
 
-    // Free all Nodes from the Suspended Queue
-    current = schedule->suspended_queue->head;
-    while (current != NULL) {
-        Hake_process_s *next = current->next;
-        free(current->cmd); // Free the cmd String
-        free(current); // Free the process node
-        current = next;
+/* Makes every schedule read the time (ns) from clock_ns instead of the system clocks, eg. a
+ *   simulator's virtual clock.  It stands in for both the wall clock and the monotonic clock.
+ * - NULL goes back to the system clocks.  Set it before creating processes, not while they run.
+ */
+void hake_set_clock(long long (*clock_ns)()) {
+    g_clock = clock_ns;
+}
+
+/* Adds a policy to the registry, so hake_get_policy can find it by name.
+ * - Every hook but age_of is required, and names must be unique.
+ * Returns a 0 on success or a -1 on any error (including a full registry).
+ */
+int hake_register_policy(const Hake_policy_s *policy) {
+    int ret = 0;
+
+    if (policy == NULL || policy->name == NULL || policy->create == NULL || policy->destroy == NULL ||
+        policy->insert == NULL || policy->select == NULL || policy->remove == NULL ||
+        policy->tick == NULL || policy->first == NULL || policy->next == NULL) {
+        return -1;
+    }
+    if (hake_get_policy(policy->name) != NULL) {
+        return -1;
     }
 
-    // Free all Nodes from the Terminated Queue
-    current = schedule->terminated_queue->head;
-    while (current != NULL) {
-        Hake_process_s *next = current->next;
-        free(current->cmd); // Free the cmd String
-        free(current); // Free the process node
-        current = next;
+    pthread_mutex_lock(&g_registry.lock);
+    if (g_registry.count < HAKE_MAX_POLICIES) {
+        g_registry.policies[g_registry.count++] = policy;
+    } else {
+        ret = -1;
     }
+    pthread_mutex_unlock(&g_registry.lock);
+    return ret;
+}
 
-    // Free the Queues
-    free(schedule->ready_queue);
-    free(schedule->suspended_queue);
-    free(schedule->terminated_queue);
+/* Loads a policy from a shared object and registers it.
+ * - The object must export a const Hake_policy_s named HAKE_POLICY_SYMBOL.
+ * - The object stays loaded for the life of the program, since schedules may still use it.
+ * Returns the registered policy or NULL on any error (printed as a warning).
+ */
+const Hake_policy_s *hake_load_policy(const char *path) {
+    const Hake_policy_s *policy = NULL;
+    void *handle = NULL;
 
-    // Free the Hake Schedule
-    free(schedule);
+    if (path == NULL) {
+        return NULL;
+    }
+    handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        PRINT_WARNING("Could not load policy: %s", dlerror());
+        return NULL;
+    }
+    policy = (const Hake_policy_s *)dlsym(handle, HAKE_POLICY_SYMBOL);
+    if (policy == NULL) {
+        PRINT_WARNING("%s does not export %s", path, HAKE_POLICY_SYMBOL);
+        dlclose(handle);
+        return NULL;
+    }
+    if (hake_get_policy(policy->name) == policy) {
+        return policy; // Loaded before (dlopen handed back the same object)
+    }
+    if (hake_register_policy(policy) == -1) {
+        PRINT_WARNING("Could not register policy from %s (incomplete, duplicate name, or registry full)", path);
+        dlclose(handle);
+        return NULL;
+    }
+    return policy;
+}
+
+/* Returns the registered policy with the given name (NULL for the default policy).
+ * Returns NULL if there is no such policy.
+ */
+const Hake_policy_s *hake_get_policy(const char *name) {
+    const Hake_policy_s *found = NULL;
+    int i = 0;
+
+    if (name == NULL) {
+        return &g_hake_policy;
+    }
+    pthread_mutex_lock(&g_registry.lock);
+    for (i = 0; i < g_registry.count && found == NULL; i++) {
+        if (strcmp(g_registry.policies[i]->name, name) == 0) {
+            found = g_registry.policies[i];
+        }
+    }
+    pthread_mutex_unlock(&g_registry.lock);
+    return found;
+}
+
+/* Returns the registered policy at the given position, for listing them.
+ * Returns NULL past the last policy.
+ */
+const Hake_policy_s *hake_get_policy_at(int index) {
+    const Hake_policy_s *policy = NULL;
+
+    pthread_mutex_lock(&g_registry.lock);
+    if (index >= 0 && index < g_registry.count) {
+        policy = g_registry.policies[index];
+    }
+    pthread_mutex_unlock(&g_registry.lock);
+    return policy;
+}
+
+/* Switches a schedule to another policy, moving every Ready process over with its age.
+ * - Suspended, Terminated, and Running processes are unaffected.
+ * - A policy with a drain hook is emptied in one pass (soa, where each first is a full argmin).
+ * Returns a 0 on success or a -1 on any error (the schedule keeps its old policy).
+ */
+int hake_set_policy(Hake_schedule_s *schedule, const Hake_policy_s *policy) {
+    Hake_process_s *current = NULL;
+    void *data = NULL;
+
+    if (schedule == NULL || schedule->policy == NULL || policy == NULL) {
+        return -1;
+    }
+    if (policy == schedule->policy) {
+        return 0;
+    }
+    data = policy->create();
+    if (data == NULL) {
+        return -1;
+    }
+
+    // Removing brings each age up to date, which the new policy keeps on insert
+    if (schedule->policy->drain != NULL) {
+        current = schedule->policy->drain(schedule->policy_data);
+        while (current != NULL) {
+            Hake_process_s *next = current->age_next;
+            current->age_next = NULL;
+            policy->insert(data, current);
+            current = next;
+        }
+    } else {
+        while ((current = schedule->policy->first(schedule->policy_data)) != NULL) {
+            schedule->policy->remove(schedule->policy_data, current);
+            policy->insert(data, current);
+        }
+    }
+    schedule->policy->destroy(schedule->policy_data);
+    schedule->policy = policy;
+    schedule->policy_data = data;
+    return 0;
 }
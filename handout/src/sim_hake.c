@@ -0,0 +1,882 @@
+/* sim_hake.c (Hake Scheduler Simulator, built with: make sim_hake, or built and run with: make sim)
+ *
+ *   Runs a synthetic workload through the Hake library on a virtual clock: no processes are
+ *   forked, no signals are sent, and nothing sleeps, so policy experiments that would take hours
+ *   of real slow_* processes finish in seconds.  It drives a single CPU the way a dispatcher does:
+ *   select, run for the quantum (or until the burst ends, or an arrival outranks it), charge the
+ *   CPU time used, then insert it back, suspend it for its I/O wait, or exit it.
+ *   Like test_hake_sched.c, this runs the Hake library without any of the TRILBY code.
+ *
+ *   Usage: ./sim_hake [-p policy] [-q quantum] [-f] [-s switch] [-g count] [-r seed] [-R recording] [-v] [workload]
+ *     -p  Policy name (hake, cfs, soa) or a shared object path (eg. ./hake_policy_fifo.so)
+ *     -q  Base quantum (SLEEP_USEC by default); -f keeps it fixed instead of adapting it per process
+ *     -s  Time each context switch costs the CPU (0 by default)
+ *     -g  Generates count processes (a mix of interactive, batch, and critical) instead of reading a workload
+ *     -R  Replays a VM session recorded with ./vm -R recording instead of reading a workload (see sim_replay_load)
+ *     -v  Prints a row for every process as well
+ *
+ *   A workload has one process per line (# starts a comment):
+ *     name  arrival  priority  critical  bursts
+ *   where bursts alternate CPU and I/O times separated by '/', optionally repeated with *N, and
+ *   times take a unit (ns, us, ms, s; ms if none) like the shell.  eg. workloads/mixed.txt
+ *     editor   0     200  0  2ms/150ms*100    # 100 rounds of 2ms CPU, then 150ms waiting on I/O
+ *     compile  1s    128  0  4s               # One 4 sec CPU burst
+ */
+
+/* Standard Library Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+/* Local Includes */
+#include "hake_sched.h"
+#include "vm_support.h"
+#include "vm_record.h"
+
+/* Globals (static means it's private to this file only) */
+int g_debug_mode = 0; // Keeps the library quiet while simulating
+
+#define SIM_EPOCH_NS   1000000000LL // Virtual time starts here, since Hake treats a time of 0 as unset
+#define SIM_MAX_LINE   512          // Longest workload line
+#define SIM_MAX_PHASES 64           // Most CPU and I/O times in one burst pattern
+#define SIM_FOREVER    (1 << 24)    // Repeats of a replayed process that only ends when it is terminated
+#define SIM_KILLED     9            // Exit code of a terminated process (SIGKILL, as the shell sends)
+
+// Simulated Process Definition
+typedef struct sim_process {
+  char name[32];
+  pid_t pid;
+  long long arrival_ns;       // When it arrives (virtual time from the start)
+  int priority;
+  int critical;
+  long long *pattern;         // CPU, I/O, CPU, ... times, repeated repeats times
+  int phases;
+  int repeats;
+  int step;                   // Index of its current CPU burst in the repeated pattern
+  long long left_ns;          // CPU time left in the current burst
+  long long cpu_ns;           // CPU time used so far
+  long long wake_ns;          // When its I/O wait ends
+  int waiting;                // 1 while it waits on I/O (in the wake heap)
+  int held;                   // 1 while suspended by a replayed suspend command
+  int killed;                 // 1 once a replayed terminate command is due while it runs
+  int done;                   // 1 once it has exited or been terminated
+  pid_t rec_pid;              // PID it had in the recording it is replayed from (0 if none)
+  Hake_process_s *node;
+  long long wait_ns;          // Results, set when it exits
+  long long response_ns;
+  long long turnaround_ns;
+} Sim_process_s;
+
+// Replayed Action Definition (a shell command, or the CS system starting or stopping, at a set time)
+typedef struct sim_action {
+  long long at_ns;            // When it happens (virtual time from the start)
+  int type;                   // RECORD_SUSPEND, RECORD_RESUME, RECORD_TERMINATE, RECORD_CS_START, or RECORD_CS_STOP
+  int index;                  // Process it is about (index into procs, -1 if none)
+} Sim_action_s;
+
+// What a recording says about one process, while its demand is being rebuilt
+typedef struct sim_replay {
+  long long exit_ns;          // When it exited (time from the start of the recording)
+  long long cpu_ns;           // CPU time it was charged
+  long long ready_ns;         // Time it spent Ready
+  long long held_ns;          // Time the shell had it suspended
+  long long held_since_ns;    // When the shell suspended it (-1 if it isn't)
+  int runs;                   // Times it was selected
+  int exited;
+  int terminated;             // 1 if the shell terminated it
+} Sim_replay_s;
+
+// Simulator State
+typedef struct sim_state {
+  Hake_schedule_s *schedule;
+  Sim_process_s *procs;       // Sorted by arrival (pid is index + 1)
+  int count;
+  int arrived;                // Processes admitted so far
+  int completed;              // Processes exited or terminated so far
+  Sim_action_s *actions;      // Replayed actions in time order (none unless replaying)
+  int num_actions;
+  int acted;                  // Actions taken so far
+  int cs_running;             // 0 while a replayed CS stop is in effect
+  int cut;                    // 1 if an action needs the running process off the CPU now
+  int *waking;                // Min heap (by wake_ns) of processes waiting on I/O
+  int sleepers;
+  long long base_ns;          // Base quantum
+  int adaptive;               // 1 adapts each process' quantum, like ADAPTIVE_QUANTUM in the VM
+  long long switch_ns;        // Cost of each context switch
+  long long decisions;        // Selects
+  long long switches;         // Selects of a different process than the last
+  long long preemptions;      // Slices cut short by an arrival that outranked the running process
+  long long busy_ns;          // Time the CPU ran processes
+} Sim_state_s;
+
+static long long g_now = SIM_EPOCH_NS; // The virtual clock (read by Hake through hake_set_clock)
+
+/* Local Prototypes */
+static long long sim_clock_ns();
+static unsigned int sim_random(unsigned int *seed);
+static long long sim_range(unsigned int *seed, long long low, long long high);
+static int sim_parse_bursts(Sim_process_s *proc, char *bursts);
+static int sim_load(Sim_state_s *sim, const char *path);
+static void sim_generate(Sim_state_s *sim, int count, unsigned int seed);
+static int sim_replay_load(Sim_state_s *sim, const char *path);
+static int sim_replay_find(Sim_state_s *sim, pid_t rec_pid);
+static void sim_add_action(Sim_state_s *sim, long long at_ns, int type, int index);
+static void sim_act(Sim_state_s *sim, Sim_action_s *action, Hake_process_s *running, int *outranked);
+static void sim_retire(Sim_state_s *sim, Sim_process_s *proc, Hake_process_s *node);
+static int sim_by_arrival(const void *a, const void *b);
+static void sim_heap_push(Sim_state_s *sim, int index);
+static int sim_heap_pop(Sim_state_s *sim);
+static long long sim_next_event(Sim_state_s *sim);
+static int sim_admit(Sim_state_s *sim, Hake_process_s *running);
+static int sim_next_burst_io(Sim_process_s *proc, long long *io_ns);
+static void sim_run(Sim_state_s *sim);
+static int sim_compare(const void *a, const void *b);
+static void sim_percentiles(long long *values, int n, long long out[3]);
+static void sim_report(Sim_state_s *sim, long long host_ns, int verbose);
+
+int main(int argc, char *argv[]) {
+  Sim_state_s sim = {0};
+  const Hake_policy_s *policy = NULL;
+  const char *policy_name = HAKE_DEFAULT_POLICY;
+  const char *replay_path = NULL;
+  unsigned int seed = 2463534242U;
+  int generate = 0;
+  int verbose = 0;
+  int opt = 0;
+  long long host_ns = 0;
+
+  sim.base_ns = SLEEP_USEC * 1000LL;
+  sim.adaptive = (ADAPTIVE_QUANTUM > 0);
+  sim.cs_running = 1;
+  while((opt = getopt(argc, argv, "p:q:fs:g:r:R:v")) != -1) {
+    switch(opt) {
+      case 'p': policy_name = optarg; break;
+      case 'q': sim.base_ns = extract_duration(optarg, NULL); break;
+      case 'f': sim.adaptive = 0; break;
+      case 's': sim.switch_ns = extract_duration(optarg, NULL); break;
+      case 'g': generate = atoi(optarg); break;
+      case 'r': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+      case 'R': replay_path = optarg; break;
+      case 'v': verbose = 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-p policy] [-q quantum] [-f] [-s switch] [-g count] [-r seed] [-R recording] [-v] [workload]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+  if(sim.base_ns <= 0 || sim.switch_ns < 0 || seed == 0 || (generate <= 0 && replay_path == NULL && optind >= argc)) {
+    fprintf(stderr, "%s: needs a positive quantum, a nonzero seed, and a workload file, -g count, or -R recording\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Every Hake time (arrival, runs, waits) comes from the virtual clock
+  hake_set_clock(sim_clock_ns);
+  sim.schedule = hake_create();
+  policy = hake_get_policy(policy_name);
+  if(policy == NULL && strchr(policy_name, '/') != NULL) {
+    policy = hake_load_policy(policy_name);
+  }
+  if(sim.schedule == NULL || policy == NULL || hake_set_policy(sim.schedule, policy) != 0) {
+    fprintf(stderr, "%s: could not set up a schedule with policy %s\n", argv[0], policy_name);
+    return EXIT_FAILURE;
+  }
+  if(generate > 0) {
+    sim_generate(&sim, generate, seed);
+  }
+  else if(replay_path != NULL) {
+    if(sim_replay_load(&sim, replay_path) != 0) {
+      return EXIT_FAILURE;
+    }
+  }
+  else if(sim_load(&sim, argv[optind]) != 0) {
+    return EXIT_FAILURE;
+  }
+  sim.waking = malloc((sim.count ? sim.count : 1) * sizeof(int));
+  if(sim.waking == NULL) {
+    ABORT_ERROR("...out of memory for the simulation!");
+  }
+
+  host_ns = monotonic_ns();
+  sim_run(&sim);
+  host_ns = monotonic_ns() - host_ns;
+  sim_report(&sim, host_ns, verbose);
+
+  hake_deallocate(sim.schedule);
+  for(int i = 0; i < sim.count; i++) {
+    free(sim.procs[i].pattern);
+  }
+  free(sim.procs);
+  free(sim.waking);
+  free(sim.actions);
+  return 0;
+}
+
+/* Returns the virtual clock, for Hake. */
+static long long sim_clock_ns() {
+  return g_now;
+}
+
+/* Returns the next value of a small deterministic generator (xorshift32), so every run sees the same workload. */
+static unsigned int sim_random(unsigned int *seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+}
+
+/* Returns a pseudo-random value in low..high. */
+static long long sim_range(unsigned int *seed, long long low, long long high) {
+  return low + (long long)(((unsigned long long)sim_random(seed) << 32 | sim_random(seed)) % (unsigned long long)(high - low + 1));
+}
+
+/* Parses a burst pattern (eg. 2ms/150ms*100) into a process.
+ * Returns 0 on success or -1 if it is malformed (every CPU time must be positive).
+ */
+static int sim_parse_bursts(Sim_process_s *proc, char *bursts) {
+  long long phases[SIM_MAX_PHASES];
+  char *p = bursts;
+
+  proc->phases = 0;
+  proc->repeats = 1;
+  while(*p != '\0' && *p != '*') {
+    long long value = extract_duration(p, &p);
+    if(value < 0 || proc->phases == SIM_MAX_PHASES || (proc->phases % 2 == 0 && value == 0)) {
+      return -1;
+    }
+    phases[proc->phases++] = value;
+    if(*p == '/') {
+      p++;
+    }
+    else if(*p != '\0' && *p != '*') {
+      return -1;
+    }
+  }
+  if(*p == '*') {
+    proc->repeats = atoi(p + 1);
+  }
+  if(proc->phases == 0 || proc->repeats < 1) {
+    return -1;
+  }
+  proc->pattern = malloc(proc->phases * sizeof(long long));
+  if(proc->pattern == NULL) {
+    return -1;
+  }
+  memcpy(proc->pattern, phases, proc->phases * sizeof(long long));
+  return 0;
+}
+
+/* Reads a workload file into the simulator.
+ * Returns 0 on success or -1 on any error (which is printed).
+ */
+static int sim_load(Sim_state_s *sim, const char *path) {
+  char line[SIM_MAX_LINE];
+  int capacity = 0;
+  int number = 0;
+  FILE *file = fopen(path, "r");
+
+  if(file == NULL) {
+    fprintf(stderr, "Could not open the workload %s\n", path);
+    return -1;
+  }
+  while(fgets(line, sizeof(line), file) != NULL) {
+    char name[32];
+    char arrival[32];
+    char bursts[SIM_MAX_LINE];
+    Sim_process_s *proc = NULL;
+    int priority = 0;
+    int critical = 0;
+    char *comment = strchr(line, '#');
+    number++;
+    if(comment != NULL) {
+      *comment = '\0';
+    }
+    if(sscanf(line, "%31s", name) != 1) {
+      continue; // Blank or comment only
+    }
+    if(sim->count == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      sim->procs = realloc(sim->procs, capacity * sizeof(Sim_process_s));
+      if(sim->procs == NULL) {
+        ABORT_ERROR("...out of memory reading the workload!");
+      }
+    }
+    proc = &sim->procs[sim->count];
+    memset(proc, 0, sizeof(*proc));
+    if(sscanf(line, "%31s %31s %d %d %511s", name, arrival, &priority, &critical, bursts) != 5 ||
+       (proc->arrival_ns = extract_duration(arrival, NULL)) < 0 || priority < MIN_PRIORITY || priority > MAX_PRIORITY ||
+       sim_parse_bursts(proc, bursts) != 0) {
+      fprintf(stderr, "%s:%d: expected: name arrival priority critical cpu[/io/cpu...][*repeats]\n", path, number);
+      fclose(file);
+      return -1;
+    }
+    snprintf(proc->name, sizeof(proc->name), "%s", name);
+    proc->priority = priority;
+    proc->critical = (critical != 0);
+    sim->count++;
+  }
+  fclose(file);
+  qsort(sim->procs, sim->count, sizeof(Sim_process_s), sim_by_arrival);
+  return 0;
+}
+
+/* Generates a mixed workload: 70% interactive (short CPU bursts between I/O waits), 25% batch (one long
+ *   CPU burst), and 5% critical (tiny bursts every 50ms), arriving at random at about 90% CPU load.
+ */
+static void sim_generate(Sim_state_s *sim, int count, unsigned int seed) {
+  sim->procs = calloc(count, sizeof(Sim_process_s));
+  if(sim->procs == NULL) {
+    ABORT_ERROR("...out of memory generating the workload!");
+  }
+  for(int i = 0; i < count; i++) {
+    Sim_process_s *proc = &sim->procs[i];
+    int kind = sim_random(&seed) % 100;
+    proc->arrival_ns = sim_range(&seed, 0, count * 520000000LL); // The mix averages about 466ms of CPU each
+    proc->priority = sim_range(&seed, MIN_PRIORITY, MAX_PRIORITY);
+    proc->pattern = malloc(2 * sizeof(long long));
+    if(proc->pattern == NULL) {
+      ABORT_ERROR("...out of memory generating the workload!");
+    }
+    if(kind < 70) {
+      snprintf(proc->name, sizeof(proc->name), "interactive");
+      proc->pattern[0] = sim_range(&seed, 1000000LL, 20000000LL);
+      proc->pattern[1] = sim_range(&seed, 5000000LL, 100000000LL);
+      proc->phases = 2;
+      proc->repeats = sim_range(&seed, 5, 50);
+    }
+    else if(kind < 95) {
+      snprintf(proc->name, sizeof(proc->name), "batch");
+      proc->pattern[0] = sim_range(&seed, 100000000LL, 2000000000LL);
+      proc->phases = 1;
+      proc->repeats = 1;
+    }
+    else {
+      snprintf(proc->name, sizeof(proc->name), "critical");
+      proc->pattern[0] = 1000000LL;
+      proc->pattern[1] = 49000000LL;
+      proc->phases = 2;
+      proc->repeats = 20;
+      proc->critical = 1;
+    }
+  }
+  sim->count = count;
+  qsort(sim->procs, sim->count, sizeof(Sim_process_s), sim_by_arrival);
+}
+
+/* Orders processes by arrival for qsort. */
+static int sim_by_arrival(const void *a, const void *b) {
+  const Sim_process_s *x = a;
+  const Sim_process_s *y = b;
+  return (x->arrival_ns > y->arrival_ns) - (x->arrival_ns < y->arrival_ns);
+}
+
+/* Reads a VM recording (./vm -R) into the simulator: its processes, plus the shell's actions to replay.
+ * - Each process arrives when it started, at its recorded priority.  Its demand is rebuilt from how it
+ *   exited: its CPU time split evenly over the times it was selected, with the rest of its life (less
+ *   the time it spent Ready or suspended by the shell) as the I/O waits between them.
+ * - A process the shell terminated runs that pattern until its terminate comes up, and one that had
+ *   not finished when the recording ended is CPU bound and terminated there.
+ * - Suspend, resume, and terminate commands and CS starts and stops happen at their recorded times
+ *   (a suspend or resume without a PID, meaning the default process, is skipped).  The CS system
+ *   starts stopped, as in the VM, and runs from the end of the recording on.
+ * Returns 0 on success or -1 on any error (which is printed).
+ */
+static int sim_replay_load(Sim_state_s *sim, const char *path) {
+  char magic[RECORD_MAGIC_LEN];
+  char text[MAX_CMD_LINE];
+  Record_event_s event;
+  Sim_replay_s *replay = NULL;
+  int capacity = 0;
+  int commands = 0;
+  int skipped = 0;
+  int unfinished = 0;
+  long long end_ns = 0;
+  FILE *file = fopen(path, "rb");
+
+  if(file == NULL) {
+    fprintf(stderr, "Could not open the recording %s\n", path);
+    return -1;
+  }
+  if(fread(magic, 1, RECORD_MAGIC_LEN, file) != RECORD_MAGIC_LEN || memcmp(magic, RECORD_MAGIC, RECORD_MAGIC_LEN) != 0) {
+    fprintf(stderr, "%s is not a TRILBY recording (from ./vm -R)\n", path);
+    fclose(file);
+    return -1;
+  }
+  while(fread(&event, sizeof(event), 1, file) == 1) {
+    size_t keep = (event.len < sizeof(text)) ? event.len : sizeof(text) - 1;
+    int index = -1;
+    if(fread(text, 1, keep, file) != keep || fseek(file, event.len - keep, SEEK_CUR) != 0) {
+      break; // Cut short, eg. the VM crashed; replay what there is
+    }
+    text[keep] = '\0';
+    end_ns = event.ns;
+    switch(event.type) {
+      case RECORD_BEGIN:
+        printf("Replaying:   %s, recorded on %d CPU(s) under %s with a %lld usec quantum\n", path, event.arg, text,
+            event.value / 1000);
+        break;
+      case RECORD_COMMAND:
+        commands++;
+        break;
+      case RECORD_START: {
+        char *name = strtok(text, " \t");
+        char *base = (name != NULL) ? strrchr(name, '/') : NULL;
+        if(sim->count == capacity) {
+          capacity = capacity ? capacity * 2 : 64;
+          sim->procs = realloc(sim->procs, capacity * sizeof(Sim_process_s));
+          replay = realloc(replay, capacity * sizeof(Sim_replay_s));
+          if(sim->procs == NULL || replay == NULL) {
+            ABORT_ERROR("...out of memory reading the recording!");
+          }
+        }
+        memset(&sim->procs[sim->count], 0, sizeof(Sim_process_s));
+        memset(&replay[sim->count], 0, sizeof(Sim_replay_s));
+        snprintf(sim->procs[sim->count].name, sizeof(sim->procs[0].name), "%s", base ? base + 1 : name ? name : "?");
+        sim->procs[sim->count].arrival_ns = event.ns;
+        sim->procs[sim->count].priority = (event.arg < MIN_PRIORITY) ? MIN_PRIORITY : (event.arg > MAX_PRIORITY) ? MAX_PRIORITY : event.arg;
+        sim->procs[sim->count].critical = (event.arg2 != 0);
+        sim->procs[sim->count].rec_pid = event.pid;
+        replay[sim->count].held_since_ns = -1;
+        sim->count++;
+        break;
+      }
+      case RECORD_EXIT:
+        if((index = sim_replay_find(sim, event.pid)) >= 0 && !replay[index].exited) {
+          replay[index].exited = 1;
+          replay[index].exit_ns = event.ns;
+          replay[index].runs = event.arg2;
+          replay[index].cpu_ns = event.value;
+          replay[index].ready_ns = event.value2;
+        }
+        break;
+      case RECORD_SUSPEND:
+      case RECORD_RESUME:
+      case RECORD_TERMINATE:
+        if(event.pid == 0 || (index = sim_replay_find(sim, event.pid)) < 0 || replay[index].exited) {
+          skipped++;
+          break;
+        }
+        if(event.type == RECORD_SUSPEND && replay[index].held_since_ns < 0) {
+          replay[index].held_since_ns = event.ns;
+        }
+        else if(event.type == RECORD_RESUME && replay[index].held_since_ns >= 0) {
+          replay[index].held_ns += event.ns - replay[index].held_since_ns;
+          replay[index].held_since_ns = -1;
+        }
+        else if(event.type == RECORD_TERMINATE) {
+          replay[index].terminated = 1;
+        }
+        sim_add_action(sim, event.ns, event.type, index);
+        break;
+      case RECORD_CS_START:
+      case RECORD_CS_STOP:
+        sim_add_action(sim, event.ns, event.type, -1);
+        break;
+      default:
+        break; // Newer event types are left out
+    }
+  }
+  fclose(file);
+
+  // Rebuild each process' demand from what the recording says it did
+  for(int i = 0; i < sim->count; i++) {
+    Sim_process_s *proc = &sim->procs[i];
+    Sim_replay_s *rec = &replay[i];
+    int runs = (rec->runs > 1) ? rec->runs : 1;
+    long long cpu_ns = (rec->cpu_ns > 1000) ? rec->cpu_ns : 1000; // At least 1us, CPU bursts can't be empty
+    long long io_ns = 0;
+
+    proc->pattern = malloc(2 * sizeof(long long));
+    if(proc->pattern == NULL) {
+      ABORT_ERROR("...out of memory reading the recording!");
+    }
+    proc->phases = 1;
+    proc->repeats = 1;
+    if(!rec->exited) {
+      proc->pattern[0] = LLONG_MAX / 4; // CPU bound for as long as the recording goes on
+      sim_add_action(sim, end_ns, RECORD_TERMINATE, i);
+      unfinished++;
+      continue;
+    }
+    if(rec->held_since_ns >= 0) {
+      rec->held_ns += rec->exit_ns - rec->held_since_ns;
+    }
+    io_ns = rec->exit_ns - proc->arrival_ns - cpu_ns - rec->ready_ns - rec->held_ns;
+    proc->pattern[0] = cpu_ns;
+    if(runs > 1 && io_ns > 0) {
+      proc->pattern[0] = (cpu_ns / runs > 0) ? cpu_ns / runs : 1;
+      proc->pattern[1] = io_ns / (runs - 1); // A trailing I/O wait is not waited out
+      proc->phases = 2;
+      proc->repeats = runs;
+    }
+    if(rec->terminated) {
+      proc->repeats = SIM_FOREVER;
+      if(proc->phases == 1) {
+        proc->pattern[0] = LLONG_MAX / 4;
+      }
+    }
+  }
+  printf("Replayed:    %d processes from %d shell commands over %.3f sec (%d still running at the end, %d actions skipped)\n",
+      sim->count, commands, end_ns / 1e9, unfinished, skipped);
+  sim->cs_running = 0; // The VM starts with the CS system stopped
+  free(replay);
+  return 0;
+}
+
+/* Returns the index of the latest process started with a recorded PID, or -1 if none was. */
+static int sim_replay_find(Sim_state_s *sim, pid_t rec_pid) {
+  for(int i = sim->count - 1; i >= 0; i--) {
+    if(sim->procs[i].rec_pid == rec_pid) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Adds an action to replay (actions are added in time order). */
+static void sim_add_action(Sim_state_s *sim, long long at_ns, int type, int index) {
+  if(sim->num_actions == 0 || (sim->num_actions >= 64 && (sim->num_actions & (sim->num_actions - 1)) == 0)) {
+    // Starts with 64, then doubles each time a power of 2 fills up
+    sim->actions = realloc(sim->actions, (sim->num_actions ? sim->num_actions * 2 : 64) * sizeof(Sim_action_s));
+    if(sim->actions == NULL) {
+      ABORT_ERROR("...out of memory reading the recording!");
+    }
+  }
+  sim->actions[sim->num_actions].at_ns = at_ns;
+  sim->actions[sim->num_actions].type = type;
+  sim->actions[sim->num_actions].index = index;
+  sim->num_actions++;
+}
+
+/* Adds a process waiting on I/O to the wake heap. */
+static void sim_heap_push(Sim_state_s *sim, int index) {
+  int child = sim->sleepers++;
+
+  while(child > 0) {
+    int parent = (child - 1) / 2;
+    if(sim->procs[sim->waking[parent]].wake_ns <= sim->procs[index].wake_ns) {
+      break;
+    }
+    sim->waking[child] = sim->waking[parent];
+    child = parent;
+  }
+  sim->waking[child] = index;
+}
+
+/* Removes and returns the process whose I/O wait ends first. */
+static int sim_heap_pop(Sim_state_s *sim) {
+  int top = sim->waking[0];
+  int last = sim->waking[--sim->sleepers];
+  int parent = 0;
+
+  while(2 * parent + 1 < sim->sleepers) {
+    int child = 2 * parent + 1;
+    if(child + 1 < sim->sleepers && sim->procs[sim->waking[child + 1]].wake_ns < sim->procs[sim->waking[child]].wake_ns) {
+      child++;
+    }
+    if(sim->procs[last].wake_ns <= sim->procs[sim->waking[child]].wake_ns) {
+      break;
+    }
+    sim->waking[parent] = sim->waking[child];
+    parent = child;
+  }
+  sim->waking[parent] = last;
+  return top;
+}
+
+/* Returns when the next process arrives or wakes from I/O (or a replayed action is due), or LLONG_MAX if none will. */
+static long long sim_next_event(Sim_state_s *sim) {
+  long long next_ns = LLONG_MAX;
+
+  if(sim->arrived < sim->count) {
+    next_ns = SIM_EPOCH_NS + sim->procs[sim->arrived].arrival_ns;
+  }
+  if(sim->acted < sim->num_actions && SIM_EPOCH_NS + sim->actions[sim->acted].at_ns < next_ns) {
+    next_ns = SIM_EPOCH_NS + sim->actions[sim->acted].at_ns;
+  }
+  if(sim->sleepers > 0 && sim->procs[sim->waking[0]].wake_ns < next_ns) {
+    next_ns = sim->procs[sim->waking[0]].wake_ns;
+  }
+  return next_ns;
+}
+
+/* Makes every process that has arrived or woken up by now Ready, then takes the replayed actions due by now.
+ * Returns 1 if one of them outranks the running process (if any), or 0 if not.
+ */
+static int sim_admit(Sim_state_s *sim, Hake_process_s *running) {
+  int outranked = 0;
+
+  while(sim->arrived < sim->count && SIM_EPOCH_NS + sim->procs[sim->arrived].arrival_ns <= g_now) {
+    Sim_process_s *proc = &sim->procs[sim->arrived];
+    proc->pid = ++sim->arrived;
+    proc->left_ns = proc->pattern[0];
+    proc->node = hake_new_process(proc->name, proc->pid, proc->priority, proc->critical);
+    if(proc->node == NULL || hake_insert(sim->schedule, proc->node) != 0) {
+      ABORT_ERROR("...hake_insert failed admitting a process!");
+    }
+    outranked |= hake_outranks(sim->schedule, proc->node, running);
+  }
+  while(sim->sleepers > 0 && sim->procs[sim->waking[0]].wake_ns <= g_now) {
+    Sim_process_s *proc = &sim->procs[sim_heap_pop(sim)];
+    proc->waiting = 0;
+    if(proc->done || proc->held) {
+      continue; // Terminated while waiting, or stays suspended until it is resumed
+    }
+    if(hake_resume(sim->schedule, proc->pid) != 0) {
+      ABORT_ERROR("...hake_resume failed waking a process!");
+    }
+    outranked |= hake_outranks(sim->schedule, proc->node, running);
+  }
+  while(sim->acted < sim->num_actions && SIM_EPOCH_NS + sim->actions[sim->acted].at_ns <= g_now) {
+    sim_act(sim, &sim->actions[sim->acted++], running, &outranked);
+  }
+  return outranked;
+}
+
+/* Takes a replayed action, the way the VM's shell and CS system would have.
+ * - Anything about the running process waits for its slice to end, which the action cuts short.
+ */
+static void sim_act(Sim_state_s *sim, Sim_action_s *action, Hake_process_s *running, int *outranked) {
+  Sim_process_s *proc = (action->index >= 0) ? &sim->procs[action->index] : NULL;
+  int on_cpu = (proc != NULL && running != NULL && proc->node == running);
+
+  if(proc != NULL && (proc->done || action->index >= sim->arrived)) {
+    return;
+  }
+  switch(action->type) {
+    case RECORD_SUSPEND:
+      if(!proc->held) {
+        proc->held = 1;
+        if(on_cpu) {
+          sim->cut = 1;
+        }
+        else if(!proc->waiting && hake_suspend(sim->schedule, proc->pid) != 0) {
+          ABORT_ERROR("...hake_suspend failed replaying a suspend!");
+        }
+      }
+      break;
+    case RECORD_RESUME:
+      if(proc->held) {
+        proc->held = 0;
+        if(!on_cpu && !proc->waiting) {
+          if(hake_resume(sim->schedule, proc->pid) != 0) {
+            ABORT_ERROR("...hake_resume failed replaying a resume!");
+          }
+          *outranked |= hake_outranks(sim->schedule, proc->node, running);
+        }
+      }
+      break;
+    case RECORD_TERMINATE:
+      if(on_cpu) {
+        proc->killed = 1;
+        sim->cut = 1;
+      }
+      else {
+        Hake_process_s *node = proc->node;
+        if(hake_terminated(sim->schedule, proc->pid, SIM_KILLED) != 0) {
+          ABORT_ERROR("...hake_terminated failed replaying a terminate!");
+        }
+        sim_retire(sim, proc, node);
+      }
+      break;
+    case RECORD_CS_START:
+      sim->cs_running = 1;
+      break;
+    case RECORD_CS_STOP:
+      sim->cs_running = 0;
+      if(running != NULL) {
+        sim->cut = 1;
+      }
+      break;
+  }
+}
+
+/* Records the results of a process that just exited or was terminated. */
+static void sim_retire(Sim_state_s *sim, Sim_process_s *proc, Hake_process_s *node) {
+  proc->wait_ns = hake_get_wait(node);
+  proc->response_ns = (node->first_run_ns > 0 ? node->first_run_ns : node->end_ns) - node->start_ns;
+  proc->turnaround_ns = node->end_ns - node->start_ns;
+  proc->node = NULL; // Terminated nodes are evicted (and freed) as more processes exit
+  proc->done = 1;
+  sim->completed++;
+}
+
+/* Moves a process whose CPU burst just ended on to its next one.
+ * Returns the I/O wait before that burst (0 if none), or -1 if it has no more bursts.
+ */
+static int sim_next_burst_io(Sim_process_s *proc, long long *io_ns) {
+  int total = proc->phases * proc->repeats;
+  int step = proc->step + 1;
+
+  *io_ns = 0;
+  if(step < total && step % proc->phases % 2 == 1) {
+    *io_ns = proc->pattern[step % proc->phases];
+    step++;
+  }
+  if(step >= total) {
+    return -1; // A trailing I/O wait is not waited out
+  }
+  proc->step = step;
+  proc->left_ns = proc->pattern[step % proc->phases];
+  return 0;
+}
+
+/* Runs the workload to completion on one CPU. */
+static void sim_run(Sim_state_s *sim) {
+  pid_t last_pid = 0;
+
+  while(sim->completed < sim->count) {
+    Hake_process_s *running = NULL;
+    Sim_process_s *proc = NULL;
+    long long slice_ns = 0;
+    long long start_ns = 0;
+    long long end_ns = 0;
+    long long next_ns = 0;
+    long long io_ns = 0;
+    int preempted = 0;
+
+    sim_admit(sim, NULL);
+    // A replayed CS stop holds everything in place (until the recording runs out)
+    running = (sim->cs_running || sim->acted == sim->num_actions) ? hake_select(sim->schedule) : NULL;
+    if(running == NULL) {
+      g_now = sim_next_event(sim); // Idle until something arrives or wakes
+      if(g_now == LLONG_MAX) {
+        ABORT_ERROR("...nothing left to run, but not every process finished!");
+      }
+      continue;
+    }
+    sim->decisions++;
+    proc = &sim->procs[running->pid - 1];
+    if(running->pid != last_pid) {
+      sim->switches++;
+      g_now += sim->switch_ns;
+      last_pid = running->pid;
+    }
+
+    // Run for the policy's slice, or the process' own quantum, like the VM's dispatcher
+    slice_ns = hake_get_slice(sim->schedule, running);
+    if(slice_ns <= 0) {
+      slice_ns = (sim->adaptive && running->quantum_ns > 0) ? running->quantum_ns : sim->base_ns;
+    }
+    start_ns = g_now;
+    end_ns = start_ns + (proc->left_ns < slice_ns ? proc->left_ns : slice_ns);
+    // Anything that arrives meanwhile (or during the switch) and outranks it takes the CPU at once
+    // (and so does a replayed action that needs it off the CPU)
+    while((next_ns = sim_next_event(sim)) < end_ns) {
+      g_now = (next_ns > start_ns) ? next_ns : start_ns;
+      if(sim_admit(sim, running) || sim->cut) {
+        end_ns = g_now;
+        preempted = 1;
+        sim->preemptions += !sim->cut;
+        break;
+      }
+    }
+    sim->cut = 0;
+    g_now = end_ns;
+    sim->busy_ns += end_ns - start_ns;
+    proc->left_ns -= end_ns - start_ns;
+    proc->cpu_ns += end_ns - start_ns;
+    if(hake_charge_cpu(running, proc->cpu_ns) != 0) {
+      ABORT_ERROR("...hake_charge_cpu failed!");
+    }
+
+    // Burst over: exit, or wait on I/O (which reads as a slice it barely used), or go on to the next burst
+    // (a replayed terminate ends it here instead)
+    if(proc->killed || (proc->left_ns == 0 && sim_next_burst_io(proc, &io_ns) == -1)) {
+      if(hake_exited(sim->schedule, running, proc->killed ? SIM_KILLED : 0) != 0) {
+        ABORT_ERROR("...hake_exited failed!");
+      }
+      sim_retire(sim, proc, running);
+      continue;
+    }
+    if(sim->adaptive && !preempted) {
+      hake_adapt_quantum(running, sim->base_ns, io_ns > 0 ? slice_ns : end_ns - start_ns, running->slice_cpu_ns);
+    }
+    if(hake_insert(sim->schedule, running) != 0) {
+      ABORT_ERROR("...hake_insert failed!");
+    }
+    // Off to wait on I/O, or held by a replayed suspend (or both, and then it stays suspended once it wakes)
+    if(io_ns > 0 || proc->held) {
+      if(hake_suspend(sim->schedule, proc->pid) != 0) {
+        ABORT_ERROR("...hake_suspend failed!");
+      }
+    }
+    if(io_ns > 0) {
+      proc->wake_ns = g_now + io_ns;
+      proc->waiting = 1;
+      sim_heap_push(sim, proc->pid - 1);
+    }
+  }
+}
+
+/* Orders long longs ascending for qsort. */
+static int sim_compare(const void *a, const void *b) {
+  long long x = *(const long long *)a;
+  long long y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+/* Sorts n values in place and sets out to their nearest-rank p50, p95, and p99 (all 0 if n is 0). */
+static void sim_percentiles(long long *values, int n, long long out[3]) {
+  const int pct[3] = {50, 95, 99};
+
+  if(n == 0) {
+    out[0] = out[1] = out[2] = 0;
+    return;
+  }
+  qsort(values, n, sizeof(long long), sim_compare);
+  for(int i = 0; i < 3; i++) {
+    int rank = (pct[i] * n + 99) / 100; // ceil(p * n / 100), 1-based
+    out[i] = values[(rank < 1 ? 1 : rank) - 1];
+  }
+}
+
+/* Prints the results: throughput, waiting, response, and turnaround times, and fairness. */
+static void sim_report(Sim_state_s *sim, long long host_ns, int verbose) {
+  const char *labels[3] = {"Wait", "Response", "Turnaround"};
+  long long *values = malloc((sim->count ? sim->count : 1) * sizeof(long long));
+  long long elapsed_ns = g_now - SIM_EPOCH_NS;
+  double sum = 0.0;
+  double sum_sq = 0.0;
+
+  if(values == NULL) {
+    ABORT_ERROR("...out of memory for the report!");
+  }
+  if(verbose) {
+    printf("%7s %-16s %4s %2s %12s %12s %12s %12s\n", "pid", "name", "pri", "cr", "cpu_ms", "wait_ms",
+        "response_ms", "turnaround_ms");
+    for(int i = 0; i < sim->count; i++) {
+      Sim_process_s *proc = &sim->procs[i];
+      printf("%7d %-16s %4d %2d %12.3f %12.3f %12.3f %12.3f\n", proc->pid, proc->name, proc->priority, proc->critical,
+          proc->cpu_ns / 1e6, proc->wait_ns / 1e6, proc->response_ns / 1e6, proc->turnaround_ns / 1e6);
+    }
+  }
+
+  printf("Policy:      %s, quantum %lld usec (%s), switch cost %lld usec\n", sim->schedule->policy->name,
+      sim->base_ns / 1000, sim->adaptive ? "adaptive" : "fixed", sim->switch_ns / 1000);
+  printf("Decisions:   %lld selects, %lld switches, %lld preemptions\n", sim->decisions, sim->switches, sim->preemptions);
+  printf("Simulated:   %.3f sec, CPU busy %.1f%%\n", elapsed_ns / 1e9, elapsed_ns ? sim->busy_ns * 100.0 / elapsed_ns : 0.0);
+  printf("Host:        %.3f sec, %.0f decisions/sec\n", host_ns / 1e9, host_ns ? sim->decisions * 1e9 / host_ns : 0.0);
+  printf("Throughput:  %.2f processes completed per simulated minute (%d in all)\n",
+      elapsed_ns ? sim->count * 60e9 / elapsed_ns : 0.0, sim->count);
+  for(int metric = 0; metric < 3; metric++) {
+    long long out[3];
+    double mean = 0.0;
+    for(int i = 0; i < sim->count; i++) {
+      values[i] = (metric == 0) ? sim->procs[i].wait_ns : (metric == 1) ? sim->procs[i].response_ns : sim->procs[i].turnaround_ns;
+      mean += values[i];
+    }
+    sim_percentiles(values, sim->count, out);
+    printf("%-11s  mean %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms\n", labels[metric],
+        sim->count ? mean / sim->count / 1e6 : 0.0, out[0] / 1e6, out[1] / 1e6, out[2] / 1e6);
+  }
+  // Jain's fairness index of each process' CPU share over its lifetime: 1 is perfectly fair
+  for(int i = 0; i < sim->count; i++) {
+    double share = sim->procs[i].turnaround_ns > 0 ? (double)sim->procs[i].cpu_ns / sim->procs[i].turnaround_ns : 0.0;
+    sum += share;
+    sum_sq += share * share;
+  }
+  printf("Fairness:    Jain's index %.3f of CPU share over %d processes\n",
+      sum_sq > 0.0 ? sum * sum / (sim->count * sum_sq) : 1.0, sim->count);
+  free(values);
+}
@@ -30,7 +30,24 @@ int g_debug_mode = 1; // Hardcodes debug on for the custom print functions
  
 /* Local Prototypes */
 void test_hake_create();
+void test_hake_select();
+void test_hake_aging();
+void test_hake_pid_index();
+void test_hake_arena();
+void test_hake_retention();
+void test_hake_detach();
+void test_hake_policy();
+void test_hake_cfs();
+void test_hake_edf();
+void test_hake_soa();
+void test_hake_preempt();
+void test_hake_quantum();
+void test_hake_cpu_charge();
+void test_hake_accounting();
+void test_hake_clock();
 static void test_queue_initialized(Hake_queue_s *queue);
+static void test_expect_select(Hake_schedule_s *header, pid_t pid);
+static int test_rb_black_height(Hake_process_s *node);
 
 /* This is an EXAMPLE tester file, change anything you like!
  * - This shows an example by testing hake_create.
@@ -51,6 +68,51 @@ int main() {
   PRINT_STATUS("Test 1: Testing OP Create");
   test_hake_create();
 
+  PRINT_STATUS("Test 2: Testing OP Select Order");
+  test_hake_select();
+
+  PRINT_STATUS("Test 3: Testing Lazy Aging across Suspend and Resume");
+  test_hake_aging();
+
+  PRINT_STATUS("Test 4: Testing PID Lookups for Suspend, Resume, and Terminate");
+  test_hake_pid_index();
+
+  PRINT_STATUS("Test 5: Testing the Node Arena");
+  test_hake_arena();
+
+  PRINT_STATUS("Test 6: Testing Terminated Queue Retention and Archive");
+  test_hake_retention();
+
+  PRINT_STATUS("Test 7: Testing Detach for Migrating Processes between Schedules");
+  test_hake_detach();
+
+  PRINT_STATUS("Test 8: Testing Policy Switching and Loading");
+  test_hake_policy();
+
+  PRINT_STATUS("Test 9: Testing the Fair Share (cfs) Policy");
+  test_hake_cfs();
+
+  PRINT_STATUS("Test 10: Testing EDF Admission, Order, and Deadline Misses");
+  test_hake_edf();
+
+  PRINT_STATUS("Test 11: Testing the Structure of Arrays (soa) Policy against the Default");
+  test_hake_soa();
+
+  PRINT_STATUS("Test 12: Testing Preemption (who outranks the running process) under each Policy");
+  test_hake_preempt();
+
+  PRINT_STATUS("Test 13: Testing the Adaptive Quantum");
+  test_hake_quantum();
+
+  PRINT_STATUS("Test 14: Testing Measured CPU Time Charging");
+  test_hake_cpu_charge();
+
+  PRINT_STATUS("Test 15: Testing Wait and Run Time Accounting");
+  test_hake_accounting();
+
+  PRINT_STATUS("Test 16: Testing a Virtual Clock (for simulation)");
+  test_hake_clock();
+
   // You would add more calls to testing helper functions that you like.
   // Then when done, you can print a nice message an then return.
   PRINT_STATUS("All tests complete!");
@@ -101,9 +163,920 @@ void test_hake_create() {
   //           second argument to have it print out nice.
   // - In this case, we haven't selected any Process, so passing in NULL
   print_hake_debug(header, NULL); // the second argument here is used for the process on the CPU.
+  hake_deallocate(header);
   PRINT_STATUS("...hake_create is looking good so far.");
 }
 
+/* Local function to test the selection order of hake_select from hake_sched.c
+ * - Critical first, then Starving (in the order they started), then lowest priority, with ties to the lowest PID.
+ */
+void test_hake_select() {
+  Hake_schedule_s *header = hake_create();
+  if(header == NULL) {
+    ABORT_ERROR("...hake_create returned NULL!");
+  }
+
+  PRINT_STATUS("...Checking Critical, Priority, and PID tie-breaks");
+  hake_insert(header, hake_new_process("thirty", 30, 50, 0));
+  hake_insert(header, hake_new_process("ten", 10, 50, 0));
+  hake_insert(header, hake_new_process("twenty", 20, 10, 0));
+  hake_insert(header, hake_new_process("forty", 40, 200, 1));
+  hake_insert(header, hake_new_process("five", 5, 255, 0));
+  if(hake_get_count(header->ready_queue) != 5) {
+    ABORT_ERROR("...the Ready Queue count should be 5!");
+  }
+  print_hake_debug(header, NULL);
+  test_expect_select(header, 40);
+  test_expect_select(header, 20);
+  test_expect_select(header, 10);
+  test_expect_select(header, 30);
+  test_expect_select(header, 5);
+  if(hake_select(header) != NULL || hake_get_count(header->ready_queue) != 0) {
+    ABORT_ERROR("...hake_select should return NULL on an empty Ready Queue!");
+  }
+
+  PRINT_STATUS("...Checking that a Starving process is rescued");
+  Hake_process_s *hog = hake_new_process("hog", 2, 1, 0);
+  hake_insert(header, hake_new_process("starved", 1, 255, 0));
+  hake_insert(header, hog);
+  for(int i = 0; i < STARVING_AGE; i++) {
+    test_expect_select(header, 2);
+    hake_insert(header, hog);
+  }
+  test_expect_select(header, 1);
+  test_expect_select(header, 2);
+
+  PRINT_STATUS("...Checking that Starving processes run in the order they started Starving");
+  // A Critical hog keeps everything else waiting, so all three end up Starving together.
+  Hake_process_s *boss = hake_new_process("boss", 3, 1, 1);
+  hake_insert(header, boss);
+  hake_insert(header, hake_new_process("early", 9, 200, 0));
+  test_expect_select(header, 3);
+  hake_insert(header, boss);
+  hake_insert(header, hake_new_process("later", 8, 250, 0));
+  hake_insert(header, hake_new_process("late", 6, 250, 0));
+  for(int i = 0; i < STARVING_AGE + 1; i++) {
+    test_expect_select(header, 3);
+    hake_insert(header, boss);
+  }
+  test_expect_select(header, 3);
+  // The earliest to start Starving goes first even with the highest PID, then the rest by PID.
+  test_expect_select(header, 9);
+  test_expect_select(header, 6);
+  test_expect_select(header, 8);
+
+  hake_deallocate(header);
+  PRINT_STATUS("...hake_select is looking good so far.");
+}
+
+/* Local function to test that ages are kept across Suspend/Resume and still reach STARVING_AGE */
+void test_hake_aging() {
+  Hake_schedule_s *header = hake_create();
+  if(header == NULL) {
+    ABORT_ERROR("...hake_create returned NULL!");
+  }
+
+  Hake_process_s *hog = hake_new_process("hog", 2, 1, 0);
+  Hake_process_s *waiter = hake_new_process("waiter", 7, 200, 0);
+  hake_insert(header, hog);
+  hake_insert(header, waiter);
+
+  // Age the waiter part of the way, then park it in the Suspended Queue.
+  for(int i = 0; i < STARVING_AGE - 2; i++) {
+    test_expect_select(header, 2);
+    hake_insert(header, hog);
+  }
+  if(hake_get_age(header, waiter) != STARVING_AGE - 2) {
+    ABORT_ERROR("...the waiter's age was not updated by hake_select!");
+  }
+  if(hake_suspend(header, 7) != 0 || waiter->age != STARVING_AGE - 2) {
+    ABORT_ERROR("...hake_suspend lost the waiter's age!");
+  }
+
+  // Selects while suspended do not age it.
+  test_expect_select(header, 2);
+  hake_insert(header, hog);
+  if(hake_resume(header, 7) != 0 || hake_get_age(header, waiter) != STARVING_AGE - 2) {
+    ABORT_ERROR("...the waiter aged while it was suspended!");
+  }
+
+  // Two more selects make it starve.
+  test_expect_select(header, 2);
+  hake_insert(header, hog);
+  test_expect_select(header, 2);
+  hake_insert(header, hog);
+  print_hake_debug(header, NULL);
+  test_expect_select(header, 7);
+
+  hake_deallocate(header);
+  PRINT_STATUS("...aging is looking good so far.");
+}
+
+/* Local function to test the PID index behind hake_suspend, hake_resume, and hake_terminated */
+void test_hake_pid_index() {
+  const int total = 1000;
+  Hake_schedule_s *header = hake_create();
+  if(header == NULL) {
+    ABORT_ERROR("...hake_create returned NULL!");
+  }
+
+  // Scrambled PIDs (37 is coprime with 1000), enough to grow the index several times.
+  PRINT_STATUS("...Inserting %d processes", total);
+  for(int i = 0; i < total; i++) {
+    pid_t pid = 1 + (i * 37) % total;
+    if(hake_insert(header, hake_new_process("proc", pid, 1 + pid % MAX_PRIORITY, 0)) != 0) {
+      ABORT_ERROR("...hake_insert failed on a new PID!");
+    }
+  }
+  Hake_process_s *dup = hake_new_process("dup", 500, 10, 0);
+  if(hake_insert(header, dup) != -1) {
+    ABORT_ERROR("...hake_insert accepted a duplicate PID!");
+  }
+  hake_free_process(dup);
+
+  PRINT_STATUS("...Suspending every 3rd and Terminating every 5th PID");
+  for(pid_t pid = 3; pid <= total; pid += 3) {
+    if(hake_suspend(header, pid) != 0) {
+      ABORT_ERROR("...hake_suspend could not find a Ready PID!");
+    }
+  }
+  if(hake_suspend(header, 3) != -1) {
+    ABORT_ERROR("...hake_suspend accepted an already Suspended PID!");
+  }
+  for(pid_t pid = 5; pid <= total; pid += 5) {
+    if(hake_terminated(header, pid, 9) != 0) {
+      ABORT_ERROR("...hake_terminated could not find a Ready or Suspended PID!");
+    }
+  }
+  if(hake_terminated(header, 5, 9) != -1 || hake_terminated(header, total + 1, 9) != -1) {
+    ABORT_ERROR("...hake_terminated accepted an untracked PID!");
+  }
+  if(hake_resume(header, 6) != 0 || hake_resume(header, 6) != -1) {
+    ABORT_ERROR("...hake_resume did not move PID 6 exactly once!");
+  }
+
+  // 333 suspended, 200 terminated (66 of them from the Suspended Queue), then 1 resumed.
+  if(hake_get_count(header->ready_queue) != total - 333 - 134 + 1 ||
+     hake_get_count(header->suspended_queue) != 333 - 66 - 1 ||
+     hake_get_count(header->terminated_queue) != 200) {
+    ABORT_ERROR("...the Queue counts are wrong after Suspend, Resume, and Terminate!");
+  }
+  Hake_process_s *found = hake_find(header, total);
+  if(found == NULL || found->pid != total || !(found->state & HAKE_STATE_TERMINATED) ||
+     (found->state & HAKE_STATE_EXIT_CODE) != 9) {
+    ABORT_ERROR("...hake_find did not return the most recently Terminated PID!");
+  }
+  if(hake_find(header, total + 1) != NULL) {
+    ABORT_ERROR("...hake_find returned an untracked PID!");
+  }
+
+  hake_deallocate(header);
+  PRINT_STATUS("...PID lookups are looking good so far.");
+}
+
+/* Local function to test node slots, inline and interned commands, and slot reuse */
+void test_hake_arena() {
+  char long_cmd[MAX_CMD] = {0};
+  Hake_schedule_s *header = hake_create();
+  if(header == NULL) {
+    ABORT_ERROR("...hake_create returned NULL!");
+  }
+
+  memset(long_cmd, 'x', HAKE_INLINE_CMD + 10);
+  Hake_process_s *short_a = hake_new_process("slow_cooker 5", 100, 10, 0);
+  Hake_process_s *long_a = hake_new_process(long_cmd, 101, 10, 0);
+  Hake_process_s *long_b = hake_new_process(long_cmd, 102, 10, 0);
+  if(short_a == NULL || long_a == NULL || long_b == NULL) {
+    ABORT_ERROR("...hake_new_process returned NULL!");
+  }
+  if(((unsigned long)short_a % HAKE_CACHE_LINE) != 0 || ((unsigned long)long_a % HAKE_CACHE_LINE) != 0) {
+    ABORT_ERROR("...process nodes are not cache-line aligned!");
+  }
+  if(strcmp(short_a->cmd, "slow_cooker 5") != 0 || strcmp(long_a->cmd, long_cmd) != 0) {
+    ABORT_ERROR("...the command strings were not copied!");
+  }
+  if(long_a->cmd != long_b->cmd) {
+    ABORT_ERROR("...identical long commands were not interned!");
+  }
+
+  // A freed slot is handed out again before carving a new one.
+  hake_free_process(long_b);
+  Hake_process_s *reused = hake_new_process("again", 103, 10, 0);
+  if(reused != long_b) {
+    ABORT_ERROR("...hake_new_process did not reuse a freed slot!");
+  }
+
+  // Enough nodes to span several chunks, all released with the schedule.
+  hake_insert(header, short_a);
+  hake_insert(header, long_a);
+  hake_insert(header, reused);
+  for(int i = 0; i < 3 * HAKE_CHUNK_SLOTS; i++) {
+    if(hake_insert(header, hake_new_process("filler", 1000 + i, 1 + i % MAX_PRIORITY, 0)) != 0) {
+      ABORT_ERROR("...hake_insert failed on an arena node!");
+    }
+  }
+  if(hake_get_count(header->ready_queue) != 3 + 3 * HAKE_CHUNK_SLOTS) {
+    ABORT_ERROR("...the Ready Queue count is wrong after filling the arena!");
+  }
+
+  hake_deallocate(header);
+  PRINT_STATUS("...the node arena is looking good so far.");
+}
+
+/* Local function to test that old Terminated processes are archived and still counted */
+void test_hake_retention() {
+  const char *path = "test_terminated.csv";
+  char line[MAX_CMD_LINE] = {0};
+  int lines = 0;
+  Hake_schedule_s *header = hake_create();
+  if(header == NULL) {
+    ABORT_ERROR("...hake_create returned NULL!");
+  }
+
+  remove(path);
+  if(hake_set_retention(header, 3, path) != 0) {
+    ABORT_ERROR("...hake_set_retention could not open the archive!");
+  }
+  for(pid_t pid = 1; pid <= 10; pid++) {
+    Hake_process_s *process = hake_new_process("quote\"d", pid, 10, pid == 1);
+    if(hake_insert(header, process) != 0 || hake_select(header) != process ||
+       hake_exited(header, process, pid) != 0) {
+      ABORT_ERROR("...could not run and exit a process!");
+    }
+  }
+  print_hake_debug(header, NULL);
+  if(hake_get_count(header->terminated_queue) != 10 || header->archive->retained != 3 ||
+     header->terminated_queue->head->pid != 8) {
+    ABORT_ERROR("...the Terminated Queue should count 10 but only keep the last 3!");
+  }
+  if(hake_find(header, 7) != NULL || hake_find(header, 8) == NULL) {
+    ABORT_ERROR("...archived processes should be gone from the PID index!");
+  }
+
+  // A reused PID of an archived process is a new process.
+  if(hake_insert(header, hake_new_process("again", 1, 10, 0)) != 0) {
+    ABORT_ERROR("...hake_insert rejected the reused PID of an archived process!");
+  }
+  hake_deallocate(header);
+
+  // Header plus one CSV line per archived process.
+  FILE *archive = fopen(path, "r");
+  if(archive == NULL) {
+    ABORT_ERROR("...the archive was not written!");
+  }
+  while(fgets(line, MAX_CMD_LINE, archive) != NULL) {
+    if(lines == 1 && strncmp(line, "1,10,1,1,", 9) != 0) {
+      ABORT_ERROR("...the first archived record is wrong!");
+    }
+    if(lines > 0 && strstr(line, ",\"quote\"\"d\"\n") == NULL) {
+      ABORT_ERROR("...the archived command was not quoted!");
+    }
+    lines++;
+  }
+  fclose(archive);
+  remove(path);
+  if(lines != 1 + 7) {
+    ABORT_ERROR("...the archive should hold a header and 7 records!");
+  }
+
+  // With nothing retained, exiting evicts (and frees) the process at once; only the count is left
+  header = hake_create();
+  if(header == NULL || hake_set_retention(header, 0, NULL) != 0 ||
+     hake_insert(header, hake_new_process("gone", 1, 10, 0)) != 0 || hake_exited(header, hake_select(header), 0) != 0 ||
+     hake_insert(header, hake_new_process("killed", 2, 10, 0)) != 0 || hake_terminated(header, 2, 9) != 0) {
+    ABORT_ERROR("...could not end processes with no retention!");
+  }
+  if(hake_get_count(header->terminated_queue) != 2 || header->archive->retained != 0 ||
+     header->terminated_queue->head != NULL || hake_find(header, 1) != NULL || hake_find(header, 2) != NULL) {
+    ABORT_ERROR("...with keep 0 the Terminated Queue should only count its processes!");
+  }
+  hake_deallocate(header);
+  PRINT_STATUS("...Terminated Queue retention is looking good so far.");
+}
+
+/* Local function to test moving a selected process from one schedule to another (work stealing) */
+void test_hake_detach() {
+  Hake_schedule_s *victim = hake_create();
+  Hake_schedule_s *thief = hake_create();
+  if(victim == NULL || thief == NULL) {
+    ABORT_ERROR("...hake_create returned NULL!");
+  }
+
+  hake_insert(victim, hake_new_process("first", 10, 50, 0));
+  hake_insert(victim, hake_new_process("second", 20, 50, 0));
+  Hake_process_s *ready = hake_find(victim, 20);
+  if(hake_detach(victim, ready) != -1) {
+    ABORT_ERROR("...hake_detach accepted a process that is still Ready!");
+  }
+
+  PRINT_STATUS("...Stealing PID 10 from one schedule into another");
+  Hake_process_s *stolen = hake_select(victim);
+  if(stolen == NULL || stolen->pid != 10 || hake_detach(victim, stolen) != 0) {
+    ABORT_ERROR("...hake_detach could not detach the selected process!");
+  }
+  if(hake_find(victim, 10) != NULL || hake_detach(victim, stolen) != -1) {
+    ABORT_ERROR("...the detached process is still tracked by its old schedule!");
+  }
+  if(hake_insert(thief, stolen) != 0 || hake_find(thief, 10) != stolen) {
+    ABORT_ERROR("...the new schedule did not take the stolen process!");
+  }
+  if(hake_get_count(victim->ready_queue) != 1 || hake_get_count(thief->ready_queue) != 1) {
+    ABORT_ERROR("...the Ready counts are wrong after the migration!");
+  }
+  // The old schedule can reuse the PID once the process has moved away.
+  if(hake_terminated(thief, 10, 3) != 0 || hake_terminated(victim, 10, 3) != -1) {
+    ABORT_ERROR("...hake_terminated found the stolen process in the wrong schedule!");
+  }
+
+  hake_deallocate(victim);
+  hake_deallocate(thief);
+  PRINT_STATUS("...Detach is looking good so far.");
+}
+
+/* Local function to test the policy registry, loading a policy with dlopen, and switching policies */
+void test_hake_policy() {
+  const Hake_policy_s *fifo = NULL;
+  Hake_schedule_s *header = hake_create();
+  if(header == NULL) {
+    ABORT_ERROR("...hake_create returned NULL!");
+  }
+  if(header->policy != hake_get_policy(HAKE_DEFAULT_POLICY) || hake_get_policy(NULL) != header->policy) {
+    ABORT_ERROR("...a new schedule did not start with the default policy!");
+  }
+  if(hake_register_policy(header->policy) != -1 || hake_get_policy("no-such-policy") != NULL) {
+    ABORT_ERROR("...the registry accepted a duplicate name or found a missing policy!");
+  }
+
+  PRINT_STATUS("...Loading ./hake_policy_fifo.so (built by make policies)");
+  fifo = hake_load_policy("./hake_policy_fifo.so");
+  if(fifo == NULL || hake_get_policy("fifo") != fifo || hake_load_policy("./hake_policy_fifo.so") != fifo) {
+    ABORT_ERROR("...hake_load_policy did not register the fifo policy exactly once!");
+  }
+
+  // Inserted in this order; the default policy runs the critical one, then by priority
+  hake_insert(header, hake_new_process("low", 30, 90, 0));
+  hake_insert(header, hake_new_process("high", 20, 10, 0));
+  hake_insert(header, hake_new_process("critical", 40, 200, 1));
+  hake_insert(header, hake_new_process("mid", 10, 50, 0));
+  test_expect_select(header, 40);
+  hake_insert(header, hake_find(header, 40));
+
+  PRINT_STATUS("...Switching to fifo with 4 Ready processes");
+  int age_before = hake_get_age(header, hake_find(header, 30));
+  if(hake_set_policy(header, fifo) != 0 || header->policy != fifo ||
+     hake_get_count(header->ready_queue) != 4 || hake_get_age(header, hake_find(header, 30)) != age_before) {
+    ABORT_ERROR("...hake_set_policy lost a process or its age!");
+  }
+  if(hake_ready_first(header)->pid != 40) {
+    ABORT_ERROR("...fifo should hand back the Ready processes in their old selection order first!");
+  }
+  test_expect_select(header, 40);
+  test_expect_select(header, 20);
+  hake_insert(header, hake_find(header, 40));
+  if(hake_suspend(header, 0) != 0 || !(hake_find(header, 10)->state & HAKE_STATE_SUSPENDED)) {
+    ABORT_ERROR("...hake_suspend(0) did not pick the lowest Ready PID under fifo!");
+  }
+  test_expect_select(header, 30);
+  test_expect_select(header, 40);
+
+  PRINT_STATUS("...Switching back to the default policy");
+  hake_insert(header, hake_find(header, 40));
+  hake_insert(header, hake_find(header, 30));
+  hake_resume(header, 10);
+  if(hake_set_policy(header, hake_get_policy(NULL)) != 0) {
+    ABORT_ERROR("...hake_set_policy could not switch back!");
+  }
+  test_expect_select(header, 40);
+  test_expect_select(header, 10);
+  test_expect_select(header, 30);
+
+  hake_deallocate(header);
+  PRINT_STATUS("...Policies are looking good so far.");
+}
+
+/* Local function to test weighted fair sharing, slices, and the red-black tree of the cfs policy */
+void test_hake_cfs() {
+  int light = 0, heavy = 0;
+  Hake_schedule_s *header = hake_create();
+  if(header == NULL || hake_set_policy(header, hake_get_policy(HAKE_CFS_POLICY)) != 0) {
+    ABORT_ERROR("...could not create a cfs schedule!");
+  }
+
+  // Priority 128 has weight 1024 and priority 98 has weight 3121, so about 3 runs to 1
+  PRINT_STATUS("...Running priorities 128 and 98 for 4000 one-millisecond slices");
+  hake_insert(header, hake_new_process("light", 1, DEFAULT_PRIORITY, 0));
+  hake_insert(header, hake_new_process("heavy", 2, 98, 0));
+  for(int i = 0; i < 4000; i++) {
+    Hake_process_s *selected = hake_select(header);
+    long long slice = hake_get_slice(header, selected);
+    if(slice < CFS_MIN_SLICE_USEC * 1000LL || slice > CFS_LATENCY_USEC * 1000LL) {
+      ABORT_ERROR("...the cfs slice is outside of its bounds!");
+    }
+    (selected->pid == 1) ? light++ : heavy++;
+    selected->run_start_ns -= 1000000; // Pretend it ran for 1ms
+    hake_insert(header, selected);
+  }
+  PRINT_STATUS("...light ran %d times, heavy ran %d times", light, heavy);
+  if(heavy * 100 < light * 3121 * 90 / 1024 || heavy * 100 > light * 3121 * 110 / 1024) {
+    ABORT_ERROR("...cfs did not share the CPU in proportion to the weights!");
+  }
+
+  hake_insert(header, hake_new_process("critical", 3, MAX_PRIORITY, 1));
+  test_expect_select(header, 3);
+
+  PRINT_STATUS("...Churning 500 processes through insert, select, suspend, resume, and terminate");
+  for(pid_t pid = 10; pid < 510; pid++) {
+    hake_insert(header, hake_new_process("churn", pid, 1 + (pid * 7919) % MAX_PRIORITY, pid % 50 == 0));
+  }
+  for(int i = 0; i < 3000; i++) {
+    pid_t pid = 10 + (i * 131) % 500;
+    Hake_process_s *selected = NULL;
+    switch(i % 4) {
+      case 0: hake_suspend(header, pid); break;
+      case 1: hake_resume(header, pid); break;
+      case 2: if(i % 20 == 2) { hake_terminated(header, pid, 0); } break;
+      default:
+        selected = hake_select(header);
+        if(selected != NULL) {
+          selected->run_start_ns -= 1000000 + i;
+          hake_insert(header, selected);
+        }
+    }
+  }
+  Hake_cfs_s *cfs = (Hake_cfs_s *)header->policy_data;
+  int count = 0;
+  Hake_process_s *previous = NULL;
+  test_rb_black_height(cfs->root);
+  for(Hake_process_s *current = hake_ready_first(header); current != NULL; current = hake_ready_next(header, current)) {
+    if(previous != NULL && (previous->state & HAKE_STATE_CRITICAL) == (current->state & HAKE_STATE_CRITICAL) &&
+       previous->vruntime > current->vruntime) {
+      ABORT_ERROR("...the cfs tree is not in vruntime order!");
+    }
+    previous = current;
+    count++;
+  }
+  if(count != hake_get_count(header->ready_queue) || (cfs->root != NULL && cfs->root->red)) {
+    ABORT_ERROR("...the cfs tree does not hold exactly the Ready processes!");
+  }
+
+  hake_deallocate(header);
+  PRINT_STATUS("...cfs is looking good so far.");
+}
+
+/* Local function to test deadline admission control, the EDF heap, and deadline miss accounting */
+void test_hake_edf() {
+  const long long ms = 1000000LL;
+  Hake_schedule_s *header = hake_create();
+  if(header == NULL) {
+    ABORT_ERROR("...hake_create returned NULL!");
+  }
+
+  PRINT_STATUS("...Admitting 20%% and 60%%, then rejecting another 30%%");
+  Hake_process_s *slow = hake_new_process("slow", 20, 200, 0);
+  Hake_process_s *fast = hake_new_process("fast", 30, 200, 0);
+  Hake_process_s *extra = hake_new_process("extra", 40, 200, 0);
+  if(hake_admit(header, slow, 500 * ms, 100 * ms) != 0 || hake_insert(header, slow) != 0 ||
+     hake_admit(header, fast, 200 * ms, 120 * ms) != 0 || hake_insert(header, fast) != 0) {
+    ABORT_ERROR("...hake_admit rejected a set that fits on the CPU!");
+  }
+  if(header->edf_util_ppm != 800000 || hake_admit(header, extra, 100 * ms, 30 * ms) != -1 ||
+     hake_admit(header, extra, 10 * ms, 20 * ms) != -1 || hake_admit(header, slow, 500 * ms, 1 * ms) != -1) {
+    ABORT_ERROR("...hake_admit accepted too much, an impossible runtime, or an already inserted process!");
+  }
+  if(!(slow->state & HAKE_STATE_CRITICAL) || extra->deadline_ns != 0) {
+    ABORT_ERROR("...admission should make a process Critical, and rejection should leave it alone!");
+  }
+
+  PRINT_STATUS("...Reserving at admission, so two admissions ahead of their inserts can't overcommit");
+  Hake_process_s *early = hake_new_process("early", 50, 200, 0);
+  if(hake_admit(header, early, 100 * ms, 10 * ms) != 0 || header->edf_util_ppm != 900000 ||
+     hake_admit(header, extra, 100 * ms, 20 * ms) != -1 || hake_admit(header, early, 100 * ms, 10 * ms) != -1) {
+    ABORT_ERROR("...hake_admit did not reserve the utilization it admitted!");
+  }
+  if(hake_insert(header, early) != 0 || header->edf_util_ppm != 900000 || hake_terminated(header, 50, 0) != 0 ||
+     header->edf_util_ppm != 800000) {
+    ABORT_ERROR("...inserting an admitted process reserved it twice, or terminating it kept it!");
+  }
+
+  // EDF processes run first (earliest deadline first), then plain Critical, then the rest
+  hake_insert(header, hake_new_process("critical", 5, 1, 1));
+  hake_insert(header, hake_new_process("normal", 1, 1, 0));
+  test_expect_select(header, 30);
+  test_expect_select(header, 20);
+  test_expect_select(header, 5);
+  test_expect_select(header, 1);
+
+  PRINT_STATUS("...Charging an on time job and a late job");
+  fast->run_start_ns -= 150 * ms; // Used up its 120ms job within its 200ms deadline
+  hake_insert(header, fast);
+  slow->run_start_ns -= 100 * ms; // Used up its job, but after the deadline
+  slow->abs_deadline_ns -= 600 * ms;
+  hake_insert(header, slow);
+  if(fast->deadline_misses != 0 || slow->deadline_misses != 1 || header->edf_misses != 1 ||
+     fast->job_ns != 0 || slow->job_ns != 0) {
+    ABORT_ERROR("...deadline misses were not counted per job!");
+  }
+
+  PRINT_STATUS("...Releasing capacity on termination");
+  if(hake_terminated(header, 30, 0) != 0 || header->edf_util_ppm != 200000 ||
+     hake_admit(header, extra, 100 * ms, 30 * ms) != 0 || hake_insert(header, extra) != 0 ||
+     hake_terminated(header, 40, 0) != 0) {
+    ABORT_ERROR("...a terminated deadline process kept its reserved capacity!");
+  }
+
+  PRINT_STATUS("...Selecting 200 deadline processes in deadline order");
+  for(pid_t pid = 100; pid < 300; pid++) {
+    Hake_process_s *process = hake_new_process("edf", pid, 128, 0);
+    if(hake_admit(header, process, (1 + (pid * 7919) % 997) * ms, 1000) != 0 || hake_insert(header, process) != 0) {
+      ABORT_ERROR("...could not admit a tiny deadline process!");
+    }
+  }
+  for(pid_t pid = 100; pid < 300; pid += 7) {
+    hake_suspend(header, pid); // Removes from the middle of the heap
+  }
+  long long last = 0;
+  for(Hake_process_s *selected = hake_select(header); selected != NULL && selected->deadline_ns > 0;
+      selected = hake_select(header)) {
+    if(selected->abs_deadline_ns < last) {
+      ABORT_ERROR("...the EDF heap returned a later deadline first!");
+    }
+    last = selected->abs_deadline_ns;
+  }
+
+  hake_deallocate(header);
+  PRINT_STATUS("...EDF is looking good so far.");
+}
+
+/* Local function to test that every soa kernel selects exactly like the default policy
+ * - Four schedules (default, then soa with the scalar, sse4.1, and widest kernels) get the same
+ *   processes, then the same selects, suspends, and resumes; every select must agree on the pid.
+ */
+void test_hake_soa() {
+  const char *kernels[4] = {NULL, "scalar", "sse4.1", NULL};
+  const char *widest = hake_set_soa_kernel(NULL);
+  Hake_schedule_s *headers[4] = {NULL};
+  int count = 200; // More than HAKE_SOA_MIN_CAPACITY, so the arrays grow
+  int i = 0;
+  int step = 0;
+
+  if(strcmp(hake_set_soa_kernel("scalar"), "scalar") != 0 || strcmp(hake_set_soa_kernel("no-such-kernel"), widest) != 0) {
+    ABORT_ERROR("...hake_set_soa_kernel did not choose the named kernel or fall back to the widest!");
+  }
+  for(i = 0; i < 4; i++) {
+    hake_set_soa_kernel(kernels[i]);
+    headers[i] = hake_create();
+    if(headers[i] == NULL || (i > 0 && hake_set_policy(headers[i], hake_get_policy(HAKE_SOA_POLICY)) != 0)) {
+      ABORT_ERROR("...could not create the schedules to compare!");
+    }
+    if(i > 0) {
+      PRINT_STATUS("...Comparing the default policy with the soa %s kernel", ((Hake_soa_s *)headers[i]->policy_data)->kernel);
+    }
+  }
+  hake_set_soa_kernel(NULL);
+
+  // Scrambled pids (401 is prime), spread priorities, and a few Critical processes
+  for(i = 1; i <= count; i++) {
+    for(int h = 0; h < 4; h++) {
+      hake_insert(headers[h], hake_new_process("soa", i * 97 % 401, i * 37 % MAX_PRIORITY + 1, i % 17 == 0));
+    }
+  }
+
+  for(step = 0; step < 2000; step++) {
+    pid_t expected = hake_ready_first(headers[0])->pid;
+    pid_t other = (step * 7 % count + 1) * 97 % 401;
+
+    for(int h = 0; h < 4; h++) {
+      Hake_process_s *first = hake_ready_first(headers[h]);
+      Hake_process_s *chosen = hake_select(headers[h]);
+      if(first != chosen || chosen->pid != expected) {
+        PRINT_WARNING("...step %d: schedule %d chose PID %d (listed %d), the default chose PID %d",
+                      step, h, chosen->pid, first->pid, expected);
+        ABORT_ERROR("...soa did not select like the default policy!");
+      }
+      hake_insert(headers[h], chosen);
+
+      // Suspend (while at least half are Ready) and resume processes from the middle of the arrays
+      if(step % 3 == 0 && (hake_find(headers[h], other)->state & HAKE_STATE_SUSPENDED)) {
+        hake_resume(headers[h], other);
+      }
+      else if(step % 3 == 0 && hake_get_count(headers[h]->ready_queue) > count / 2) {
+        hake_suspend(headers[h], other);
+      }
+    }
+  }
+
+  // Listing visits every Ready process exactly once
+  for(int h = 1; h < 4; h++) {
+    int listed = 0;
+    for(Hake_process_s *current = hake_ready_first(headers[h]); current != NULL; current = hake_ready_next(headers[h], current)) {
+      listed++;
+    }
+    if(listed != hake_get_count(headers[h]->ready_queue) || listed != hake_get_count(headers[0]->ready_queue)) {
+      ABORT_ERROR("...soa did not list every Ready process exactly once!");
+    }
+  }
+
+  // Switching back out of soa keeps the order too
+  if(hake_set_policy(headers[3], hake_get_policy(NULL)) != 0) {
+    ABORT_ERROR("...could not switch soa back to the default policy!");
+  }
+  while(hake_get_count(headers[0]->ready_queue) > 0) {
+    test_expect_select(headers[3], hake_select(headers[0])->pid);
+  }
+
+  for(i = 0; i < 4; i++) {
+    hake_deallocate(headers[i]);
+  }
+  PRINT_STATUS("...soa is looking good so far.");
+}
+
+/* Local function to test hake_outranks, which decides if an arrival preempts the running process
+ * - Each policy (and fifo, which has no outranks hook) gets the same running process and arrivals.
+ */
+void test_hake_preempt() {
+  const long long ms = 1000000LL;
+  const char *names[4] = {HAKE_DEFAULT_POLICY, HAKE_CFS_POLICY, HAKE_SOA_POLICY, "fifo"};
+  // Expected results per policy for: a better priority, a Critical arrival, an earlier deadline
+  const int better[4] = {1, 0, 1, 0};
+  const int earlier[4] = {1, 0, 0, 0};
+
+  for(int p = 0; p < 4; p++) {
+    Hake_schedule_s *header = hake_create();
+    if(header == NULL || hake_set_policy(header, hake_get_policy(names[p])) != 0) {
+      ABORT_ERROR("...could not create a schedule for the policy!");
+    }
+    PRINT_STATUS("...Checking arrivals against a running process under %s", names[p]);
+
+    hake_insert(header, hake_new_process("running", 10, 64, 0));
+    Hake_process_s *running = hake_select(header);
+    Hake_process_s *peer = hake_new_process("peer", 11, 64, 0);
+    Hake_process_s *urgent = hake_new_process("urgent", 12, 10, 0);
+    Hake_process_s *starving = hake_new_process("starving", 13, 200, 0);
+    Hake_process_s *critical = hake_new_process("critical", 14, 200, 1);
+    hake_insert(header, peer);
+    hake_insert(header, urgent);
+    hake_insert(header, starving);
+    hake_insert(header, critical);
+    starving->age = STARVING_AGE * 2;
+
+    if(hake_outranks(header, peer, running) != 0 || hake_outranks(header, starving, running) != 0 ||
+       hake_outranks(header, running, running) != 0 || hake_outranks(header, NULL, running) != 0 ||
+       hake_outranks(NULL, critical, running) != 0) {
+      ABORT_ERROR("...an equal, Starving, or missing process should never preempt!");
+    }
+    if(hake_outranks(header, urgent, running) != better[p]) {
+      ABORT_ERROR("...a better priority did not preempt exactly under the priority policies!");
+    }
+    if(hake_outranks(header, critical, running) != 1 || hake_outranks(header, urgent, critical) != 0) {
+      ABORT_ERROR("...Critical should always preempt a normal process, and never the other way around!");
+    }
+
+    // Deadlines only order Critical processes under the default policy's EDF
+    Hake_process_s *late = hake_new_process("late", 20, 200, 0);
+    Hake_process_s *soon = hake_new_process("soon", 21, 200, 0);
+    if(hake_admit(header, late, 500 * ms, 1 * ms) != 0 || hake_insert(header, late) != 0 ||
+       hake_admit(header, soon, 100 * ms, 1 * ms) != 0 || hake_insert(header, soon) != 0) {
+      ABORT_ERROR("...could not admit the deadline processes!");
+    }
+    if(hake_outranks(header, soon, late) != earlier[p] || hake_outranks(header, late, soon) != 0 ||
+       hake_outranks(header, critical, soon) != 0) {
+      ABORT_ERROR("...an earlier deadline did not preempt exactly under EDF!");
+    }
+
+    hake_insert(header, running);
+    hake_deallocate(header);
+  }
+  PRINT_STATUS("...Preemption is looking good so far.");
+}
+
+/* Local function to test that a quantum grows with full CPU use and shrinks with blocking, within bounds */
+void test_hake_quantum() {
+  const long long base = SLEEP_USEC * 1000LL;
+  Hake_process_s *batch = hake_new_process("batch", 1, 128, 0);
+  Hake_process_s *sleepy = hake_new_process("sleepy", 2, 128, 0);
+  Hake_process_s *mixed = hake_new_process("mixed", 3, 128, 0);
+
+  if(batch->quantum_ns != 0 || hake_adapt_quantum(NULL, base, base, base) != 0 || hake_adapt_quantum(batch, 0, base, base) != 0) {
+    ABORT_ERROR("...a new process should have no quantum, and bad arguments should be rejected!");
+  }
+
+  PRINT_STATUS("...Growing a CPU bound process and shrinking a sleeping one");
+  if(hake_adapt_quantum(batch, base, base, base) != 2 * base || hake_adapt_quantum(sleepy, base, base, base / 10) != base / 2 ||
+     hake_adapt_quantum(mixed, base, base, base * 70 / 100) != base) {
+    ABORT_ERROR("...the quantum did not double on full use, halve on blocking, or hold in between!");
+  }
+  for(int i = 0; i < 20; i++) {
+    long long slice = batch->quantum_ns;
+    hake_adapt_quantum(batch, base, slice, slice);
+    slice = sleepy->quantum_ns;
+    hake_adapt_quantum(sleepy, base, slice, 0);
+  }
+  if(batch->quantum_ns != SLEEP_MAX_USEC * 1000LL || sleepy->quantum_ns != SLEEP_MIN_USEC * 1000LL) {
+    ABORT_ERROR("...the quantum left SLEEP_MIN_USEC..SLEEP_MAX_USEC!");
+  }
+
+  PRINT_STATUS("...Keeping the quantum when the CPU time is unknown");
+  if(hake_adapt_quantum(batch, base, base, -1) != SLEEP_MAX_USEC * 1000LL || hake_adapt_quantum(mixed, base, 0, 0) != base) {
+    ABORT_ERROR("...a slice with no measurements changed the quantum!");
+  }
+
+  hake_free_process(batch);
+  hake_free_process(sleepy);
+  hake_free_process(mixed);
+  PRINT_STATUS("...The adaptive quantum is looking good so far.");
+}
+
+/* Local function to test that measured CPU time, not time held on the CPU, is what runs are charged */
+void test_hake_cpu_charge() {
+  const long long ms = 1000000LL;
+  Hake_schedule_s *header = hake_create();
+  Hake_process_s *process = hake_new_process("measured", 1, DEFAULT_PRIORITY, 0);
+
+  if(header == NULL || hake_set_policy(header, hake_get_policy(HAKE_CFS_POLICY)) != 0) {
+    ABORT_ERROR("...could not create a cfs schedule!");
+  }
+  if(process->cpu_ns != 0 || process->slice_cpu_ns != -1 || hake_charge_cpu(process, 5 * ms) != -1 || hake_charge_cpu(NULL, 0) != -1) {
+    ABORT_ERROR("...only a Running process can be charged!");
+  }
+  hake_insert(header, process);
+
+  PRINT_STATUS("...Charging 30ms of CPU for a slice that held the CPU for 100ms");
+  test_expect_select(header, 1);
+  process->run_start_ns -= 100 * ms;
+  if(hake_charge_cpu(process, 30 * ms) != 0 || process->slice_cpu_ns != 30 * ms || process->cpu_ns != 30 * ms) {
+    ABORT_ERROR("...the slice was not charged from the running total!");
+  }
+  hake_insert(header, process);
+  if(process->vruntime != (unsigned long long)(30 * ms)) {
+    ABORT_ERROR("...cfs charged the time held rather than the CPU time used!");
+  }
+
+  PRINT_STATUS("...Charging the next slice from the total, and rejecting a total that went back");
+  test_expect_select(header, 1);
+  if(process->slice_cpu_ns != -1 || hake_charge_cpu(process, 20 * ms) != -1 || hake_charge_cpu(process, 45 * ms) != 0 ||
+     process->slice_cpu_ns != 15 * ms || process->cpu_ns != 45 * ms) {
+    ABORT_ERROR("...a new slice should start unmeasured and be charged only its own CPU time!");
+  }
+  hake_insert(header, process);
+  if(process->vruntime != (unsigned long long)(45 * ms)) {
+    ABORT_ERROR("...cfs did not charge the second slice its CPU time!");
+  }
+
+  // Without a charge, the time held on the CPU is used as before
+  test_expect_select(header, 1);
+  process->run_start_ns -= 10 * ms;
+  hake_insert(header, process);
+  if(process->vruntime < (unsigned long long)(55 * ms) || process->cpu_ns != 45 * ms) {
+    ABORT_ERROR("...an unmeasured slice was not charged the time it held the CPU!");
+  }
+  hake_deallocate(header);
+
+  PRINT_STATUS("...Switching to cfs after a run under another policy, then suspending and resuming");
+  header = hake_create();
+  process = hake_new_process("elsewhere", 2, DEFAULT_PRIORITY, 0);
+  hake_insert(header, process);
+  test_expect_select(header, 2);
+  process->run_start_ns -= 20 * ms;
+  hake_insert(header, process);
+  if(process->last_run_ns != 0 || hake_set_policy(header, hake_get_policy(HAKE_CFS_POLICY)) != 0 ||
+     hake_suspend(header, 2) != 0 || hake_resume(header, 2) != 0) {
+    ABORT_ERROR("...could not switch and move the process!");
+  }
+  if(process->vruntime != 0) {
+    ABORT_ERROR("...cfs charged a run that was already handed to another policy!");
+  }
+
+  hake_deallocate(header);
+  PRINT_STATUS("...CPU charging is looking good so far.");
+}
+
+/* Local function to test the wait and run time accounting behind the stats command */
+void test_hake_accounting() {
+  const long long ms = 1000000LL;
+  Hake_schedule_s *header = hake_create();
+  Hake_process_s *process = hake_new_process("accounted", 1, DEFAULT_PRIORITY, 0);
+
+  if(header == NULL || process == NULL) {
+    ABORT_ERROR("...could not create a schedule and process!");
+  }
+  if(process->wait_ns != 0 || process->run_ns != 0 || hake_get_wait(process) != 0 || hake_get_wait(NULL) != -1) {
+    ABORT_ERROR("...a new process should start with no wait or run time!");
+  }
+  hake_insert(header, process);
+
+  PRINT_STATUS("...Waiting 40ms Ready, then running for 10ms");
+  process->ready_since_ns -= 40 * ms;
+  if(hake_get_wait(process) < 40 * ms || process->wait_ns != 0) {
+    ABORT_ERROR("...the wait in progress was not counted!");
+  }
+  test_expect_select(header, 1);
+  if(process->ready_since_ns != 0 || process->wait_ns < 40 * ms || hake_get_wait(process) != process->wait_ns) {
+    ABORT_ERROR("...selecting the process did not finish its wait!");
+  }
+  process->run_start_ns -= 10 * ms;
+  hake_insert(header, process);
+  if(process->run_ns < 10 * ms || process->ready_since_ns == 0) {
+    ABORT_ERROR("...the run was not added, or a new wait not started!");
+  }
+
+  PRINT_STATUS("...Suspending stops the wait clock, and resuming restarts it");
+  process->ready_since_ns -= 5 * ms;
+  if(hake_suspend(header, 1) != 0 || process->ready_since_ns != 0 || process->wait_ns < 45 * ms) {
+    ABORT_ERROR("...suspending did not finish the wait!");
+  }
+  if(hake_resume(header, 1) != 0 || process->ready_since_ns == 0) {
+    ABORT_ERROR("...resuming did not start a new wait!");
+  }
+
+  PRINT_STATUS("...Exiting while Running adds the last run");
+  test_expect_select(header, 1);
+  process->run_start_ns -= 20 * ms;
+  if(hake_exited(header, process, 0) != 0 || process->run_ns < 30 * ms) {
+    ABORT_ERROR("...the final run was not added on exit!");
+  }
+
+  hake_deallocate(header);
+  PRINT_STATUS("...Accounting is looking good so far.");
+}
+
+/* A virtual clock for test_hake_clock, advanced by hand */
+static long long test_now_ns = 0;
+static long long test_clock_ns() {
+  return test_now_ns;
+}
+
+/* Local function to test that every Hake time comes from the clock set with hake_set_clock */
+void test_hake_clock() {
+  const long long ms = 1000000LL;
+  Hake_schedule_s *header = NULL;
+  Hake_process_s *process = NULL;
+
+  test_now_ns = 1000 * ms;
+  hake_set_clock(test_clock_ns);
+  header = hake_create();
+  process = hake_new_process("virtual", 1, DEFAULT_PRIORITY, 0);
+  if(header == NULL || process == NULL || process->start_ns != 1000 * ms) {
+    ABORT_ERROR("...a new process was not stamped with the virtual time!");
+  }
+
+  PRINT_STATUS("...Waiting exactly 30ms, running exactly 20ms, on the virtual clock");
+  hake_insert(header, process);
+  test_now_ns += 30 * ms;
+  if(hake_get_wait(process) != 30 * ms) {
+    ABORT_ERROR("...the wait was not measured on the virtual clock!");
+  }
+  test_expect_select(header, 1);
+  if(process->first_run_ns != 1030 * ms || process->wait_ns != 30 * ms) {
+    ABORT_ERROR("...the select was not stamped with the virtual time!");
+  }
+  test_now_ns += 20 * ms;
+  if(hake_exited(header, process, 0) != 0 || process->run_ns != 20 * ms || process->end_ns != 1050 * ms) {
+    ABORT_ERROR("...the run was not measured on the virtual clock!");
+  }
+
+  hake_set_clock(NULL);
+  hake_deallocate(header);
+  PRINT_STATUS("...The virtual clock is looking good so far.");
+}
+
+/* Helper function to check the red-black properties under a node.
+ * Exits the program with ABORT_ERROR on any failures.
+ * Returns the black height of the subtree.
+ */
+static int test_rb_black_height(Hake_process_s *node) {
+  if(node == NULL) {
+    return 1;
+  }
+  if((node->left != NULL && node->left->parent != node) || (node->right != NULL && node->right->parent != node)) {
+    ABORT_ERROR("...a cfs tree node has the wrong parent!");
+  }
+  if(node->red && ((node->left != NULL && node->left->red) || (node->right != NULL && node->right->red))) {
+    ABORT_ERROR("...a red cfs tree node has a red child!");
+  }
+  int left = test_rb_black_height(node->left);
+  if(left != test_rb_black_height(node->right)) {
+    ABORT_ERROR("...the cfs tree's black heights differ!");
+  }
+  return left + (node->red ? 0 : 1);
+}
+
+/* Helper function to check that hake_select picks the given pid and marks it Running
+ * Exits the program with ABORT_ERROR on any failures.
+ */
+static void test_expect_select(Hake_schedule_s *header, pid_t pid) {
+  Hake_process_s *selected = hake_select(header);
+  if(selected == NULL) {
+    ABORT_ERROR("...hake_select returned NULL!");
+  }
+  if(selected->pid != pid) {
+    PRINT_WARNING("...expected PID %d but hake_select returned PID %d", pid, selected->pid);
+    ABORT_ERROR("...hake_select picked the wrong process!");
+  }
+  if(!(selected->state & HAKE_STATE_RUNNING) || selected->age != 0) {
+    ABORT_ERROR("...the selected process should be Running with an age of 0!");
+  }
+}
+
 /* Helper function to test if a queue is properly initialized
  * Exits the program with ABORT_ERROR on any failures.
  */
@@ -21,6 +21,7 @@
 #include "vm_process.h"
 #include "vm_printing.h"
 #include "vm_cs.h"
+#include "vm_record.h"
 
 /* Project Globals */
 int g_debug_mode = DEFAULT_DEBUG; // Default is to start at Debug OFF.
@@ -47,12 +48,41 @@ void vm_cleanup() {
 
   PRINT_STATUS("Deallocating all Processes.");
   deallocate_process_system();
+
+  record_close(); // Last, so the exits of processes killed on the way out are recorded too
 }
 
 /* Set up the main VM environment, then drop to a user shell.
+ * - Usage: ./vm [-n cpus] [-R file]
+ *   -n  Number of simulated CPUs (default DEFAULT_CPUS in inc/vm_settings.h)
+ *   -R  Records the session to file, for replaying with sim_hake -R file
  * Returns 0 on Succesful completion of the program.
  */
-int main() {
+int main(int argc, char *argv[]) {
+  int num_cpus = DEFAULT_CPUS;
+  const char *record_path = NULL;
+  int opt = 0;
+
+  // Parse the command line options before anything else starts
+  while((opt = getopt(argc, argv, "n:R:")) != -1) {
+    switch(opt) {
+      case 'n':
+        num_cpus = atoi(optarg);
+        if(num_cpus < 1 || num_cpus > MAX_CPUS) {
+          fprintf(stderr, "%s: cpus must be between 1 and %d\n", argv[0], MAX_CPUS);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'R':
+        record_path = optarg;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-n cpus] [-R file]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+
   // Registers functions to be called on Ctrl-C (SIGINT) or Segfault
   register_signal(SIGSEGV, hnd_sigsegv);
   register_signal(SIGINT, hnd_sigint);
@@ -65,7 +95,16 @@ int main() {
   atexit(vm_cleanup);
 
   // Begin Running the Context Switch Threading System
-  initialize_cs_system();
+  initialize_cs_system(num_cpus);
+
+  // Record the session from here on, if asked to (starting with the settings it began with)
+  if(record_path != NULL) {
+    if(record_open(record_path) != 0) {
+      ABORT_ERROR("Could not create the recording file.");
+    }
+    record_event(RECORD_BEGIN, 0, get_num_cpus(), 0, get_run_usec() * 1000LL, 0, get_schedule(0)->policy->name);
+    PRINT_STATUS("Recording this session to %s", record_path);
+  }
 
   // Set up main VM Environment to handle and track Jobs
   initialize_process_system(); 
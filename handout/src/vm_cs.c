@@ -7,9 +7,15 @@
  *   This controls all threads.
  */
 
+/* Needed for the CPU affinity macros (cpu_set_t, CPU_SET) */
+#define _GNU_SOURCE
+
 /* Standard Library Includes */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
 /* Linux API Library Includes */
 #include <signal.h>
 #include <unistd.h>
@@ -18,6 +24,7 @@
 #include <sys/time.h>
 #include <pthread.h>
 #include <sched.h>
+#include <sys/prctl.h>
 /* Trilby Project Includes */
 #include "vm.h"
 #include "vm_cs.h"
@@ -26,41 +33,776 @@
 #include "vm_printing.h"
 /* Hake Scheduler Library Includes */
 #include "hake_sched.h"
+#include "vm_trace.h"
+#include "vm_record.h"
 
 /* Global Constants */
 enum cs_states { CS_STOP = 0, CS_RUN };
+#define JITTER_BUCKETS 24 // Quantum error histogram: < 1 usec, then one bucket per power of 2 usec
+
+/* Quantum Timing Statistics (per CPU, updated under its lock)
+ * - The error of a slice is how long the process really ran (SIGCONT to SIGTSTP) minus its quantum.
+ * - Bucket 0 counts |error| < 1 usec, bucket b counts 2^(b-1) <= |error| < 2^b usec, and the last
+ *   bucket counts everything larger.
+ */
+typedef struct cs_jitter {
+  long long slices;                    // Slices measured
+  long long early;                     // Slices that ended before their quantum
+  long long total_abs_ns;              // Sum of |error|
+  long long max_abs_ns;                // Largest |error|
+  long long buckets[JITTER_BUCKETS];   // Log2 histogram of |error|
+} Cs_jitter_s;
+
+/* Per-CPU Context Switch State
+ * - Each CPU has its own dispatcher thread, local schedule (Ready/Suspended/Terminated Queues),
+ *   and on_cpu slot.  The lock protects the schedule, the slot, and the pending suspend.
+ * - Control operations (suspend/resume/terminate) take only this lock, never the CS turnstile,
+ *   so they return at once while the dispatchers keep switching.
+ */
+typedef struct cs_cpu {
+  int id;                    // CPU number (0 .. num_cpus-1)
+  int host_cpu;              // Host core the dispatcher (and optionally its child) is pinned to
+  pthread_t thread;          // Dispatcher thread for this CPU
+  pthread_mutex_t lock;      // Protects schedule and on_cpu
+  Hake_schedule_s *schedule; // Local schedule for this CPU
+  Hake_process_s *on_cpu;    // Process currently running on this CPU (or NULL)
+  int suspend_pending;       // Suspend on_cpu when its quantum ends (it was asked while running)
+  int steals;                // Number of processes this CPU has stolen from others
+  long long carry_ns;        // Overshoot of the last slice, taken off the next one
+  Cs_jitter_s jitter;        // Quantum error statistics for the status command
+  long long start_lat_ns;    // How long the last start_cs took to get this dispatcher going
+  long long start_lat_max_ns;
+  long long stop_lat_ns;     // How long the last stop_cs took to park this dispatcher (its process stopped)
+  long long stop_lat_max_ns;
+  pthread_cond_t wake;       // Signalled (under cs_cv_m) when work arrives for this CPU while it is idle
+  int idle;                  // 1 while parked on wake with nothing to run (under cs_cv_m)
+  int kicked;                // Work arrived since the dispatcher last looked (under cs_cv_m)
+  long long arrivals;        // Processes given their first run on this CPU
+  long long arrival_total_ns; // Sum of their arrival to first run latencies
+  long long arrival_max_ns;  // Largest arrival to first run latency
+  long long last_stop_ns;    // When the last process was stopped, if the CPU went straight on to switching
+  long long busy_ns;         // Time processes have run on this CPU
+  long long gaps;            // Switches timed (SIGTSTP of one process to SIGCONT of the next)
+  long long gap_total_ns;    // Sum of those switch gaps
+  long long gap_max_ns;      // Largest switch gap
+  long long elided;          // Quanta where the running process won again and simply kept the CPU
+  pid_t preempt_pid;         // Running PID an arrival outranks, to be stopped now rather than at its quantum end (under cs_cv_m)
+  long long preemptions;     // Quanta cut short by a preemption
+  long long crit_arrivals;   // Critical processes given their first run on this CPU
+  long long crit_total_ns;   // Sum of their arrival to dispatch latencies
+  long long crit_max_ns;     // Largest Critical arrival to dispatch latency
+  long long blocked_ends;    // Slices ended early because the process blocked
+  long long reclaimed_ns;    // Quantum time those slices gave back to other processes
+  long long stops;           // Stops confirmed (the process was seen stopped before switching)
+  long long stop_total_ns;   // Sum of the times from SIGTSTP to a confirmed stop
+  long long stop_max_ns;     // Longest time to a confirmed stop
+  long long stop_escalations; // Processes that ignored SIGTSTP and were sent SIGSTOP
+  long long stop_failures;   // Processes still seen running after SIGSTOP too
+  pid_t stopping_pid;        // Process whose stop is being confirmed with the lock dropped (0 if none)
+} Cs_cpu_s;
+
+/* Accounting sample of one process, copied out under its CPU's lock for the stats */
+typedef struct cs_sample {
+  pid_t pid;
+  char cmd[32];              // Command (truncated), copied since Terminated nodes can be evicted
+  char state;                // R(eady), U (running), S(uspended), or T(erminated)
+  int runs;                  // Slices it has been given
+  long long cpu_ns;          // CPU time it used (measured)
+  long long run_ns;          // Time it held a CPU
+  long long wait_ns;         // Time it spent Ready
+  long long response_ns;     // Arrival to first run, or -1 if it has not run yet
+  long long turnaround_ns;   // Arrival to termination, or -1 while it is live
+  long long lifetime_ns;     // Arrival until termination or now
+} Cs_sample_s;
+
+/* Accounting statistics over every process the CPUs know of (live, and Terminated still in memory) */
+typedef struct cs_stats {
+  Cs_sample_s *samples;
+  int count;
+  int capacity;
+  int states[4];             // Samples that are Ready, Running, Suspended, and Terminated
+  long long completed;       // Processes terminated since startup (including archived ones)
+  long long elapsed_ns;      // Time since the CS system was initialized
+  double throughput;         // Completed per minute
+  double fairness;           // Jain's index of the CPU share (CPU time / lifetime) of every sample
+  long long wait[3];         // p50, p95, p99 of the samples' wait times
+  long long response[3];     // p50, p95, p99 of response times (of samples that have run)
+  long long turnaround[3];   // p50, p95, p99 of turnaround times (of Terminated samples)
+  int responses;
+  int turnarounds;
+} Cs_stats_s;
 
-/* Mutex Control Variables */
+/* Run Gate (start_cs and stop_cs change cs_run under cs_cv_m and broadcast cs_cv)
+ * - Dispatchers park on cs_cv while stopped; every other sleep of theirs (idle, or timed within a quantum)
+ *   is on their own CPU's wake condition, which the Gate broadcasts too, so a start or stop wakes
+ *   them at once, even in the middle of a quantum.
+ * - Work kicked to an idle CPU, and a preemption of a busy one, signal just that CPU's wake condition.
+ */
+pthread_cond_t cs_cv;
+pthread_condattr_t cs_cvattr; // Timed waits are on CLOCK_MONOTONIC, like every quantum deadline
 pthread_mutex_t cs_cv_m = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t cs_run_m = PTHREAD_MUTEX_INITIALIZER;
-pthread_t pt_cs; // Main CS thread variable (controlled from atexit function)
 
 /* Local Global Variables (these are all private to this source file) */
-static Hake_process_s *on_cpu = NULL;
-static Hake_schedule_s *schedule = NULL;
+static Cs_cpu_s cpus[MAX_CPUS];
+static int num_cpus = 0;
 static int cs_do_cs = CS_RUN; // Controls the lifetime CS Thread
 static int cs_run = CS_STOP; // Controls the running of the CS Thread (initialized to STOP)
+static long long cs_changed_ns = 0; // When cs_run last changed (0 before the first start)
 static useconds_t sleep_usec_time = SLEEP_USEC;
 static useconds_t between_usec_time = BETWEEN_USEC;
+static int dispatch_pipelined = PIPELINED_DISPATCH; // 0 waits between_usec_time after every quantum
+static useconds_t block_poll_usec = BLOCK_POLL_USEC; // How often the running child is checked for blocking (0 = never)
+static __thread int is_dispatcher = 0; // Set on dispatcher threads, which never take signals
+static unsigned int migrations = 0; // Bumped on every steal, so a lookup can tell it raced a move
+static long long stats_epoch_ns = 0; // When the CS system was initialized (throughput is per minute since)
+static pthread_t stats_thread;
+static int stats_running = 0; // 1 if stats_thread was started
+
+/* Local Prototypes */
+static void cpu_lock(Cs_cpu_s *cpu, sigset_t *old_mask);
+static void cpu_unlock(Cs_cpu_s *cpu, sigset_t *old_mask);
+static void cpu_pin(pid_t pid, int host_cpu);
+static Cs_cpu_s *cpu_least_loaded();
+static Cs_cpu_s *cpu_lock_owner(pid_t pid, sigset_t *old_mask);
+static Hake_process_s *cpu_steal(Cs_cpu_s *thief);
+static void cpu_exit_on_cpu(Cs_cpu_s *cpu, int exit_code);
+static long long cs_cpu_time_ns(pid_t pid);
+static long long cpu_quantum_ns(Cs_cpu_s *cpu);
+static void cpu_adapt_quantum(Cs_cpu_s *cpu, long long ran_ns);
+static void cpu_charge(Cs_cpu_s *cpu);
+static char cs_child_state(pid_t pid);
+static int cs_wait_stopped(pid_t pid, long long deadline_ns);
+static void cpu_confirm_stop(Cs_cpu_s *cpu, pid_t pid);
+static void gate_lock(sigset_t *old_mask);
+static void gate_unlock(sigset_t *old_mask);
+static int cs_gate_wait(Cs_cpu_s *cpu);
+static int cs_sleep_until(Cs_cpu_s *cpu, pid_t pid, long long deadline_ns);
+static int cs_run_quantum(Cs_cpu_s *cpu, pid_t pid, long long deadline_ns);
+static int cs_child_blocked(pid_t pid, long long *cpu_ns);
+static void cpu_record_latency(Cs_cpu_s *cpu, long long *last_ns, long long *max_ns);
+static int cs_state();
+static void gate_broadcast();
+static void cs_idle_wait(Cs_cpu_s *cpu);
+static void cpu_kick(Cs_cpu_s *cpu);
+static void cs_work_arrived(Cs_cpu_s *cpu, pid_t preempt_pid);
+static pid_t cpu_outranked(Cs_cpu_s *cpu);
+static void cpu_record_arrival(Cs_cpu_s *cpu, Hake_process_s *process);
+static void cpu_account_slice(Cs_cpu_s *cpu, long long quantum_ns, long long planned_ns, long long ran_ns);
+static void cs_continue_stopped(pid_t pid);
+static void print_cpu_jitter(Cs_cpu_s *cpu);
+static void stats_add(Cs_stats_s *stats, Hake_process_s *process, char state, long long now_wall_ns);
+static void stats_percentiles(long long *values, int n, long long out[3]);
+static int stats_compare(const void *a, const void *b);
+static int stats_collect(Cs_stats_s *stats);
+static int stats_write(const char *path);
+static void *cs_stats_thread(void *args);
+
+/* Locks a CPU's schedule.
+ * - Outside of the dispatchers, SIGCHLD and SIGINT are held off while locked, since their
+ *   handlers lock CPUs too (a handler interrupting its own thread's lock would deadlock).
+ */
+static void cpu_lock(Cs_cpu_s *cpu, sigset_t *old_mask) {
+  if(!is_dispatcher) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &mask, old_mask);
+  }
+  pthread_mutex_lock(&cpu->lock);
+}
+
+/* Unlocks a CPU's schedule, restoring the signal mask saved by cpu_lock. */
+static void cpu_unlock(Cs_cpu_s *cpu, sigset_t *old_mask) {
+  pthread_mutex_unlock(&cpu->lock);
+  if(!is_dispatcher) {
+    pthread_sigmask(SIG_SETMASK, old_mask, NULL);
+  }
+}
+
+/* Pins a thread or process (0 for the calling thread) to a single host core. */
+static void cpu_pin(pid_t pid, int host_cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(host_cpu, &set);
+  if(sched_setaffinity(pid, sizeof(set), &set) == -1) {
+    PRINT_DEBUG("Could not pin %d to host core %d", pid, host_cpu);
+  }
+}
+
+/* Returns the CPU with the fewest Ready (and running) processes, for placing new processes. */
+static Cs_cpu_s *cpu_least_loaded() {
+  Cs_cpu_s *best = &cpus[0];
+  int best_load = -1;
+
+  for(int i = 0; i < num_cpus; i++) {
+    // Unlocked reads; this is only a placement hint.
+    int load = hake_get_count(cpus[i].schedule->ready_queue) + (cpus[i].on_cpu ? 1 : 0);
+    if(best_load == -1 || load < best_load) {
+      best = &cpus[i];
+      best_load = load;
+    }
+  }
+  return best;
+}
+
+/* Finds and locks the CPU tracking the given pid anywhere in its schedule or on its slot.
+ * - A process stolen between two CPUs while they are being scanned could be missed by both,
+ *   so the scan is repeated until no steal happened during it.
+ * Returns the locked CPU (release with cpu_unlock), or NULL if no CPU tracks the pid.
+ */
+static Cs_cpu_s *cpu_lock_owner(pid_t pid, sigset_t *old_mask) {
+  unsigned int seen = 0;
+
+  do {
+    seen = __atomic_load_n(&migrations, __ATOMIC_ACQUIRE);
+    for(int i = 0; i < num_cpus; i++) {
+      cpu_lock(&cpus[i], old_mask);
+      if((cpus[i].on_cpu && cpus[i].on_cpu->pid == pid) || hake_find(cpus[i].schedule, pid) != NULL) {
+        return &cpus[i];
+      }
+      cpu_unlock(&cpus[i], old_mask);
+    }
+  } while(seen != __atomic_load_n(&migrations, __ATOMIC_ACQUIRE));
+  return NULL;
+}
+
+/* Exits the process on a CPU's slot (called with the CPU locked).
+ * - hake_exited may free the node (with no Terminated retention), so its pid is saved first.
+ */
+static void cpu_exit_on_cpu(Cs_cpu_s *cpu, int exit_code) {
+  pid_t pid = cpu->on_cpu->pid;
+
+  if(hake_exited(cpu->schedule, cpu->on_cpu, exit_code) == -1) {
+    ABORT_ERROR("Error reported by hake_exited.");
+  }
+  trace_event(TRACE_EXIT, cpu->id, pid, exit_code);
+  PRINT_DEBUG("Exiting PID %d on CPU %d, with exit code %d with hake_exited\n", pid, cpu->id, exit_code);
+  cpu->on_cpu = NULL;
+  cpu->suspend_pending = 0;
+}
+
+/* Returns the CPU time (ns) a process has used so far, from /proc/<pid>/schedstat, or -1 if unavailable. */
+static long long cs_cpu_time_ns(pid_t pid) {
+  char path[64];
+  long long cpu_ns = -1;
+  FILE *fp = NULL;
+
+  snprintf(path, sizeof(path), "/proc/%d/schedstat", pid);
+  fp = fopen(path, "r");
+  if(fp == NULL) {
+    return -1;
+  }
+  if(fscanf(fp, "%lld", &cpu_ns) != 1) {
+    cpu_ns = -1;
+  }
+  fclose(fp);
+  return cpu_ns;
+}
+
+/* Returns how long the process on a CPU should run (called with the CPU locked).
+ * - Policies with their own slice length (eg. cfs) decide it; otherwise it is the process' own
+ *   adaptive quantum once it has one, or the runtime setting.
+ */
+static long long cpu_quantum_ns(Cs_cpu_s *cpu) {
+  long long slice_ns = hake_get_slice(cpu->schedule, cpu->on_cpu);
+
+  if(slice_ns > 0) {
+    return slice_ns;
+  }
+#if ADAPTIVE_QUANTUM > 0
+  if(cpu->on_cpu->quantum_ns > 0) {
+    return cpu->on_cpu->quantum_ns;
+  }
+#endif
+  return sleep_usec_time * 1000LL;
+}
+
+/* Adapts the quantum of the process on a CPU to its CPU use over the slice that just ran its full length
+ *   (called with the CPU locked, after cpu_charge), so batch jobs get longer slices and ones that block get shorter ones.
+ */
+static void cpu_adapt_quantum(Cs_cpu_s *cpu, long long ran_ns) {
+#if ADAPTIVE_QUANTUM > 0
+  long long before_ns = cpu->on_cpu->quantum_ns;
+
+  if(cpu->on_cpu->slice_cpu_ns >= 0) {
+    hake_adapt_quantum(cpu->on_cpu, sleep_usec_time * 1000LL, ran_ns, cpu->on_cpu->slice_cpu_ns);
+    if(cpu->on_cpu->quantum_ns != before_ns) {
+      PRINT_DEBUG("PID %d used %lld%% of its slice, its quantum is now %lld usec", cpu->on_cpu->pid,
+          cpu->on_cpu->slice_cpu_ns * 100 / (ran_ns > 0 ? ran_ns : 1), cpu->on_cpu->quantum_ns / 1000);
+    }
+  }
+#endif
+}
+
+/* Charges the process on a CPU for the CPU time it really used in the slice ending now (called with the CPU locked).
+ * - The time is read while it still runs, so what it uses until it has stopped counts toward its next slice.
+ */
+static void cpu_charge(Cs_cpu_s *cpu) {
+  long long total_ns = cs_cpu_time_ns(cpu->on_cpu->pid);
+
+  if(total_ns >= 0) {
+    hake_charge_cpu(cpu->on_cpu, total_ns);
+  }
+}
+
+/* Returns a child's scheduler state from /proc/<pid>/stat (eg. 'R', 'S', 'T'), or 0 if it is gone. */
+static char cs_child_state(pid_t pid) {
+  char path[64];
+  char buffer[512];
+  char *state = NULL;
+  FILE *fp = NULL;
+  size_t len = 0;
+
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  fp = fopen(path, "r");
+  if(fp == NULL) {
+    return 0;
+  }
+  len = fread(buffer, 1, sizeof(buffer) - 1, fp);
+  fclose(fp);
+  buffer[len] = '\0';
+  // The state follows the command name, which is in parentheses and may itself hold spaces or ')'
+  state = strrchr(buffer, ')');
+  if(state == NULL || state[1] != ' ') {
+    return 0;
+  }
+  return state[2];
+}
+
+/* Waits (polling every STOP_POLL_USEC) until a child is stopped or gone, or until a monotonic deadline.
+ * Returns 1 once it is off the CPU, or 0 if it was still running at the deadline.
+ */
+static int cs_wait_stopped(pid_t pid, long long deadline_ns) {
+  struct timespec poll = { 0, STOP_POLL_USEC * 1000L };
+
+  while(1) {
+    char state = cs_child_state(pid);
+    if(state == 0 || state == 'T' || state == 't' || state == 'Z' || state == 'X') {
+      return 1;
+    }
+    if(monotonic_ns() >= deadline_ns) {
+      return 0;
+    }
+    nanosleep(&poll, NULL);
+  }
+}
+
+/* Makes sure the child just sent SIGTSTP is really stopped before the CPU goes to the next one.
+ * - Called with the CPU locked and the child already off on_cpu (only queued).  The lock is dropped
+ *   while polling, so control operations don't wait on it; stopping_pid keeps it from being stolen
+ *   (and continued elsewhere) until it has stopped.
+ * - SIGTSTP can be caught, ignored, or held up, so after STOP_CONFIRM_USEC the child gets SIGSTOP (which can't be).
+ */
+static void cpu_confirm_stop(Cs_cpu_s *cpu, pid_t pid) {
+  long long sent_ns = monotonic_ns();
+  long long took_ns = 0;
+  int escalated = 0;
+  int stopped = 0;
+
+  cpu->stopping_pid = pid;
+  pthread_mutex_unlock(&cpu->lock);
+  stopped = cs_wait_stopped(pid, sent_ns + STOP_CONFIRM_USEC * 1000LL);
+  if(!stopped) {
+    PRINT_DEBUG("CPU %d: PID %d did not stop on SIGTSTP, sending SIGSTOP", cpu->id, pid);
+    kill(pid, SIGSTOP);
+    escalated = 1;
+    stopped = cs_wait_stopped(pid, monotonic_ns() + STOP_CONFIRM_USEC * 1000LL);
+  }
+  took_ns = monotonic_ns() - sent_ns;
+  pthread_mutex_lock(&cpu->lock);
+  cpu->stopping_pid = 0;
+
+  cpu->stop_escalations += escalated;
+  if(!stopped) {
+    PRINT_WARNING("CPU %d: PID %d is still running after SIGSTOP", cpu->id, pid);
+    cpu->stop_failures++;
+    return;
+  }
+  cpu->stops++;
+  cpu->stop_total_ns += took_ns;
+  if(took_ns > cpu->stop_max_ns) {
+    cpu->stop_max_ns = took_ns;
+  }
+}
+
+/* Locks the Run Gate, holding off SIGCHLD and SIGINT outside of the dispatchers (see cpu_lock). */
+static void gate_lock(sigset_t *old_mask) {
+  if(!is_dispatcher) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &mask, old_mask);
+  }
+  pthread_mutex_lock(&cs_cv_m);
+}
+
+/* Unlocks the Run Gate, restoring the signal mask saved by gate_lock. */
+static void gate_unlock(sigset_t *old_mask) {
+  pthread_mutex_unlock(&cs_cv_m);
+  if(!is_dispatcher) {
+    pthread_sigmask(SIG_SETMASK, old_mask, NULL);
+  }
+}
+
+/* Stores a start or stop latency (now minus the last gate change) in a CPU's stats. */
+static void cpu_record_latency(Cs_cpu_s *cpu, long long *last_ns, long long *max_ns) {
+  long long latency_ns = monotonic_ns() - __atomic_load_n(&cs_changed_ns, __ATOMIC_ACQUIRE);
+
+  pthread_mutex_lock(&cpu->lock);
+  *last_ns = latency_ns;
+  if(latency_ns > *max_ns) {
+    *max_ns = latency_ns;
+  }
+  pthread_mutex_unlock(&cpu->lock);
+}
+
+/* Parks a dispatcher at the Run Gate while the CS system is stopped, recording how long the
+ *   stop took to reach it and how long the next start took to wake it.
+ * Returns 1 to dispatch, or 0 if the CS system is shutting down.
+ */
+static int cs_gate_wait(Cs_cpu_s *cpu) {
+  int parked = 0;
+  int running = 0;
+
+  pthread_mutex_lock(&cs_cv_m);
+  if(cs_run == CS_STOP && cs_do_cs == CS_RUN && cs_changed_ns != 0) {
+    pthread_mutex_unlock(&cs_cv_m);
+    cpu_record_latency(cpu, &cpu->stop_lat_ns, &cpu->stop_lat_max_ns);
+    pthread_mutex_lock(&cs_cv_m);
+  }
+  while(cs_run == CS_STOP && cs_do_cs == CS_RUN) {
+    parked = 1;
+    cpu->last_stop_ns = 0; // Time parked here is not part of a switch
+    pthread_cond_wait(&cs_cv, &cs_cv_m);
+  }
+  running = (cs_do_cs == CS_RUN);
+  pthread_mutex_unlock(&cs_cv_m);
+
+  if(parked && running) {
+    cpu_record_latency(cpu, &cpu->start_lat_ns, &cpu->start_lat_max_ns);
+  }
+  return running;
+}
+
+/* Wakes every dispatcher, wherever it waits (called with the Run Gate locked). */
+static void gate_broadcast() {
+  pthread_cond_broadcast(&cs_cv);
+  for(int i = 0; i < num_cpus; i++) {
+    pthread_cond_broadcast(&cpus[i].wake);
+  }
+}
+
+/* Parks an idle dispatcher until work is kicked to its CPU, or the CS system stops or shuts down.
+ * - A kick that landed after the dispatcher found nothing to run (but before it parked) is not lost.
+ */
+static void cs_idle_wait(Cs_cpu_s *cpu) {
+  pthread_mutex_lock(&cs_cv_m);
+  cpu->idle = 1;
+  while(!cpu->kicked && cs_run == CS_RUN && cs_do_cs == CS_RUN) {
+    pthread_cond_wait(&cpu->wake, &cs_cv_m);
+  }
+  cpu->kicked = 0;
+  cpu->idle = 0;
+  pthread_mutex_unlock(&cs_cv_m);
+}
+
+/* Tells a CPU's dispatcher there may be work for it (called with the Run Gate locked). */
+static void cpu_kick(Cs_cpu_s *cpu) {
+  cpu->kicked = 1;
+  pthread_cond_signal(&cpu->wake);
+}
+
+/* Wakes the dispatcher of a CPU that just gained a Ready process, if it is idle.
+ * - If that CPU is busy, the first idle CPU is woken instead, so it can steal the process.
+ * - If no CPU was idle and preempt_pid (from cpu_outranked) is set, that CPU's running process
+ *   is preempted instead: its dispatcher wakes from the quantum sleep and switches right away.
+ * - Call without any CPU locked (CPU locks are taken before the Run Gate, never after).
+ */
+static void cs_work_arrived(Cs_cpu_s *cpu, pid_t preempt_pid) {
+  sigset_t old_mask;
+  int woken = 0;
+
+  gate_lock(&old_mask);
+  if(cpu->idle || num_cpus == 1) {
+    woken = cpu->idle;
+    cpu_kick(cpu);
+  }
+  else {
+    for(int i = 0; i < num_cpus && !woken; i++) {
+      if(cpus[i].idle) {
+        cpu_kick(&cpus[i]);
+        woken = 1;
+      }
+    }
+  }
+  if(!woken && preempt_pid != 0) {
+    cpu->preempt_pid = preempt_pid;
+    pthread_cond_signal(&cpu->wake);
+  }
+  gate_unlock(&old_mask);
+}
+
+/* Checks if the best Ready process of a CPU outranks the one running there (called with the CPU locked).
+ * - A process that is about to be suspended is left to its quantum end.
+ * Returns the PID to preempt, or 0 if the running process keeps its quantum.
+ */
+static pid_t cpu_outranked(Cs_cpu_s *cpu) {
+  if(cpu->on_cpu == NULL || cpu->suspend_pending ||
+     !hake_outranks(cpu->schedule, hake_ready_first(cpu->schedule), cpu->on_cpu)) {
+    return 0;
+  }
+  return cpu->on_cpu->pid;
+}
+
+/* Records how long a process waited from its creation to its first run (called with the CPU locked).
+ * - Critical processes are also tallied on their own, as the arrival to dispatch latency preemption bounds.
+ */
+static void cpu_record_arrival(Cs_cpu_s *cpu, Hake_process_s *process) {
+  struct timespec now;
+  long long latency_ns = 0;
+
+  clock_gettime(CLOCK_REALTIME, &now); // start_ns is wall clock time
+  latency_ns = now.tv_sec * 1000000000LL + now.tv_nsec - process->start_ns;
+  cpu->arrivals++;
+  cpu->arrival_total_ns += latency_ns;
+  if(latency_ns > cpu->arrival_max_ns) {
+    cpu->arrival_max_ns = latency_ns;
+  }
+  if(process->state & HAKE_STATE_CRITICAL) {
+    cpu->crit_arrivals++;
+    cpu->crit_total_ns += latency_ns;
+    if(latency_ns > cpu->crit_max_ns) {
+      cpu->crit_max_ns = latency_ns;
+    }
+  }
+}
+
+/* Sleeps until an absolute monotonic time, so time spent before the call doesn't push the wakeup back.
+ * - The sleep is a timed wait on the CPU's wake condition, so stopping (or shutting down) the CS system
+ *   cuts it short, as does a preemption of pid (the process running on the CPU, or 0 for none).
+ * - Any preemption still pending afterwards is stale (it was for a slice that is over), so it is dropped.
+ * Returns 0 at the deadline, 1 if pid was preempted, or -1 if the CS system was stopped first.
+ */
+static int cs_sleep_until(Cs_cpu_s *cpu, pid_t pid, long long deadline_ns) {
+  struct timespec deadline = { deadline_ns / 1000000000LL, deadline_ns % 1000000000LL };
+  int ret = 0;
 
-/* Run at VM startup to initialize Context Switching (CS) thread */
-void initialize_cs_system() {
-  // Start the CS Thread Locked by...
-  // 1) Acquiring the lock here on initialization
-  // 2) Each iteration of the CS thread starts by acquiring the lock.
-  // The Shell commands release/acquire the lock to control CS
   pthread_mutex_lock(&cs_cv_m);
+  while(cs_run == CS_RUN && cs_do_cs == CS_RUN && (pid == 0 || cpu->preempt_pid != pid)) {
+    if(pthread_cond_timedwait(&cpu->wake, &cs_cv_m, &deadline) == ETIMEDOUT) {
+      break;
+    }
+  }
+  if(cs_run != CS_RUN || cs_do_cs != CS_RUN) {
+    ret = -1;
+  }
+  else if(pid != 0 && cpu->preempt_pid == pid) {
+    ret = 1;
+  }
+  cpu->preempt_pid = 0;
+  pthread_mutex_unlock(&cs_cv_m);
+  return ret;
+}
 
-  // Create the runner thread for the CS system
-  int ret = pthread_create(&pt_cs, NULL, &cs_thread, NULL);
-  if(ret != 0) {
-    ABORT_ERROR("Could not create a Thread for the CS System.");
+/* Lets the process on a CPU run until its quantum deadline, like cs_sleep_until (0, 1 if preempted, or -1).
+ * - With block polling on, the child is checked every block_poll_usec instead, and the slice ends
+ *   as soon as it has blocked (returning 2), so the rest of the quantum goes to the next process.
+ */
+static int cs_run_quantum(Cs_cpu_s *cpu, pid_t pid, long long deadline_ns) {
+  long long poll_ns = __atomic_load_n(&block_poll_usec, __ATOMIC_RELAXED) * 1000LL;
+  long long cpu_ns = -1;
+  int ret = 0;
+
+  if(poll_ns == 0) {
+    return cs_sleep_until(cpu, pid, deadline_ns);
+  }
+  cpu_ns = cs_cpu_time_ns(pid);
+  while(1) {
+    long long now_ns = monotonic_ns();
+    if(now_ns >= deadline_ns) {
+      return 0;
+    }
+    ret = cs_sleep_until(cpu, pid, (now_ns + poll_ns < deadline_ns) ? now_ns + poll_ns : deadline_ns);
+    if(ret != 0) {
+      return ret;
+    }
+    if(monotonic_ns() < deadline_ns && cs_child_blocked(pid, &cpu_ns)) {
+      return 2;
+    }
   }
+}
+
+/* Checks if a child has blocked: it is sleeping (S or D in /proc/<pid>/stat) and has used no CPU
+ *   since the last check, so a quick write to the terminal doesn't count.
+ * - cpu_ns holds its CPU time at the last check (or -1), and is brought up to date.
+ * Returns 1 if it is blocked, or 0 if not (or if that can't be told).
+ */
+static int cs_child_blocked(pid_t pid, long long *cpu_ns) {
+  char state = cs_child_state(pid);
+  long long last_ns = *cpu_ns;
 
-  // Initialize the Scheduler System (this is designed as a part of CS)
-  schedule = hake_create();
-  if(schedule == NULL) {
-    ABORT_ERROR("Error reported by hake_create.");
+  *cpu_ns = cs_cpu_time_ns(pid);
+  if(state != 'S' && state != 'D') {
+    return 0;
+  }
+  return (last_ns >= 0 && *cpu_ns == last_ns);
+}
+
+/* Continues a child that is stopped while it holds the CPU.
+ * - A new child stops itself (SIGTSTP) before exec; if its first SIGCONT beat that, it is still
+ *   stopped, and an elided switch would otherwise leave it that way for as long as it is reselected.
+ */
+static void cs_continue_stopped(pid_t pid) {
+  if(cs_child_state(pid) == 'T') {
+    kill(pid, SIGCONT);
+  }
+}
+
+/* Records how long a process really ran against its quantum (called with the CPU locked).
+ * - The overshoot past the planned (already shortened) deadline is what the dispatcher adds on its own
+ *   (wakeup latency, the lock, and kill), so later slices are planned that much shorter.
+ * - The carry follows the overshoot as a moving average (1/8 per slice), so a one-off stall is paid
+ *   back over several slices instead of all at once, and is capped at half a quantum.
+ */
+static void cpu_account_slice(Cs_cpu_s *cpu, long long quantum_ns, long long planned_ns, long long ran_ns) {
+  long long error_ns = ran_ns - quantum_ns;
+  long long abs_ns = (error_ns < 0) ? -error_ns : error_ns;
+  long long usec = abs_ns / 1000;
+  int bucket = 0;
+
+  while(usec > 0 && bucket < JITTER_BUCKETS - 1) {
+    usec >>= 1;
+    bucket++;
+  }
+  cpu->jitter.buckets[bucket]++;
+  cpu->jitter.slices++;
+  cpu->jitter.early += (error_ns < 0);
+  cpu->jitter.total_abs_ns += abs_ns;
+  if(abs_ns > cpu->jitter.max_abs_ns) {
+    cpu->jitter.max_abs_ns = abs_ns;
+  }
+
+  cpu->carry_ns += (ran_ns - planned_ns - cpu->carry_ns) / 8;
+  if(cpu->carry_ns > quantum_ns / 2) {
+    cpu->carry_ns = quantum_ns / 2;
+  }
+  else if(cpu->carry_ns < -quantum_ns / 2) {
+    cpu->carry_ns = -quantum_ns / 2;
+  }
+}
+
+/* Takes the best Ready process from the busiest other CPU (called with the thief locked).
+ * - Victims are only try-locked, so two idle CPUs stealing from each other can't deadlock.
+ * - A deadline process is never stolen: it stays on the CPU whose EDF capacity admitted it.
+ * - Nor is one the victim is still confirming stopped (see cpu_confirm_stop).
+ * Returns the stolen process (now Running and owned by the thief) or NULL.
+ */
+static Hake_process_s *cpu_steal(Cs_cpu_s *thief) {
+  Cs_cpu_s *victim = NULL;
+  Hake_process_s *stolen = NULL;
+  int most = 0;
+
+  for(int i = 0; i < num_cpus; i++) {
+    int count = hake_get_count(cpus[i].schedule->ready_queue); // Unlocked hint
+    if(&cpus[i] != thief && count > most) {
+      victim = &cpus[i];
+      most = count;
+    }
+  }
+  if(victim == NULL || pthread_mutex_trylock(&victim->lock) != 0) {
+    return NULL;
+  }
+  stolen = hake_ready_first(victim->schedule);
+  if(stolen != NULL && (stolen->deadline_ns > 0 || stolen->pid == victim->stopping_pid)) {
+    stolen = NULL;
+  }
+  else if(stolen != NULL) {
+    stolen = hake_select(victim->schedule);
+    if(hake_detach(victim->schedule, stolen) == -1) {
+      ABORT_ERROR("Error reported by hake_detach.");
+    }
+    __atomic_add_fetch(&migrations, 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&victim->lock);
+
+  if(stolen != NULL) {
+    thief->steals++;
+    PRINT_DEBUG("CPU %d stole PID %d from CPU %d", thief->id, stolen->pid, victim->id);
+  }
+  return stolen;
+}
+
+/* Run at VM startup to initialize Context Switching (CS) threads, one per CPU */
+void initialize_cs_system(int requested_cpus) {
+  long host_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if(host_cpus < 1) {
+    host_cpus = 1;
+  }
+  num_cpus = (requested_cpus < 1) ? 1 : (requested_cpus > MAX_CPUS) ? MAX_CPUS : requested_cpus;
+
+  // Start the CS Threads parked at the Run Gate (cs_run starts as CS_STOP)
+  // The Shell commands open and close the gate with start_cs and stop_cs
+  pthread_condattr_init(&cs_cvattr);
+  pthread_condattr_setclock(&cs_cvattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&cs_cv, &cs_cvattr);
+
+  // Initialize each CPU's Scheduler System (this is designed as a part of CS) before any thread runs
+  for(int i = 0; i < num_cpus; i++) {
+    cpus[i].id = i;
+    cpus[i].host_cpu = i % host_cpus;
+    cpus[i].on_cpu = NULL;
+    cpus[i].suspend_pending = 0;
+    cpus[i].steals = 0;
+    cpus[i].carry_ns = 0;
+    memset(&cpus[i].jitter, 0, sizeof(cpus[i].jitter));
+    cpus[i].start_lat_ns = cpus[i].start_lat_max_ns = 0;
+    cpus[i].stop_lat_ns = cpus[i].stop_lat_max_ns = 0;
+    pthread_cond_init(&cpus[i].wake, &cs_cvattr);
+    cpus[i].idle = 0;
+    cpus[i].kicked = 0;
+    cpus[i].arrivals = cpus[i].arrival_total_ns = cpus[i].arrival_max_ns = 0;
+    cpus[i].last_stop_ns = 0;
+    cpus[i].busy_ns = 0;
+    cpus[i].gaps = cpus[i].gap_total_ns = cpus[i].gap_max_ns = 0;
+    cpus[i].elided = 0;
+    cpus[i].preempt_pid = 0;
+    cpus[i].preemptions = 0;
+    cpus[i].crit_arrivals = cpus[i].crit_total_ns = cpus[i].crit_max_ns = 0;
+    cpus[i].blocked_ends = cpus[i].reclaimed_ns = 0;
+    cpus[i].stops = cpus[i].stop_total_ns = cpus[i].stop_max_ns = 0;
+    cpus[i].stop_escalations = cpus[i].stop_failures = 0;
+    cpus[i].stopping_pid = 0;
+    pthread_mutex_init(&cpus[i].lock, NULL);
+    cpus[i].schedule = hake_create();
+    if(cpus[i].schedule == NULL) {
+      ABORT_ERROR("Error reported by hake_create.");
+    }
+
+    // Keep the Terminated Queue bounded, archiving older processes (settings in inc/vm_settings.h)
+    if(hake_set_retention(cpus[i].schedule, TERMINATED_KEEP, TERMINATED_LOG) == -1) {
+      PRINT_WARNING("Could not open %s, older Terminated Processes will be dropped", TERMINATED_LOG);
+    }
+  }
+
+  // Create the runner thread for each CPU of the CS system
+  for(int i = 0; i < num_cpus; i++) {
+    int ret = pthread_create(&cpus[i].thread, NULL, &cs_thread, &cpus[i]);
+    if(ret != 0) {
+      ABORT_ERROR("Could not create a Thread for the CS System.");
+    }
+  }
+
+  // And the thread that keeps the statistics file up to date
+  stats_epoch_ns = monotonic_ns();
+  if(STATS_FILE != NULL) {
+    if(pthread_create(&stats_thread, NULL, &cs_stats_thread, NULL) != 0) {
+      PRINT_WARNING("Could not create the Stats Thread, %s will not be written", STATS_FILE);
+    }
+    else {
+      stats_running = 1;
+    }
   }
 }
 
@@ -68,239 +810,461 @@ void initialize_cs_system() {
 void cs_cleanup() {
   PRINT_STATUS("... Beginning CS Shutdown");
 
-  PRINT_STATUS("... Deallocating Scheduler with hake_deallocate(schedule)");
-  hake_deallocate(schedule);
+  PRINT_STATUS("... Shutting Down CS System and Dispatchers");
+  sigset_t old_mask;
+  gate_lock(&old_mask);
+  cs_do_cs = CS_STOP; // Tell the threads to die.
+  gate_broadcast(); // Wake them wherever they are parked or sleeping, so they can die.
+  gate_unlock(&old_mask);
 
-  PRINT_STATUS("... Shutting Down CS System and Dispatcher");
-  cs_do_cs = CS_STOP; // Tell the thread to die.
-  pthread_mutex_unlock(&cs_cv_m); // If the CS is not running, activate it so it can die.
+  PRINT_STATUS("... Waiting for CS System and Dispatchers to Complete");
+  for(int i = 0; i < num_cpus; i++) {
+    pthread_join(cpus[i].thread, NULL);
+  }
+  if(stats_running) {
+    pthread_join(stats_thread, NULL);
+    stats_running = 0;
+  }
 
-  PRINT_STATUS("... Waiting for CS System and Dispatcher to Complete");
-  pthread_join(pt_cs, NULL);
+  PRINT_STATUS("... Removing Processes from CPUs");
+  for(int i = 0; i < num_cpus; i++) {
+    hake_free_process(cpus[i].on_cpu); // Nodes belong to the Hake node arena
+    cpus[i].on_cpu = NULL; // Nothing on CPU.
+  }
 
-  PRINT_STATUS("... Removing Process from CPU");
-  free(on_cpu);
-  on_cpu = NULL; // Nothing on CPU.
+  PRINT_STATUS("... Deallocating Schedulers with hake_deallocate(schedule)");
+  for(int i = 0; i < num_cpus; i++) {
+    hake_deallocate(cpus[i].schedule);
+    cpus[i].schedule = NULL;
+  }
 
   PRINT_STATUS("... CS Shutdown Complete");
 }
 
-/* Context Switching Thread Function */
+/* Context Switching Thread Function (one per CPU, args is its Cs_cpu_s) */
 void *cs_thread(void *args) {
+  Cs_cpu_s *cpu = (Cs_cpu_s *)args;
   int iteration = 1;
   pid_t last_run_cpu = -1;
+  sigset_t mask;
 
-// 1) While not blocked... (lock cs_cv_m to block)
-// .. a) Gets the next process to run from the Scheduler (select)
-// .. .. Holds this in the on_cpu global
+  // Dispatchers never take the asynchronous signals; those belong to the shell thread.
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigaddset(&mask, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+  is_dispatcher = 1;
+  cpu_pin(0, cpu->host_cpu);
+  // Wake up from quantum deadlines on time, rather than up to the default 50 usec timer slack late
+  prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+
+// 1) While the Run Gate is open... (stop_cs closes it, waking the dispatcher even mid-quantum)
+// .. a) Gets the next process to run from the local Scheduler (select), or steals one
+// .. .. Holds this in the CPU's on_cpu slot
 // .. b) Resumes the selected process
-// .. c) Sleeps for sleep_usec_time microseconds
-// .. d) Suspends the selected process
-// .. e) Returns the process to the Scheduler (insert)
+// .. c) Sleeps until its quantum (its own, adapted from sleep_usec_time) after it resumed (less the last
+//       overshoot), or until an arrival that outranks it preempts it
+// .. d) Suspends the selected process, measuring how long it really ran
+// .. e) Returns the process to the local Scheduler (insert)
+// .. f) Waits between_usec_time, unless dispatch is pipelined (no between delay, straight back to a)
   while(cs_do_cs == CS_RUN) {
-    long delay = sleep_usec_time;
-    pthread_mutex_lock(&cs_cv_m);  // mylock.acquire()  -- Turnstile Pattern
-    pthread_mutex_unlock(&cs_cv_m);// mylock.release()
-
-    // Check to see if the system is being shutdown while waiting on lock.
-    if(cs_do_cs == CS_STOP) {
-      continue; 
+    long long quantum_ns = sleep_usec_time * 1000LL;
+    long long mark_ns = 0; // When the quantum ended, the between delay runs from here
+    int preempted = 0;     // The quantum was cut short for an arrival, which is switched to at once
+    // Wait at the Run Gate, checking to see if the system is being shutdown while waiting.
+    if(!cs_gate_wait(cpu)) {
+      continue;
     }
 
-    PRINT_DEBUG("Context Switch: Iteration %d", iteration++);
+    PRINT_DEBUG("Context Switch: CPU %d Iteration %d", cpu->id, iteration++);
 
-    // Call the Scheduler to get the next Process
-    on_cpu = hake_select(schedule);
-    if(on_cpu) {
-      PRINT_DEBUG("Schedule Select Returned PID %d", on_cpu->pid);
+    // Call the Scheduler to get the next Process, stealing from a busier CPU when idle
+    pthread_mutex_lock(&cpu->lock);
+    cpu->on_cpu = hake_select(cpu->schedule);
+    int stolen = 0;
+    if(cpu->on_cpu == NULL && num_cpus > 1) {
+      cpu->on_cpu = cpu_steal(cpu);
+      stolen = 1;
+    }
+    if(cpu->on_cpu) {
+      trace_event(TRACE_SELECT, cpu->id, cpu->on_cpu->pid, stolen);
+      PRINT_DEBUG("Schedule Select Returned PID %d on CPU %d", cpu->on_cpu->pid, cpu->id);
+      quantum_ns = cpu_quantum_ns(cpu);
     }
     else {
-      PRINT_DEBUG("Schedule Select Returned No Ready Processes");
+      PRINT_DEBUG("Schedule Select Returned No Ready Processes on CPU %d", cpu->id);
     }
 
     // Only Dispatch if something was selected
-    if(on_cpu != NULL) {
-      if(process_find(on_cpu->pid) == 0) {
-        if(hake_exited(schedule, on_cpu, 42) == -1) {
-          ABORT_ERROR("Error reported by hake_exited.");
-        }
-        on_cpu = NULL;
+    if(cpu->on_cpu != NULL) {
+      if(process_find(cpu->on_cpu->pid) == 0) {
+        cpu_exit_on_cpu(cpu, 42);
         last_run_cpu = 0; // Nothing on the CPU for this iteration
+        pthread_mutex_unlock(&cpu->lock);
       }
       else {
-        if(last_run_cpu != on_cpu->pid) {
-          PRINT_STATUS("Switching to run PID: %d (%s)", on_cpu->pid, on_cpu->cmd);
+        pid_t pid = cpu->on_cpu->pid;
+#if PIN_CHILDREN > 0
+        cpu_pin(pid, cpu->host_cpu);
+#endif
+        kill(pid, SIGCONT);
+        trace_event(TRACE_SIGCONT, cpu->id, pid, 0);
+        long long start_ns = monotonic_ns();
+        if(cpu->last_stop_ns != 0) {
+          long long gap_ns = start_ns - cpu->last_stop_ns;
+          cpu->gaps++;
+          cpu->gap_total_ns += gap_ns;
+          if(gap_ns > cpu->gap_max_ns) {
+            cpu->gap_max_ns = gap_ns;
+          }
+          cpu->last_stop_ns = 0;
+        }
+        // Report the switch once the process is running, so printing isn't part of the switch gap
+        if(last_run_cpu != pid) {
+          PRINT_STATUS("CPU %d Switching to run PID: %d (%s)", cpu->id, pid, cpu->on_cpu->cmd);
         }
-        last_run_cpu = on_cpu->pid;
-        kill(on_cpu->pid, SIGCONT);
-        usleep(delay);
-        // It's run for the quantum, suspend it and return it to the queue.
-        if(on_cpu) {
-          kill(on_cpu->pid, SIGTSTP);
-          if(hake_insert(schedule, on_cpu) == -1) {
+        last_run_cpu = pid;
+        if(cpu->on_cpu->runs == 1) {
+          cpu_record_arrival(cpu, cpu->on_cpu);
+        }
+        // The carry is capped at half of the quantum it was taken from, which may be longer than this one
+        long long planned_ns = (cpu->carry_ns < quantum_ns / 2) ? quantum_ns - cpu->carry_ns : quantum_ns / 2;
+        int extended = 0;
+        do {
+          pthread_mutex_unlock(&cpu->lock);
+          int ended = cs_run_quantum(cpu, pid, start_ns + planned_ns);
+          int cut_short = (ended == 1 || ended == -1); // Preempted or the CS system was stopped
+          int blocked = (ended == 2);
+          // It's run for the quantum (or blocked, was preempted, or the CS system was stopped), return it to the queue (unless it exited).
+          pthread_mutex_lock(&cpu->lock);
+          extended = 0;
+          if(cpu->on_cpu == NULL) {
+            break;
+          }
+          // Charge it for the CPU it really used; a full slice also tells how CPU bound it is,
+          // which its next quantum follows (blocking leaves most of the quantum unused)
+          cpu_charge(cpu);
+          if(!cut_short) {
+            cpu_adapt_quantum(cpu, blocked ? quantum_ns : monotonic_ns() - start_ns);
+          }
+          if(hake_insert(cpu->schedule, cpu->on_cpu) == -1) {
             ABORT_ERROR("Error reported by hake_insert.");
           }
-          on_cpu = NULL;
+          trace_event(TRACE_INSERT, cpu->id, pid, cpu->on_cpu->priority);
+          // Elide the switch if it would win the select again: select it in place (aging the rest as usual)
+          // and extend its slice, with no signals and no gap.  A blocked process keeps the CPU this way
+          // too when nothing else is Ready, rather than being stopped only to be resumed again.
+          if(!cut_short && !cpu->suspend_pending && hake_ready_first(cpu->schedule) == cpu->on_cpu) {
+            if(hake_select(cpu->schedule) != cpu->on_cpu) {
+              ABORT_ERROR("Error reported by hake_select.");
+            }
+            // It keeps the CPU rather than starting a new run, so runs only counts real dispatches
+            cpu->on_cpu->runs--;
+            trace_event(TRACE_SELECT, cpu->id, pid, 2);
+            cs_continue_stopped(pid);
+            mark_ns = monotonic_ns();
+            cpu->busy_ns += mark_ns - start_ns;
+            if(!blocked) {
+              cpu_account_slice(cpu, quantum_ns, planned_ns, mark_ns - start_ns);
+              cpu->elided++;
+            }
+            quantum_ns = cpu_quantum_ns(cpu);
+            planned_ns = (cpu->carry_ns < quantum_ns / 2) ? quantum_ns - cpu->carry_ns : quantum_ns / 2;
+            start_ns = mark_ns;
+            extended = 1;
+            continue;
+          }
+          // Otherwise suspend it; it already competes in the Ready Queue
+          kill(cpu->on_cpu->pid, SIGTSTP);
+          trace_event(TRACE_SIGTSTP, cpu->id, pid, 0);
+          if(ended == 1) {
+            PRINT_DEBUG("CPU %d preempted PID %d for PID %d", cpu->id, pid, hake_ready_first(cpu->schedule)->pid);
+          }
+          // A suspend that arrived mid-quantum takes effect now that it is back in Ready
+          if(cpu->suspend_pending) {
+            if(hake_suspend(cpu->schedule, cpu->on_cpu->pid) == -1) {
+              ABORT_ERROR("Error reported by hake_suspend.");
+            }
+            trace_event(TRACE_SUSPEND, cpu->id, pid, 0);
+          }
+          // From here it is only queued, so the CPU can be unlocked while the stop is confirmed
+          cpu->on_cpu = NULL;
+          cpu->suspend_pending = 0;
+          cpu_confirm_stop(cpu, pid);
+          mark_ns = monotonic_ns();
+          cpu->busy_ns += mark_ns - start_ns;
+          cpu->last_stop_ns = mark_ns;
+          if(blocked) {
+            cpu->blocked_ends++;
+            cpu->reclaimed_ns += start_ns + planned_ns - mark_ns;
+            PRINT_DEBUG("CPU %d ended the slice of PID %d early, it blocked", cpu->id, pid);
+          }
+          else if(!cut_short) {
+            cpu_account_slice(cpu, quantum_ns, planned_ns, mark_ns - start_ns);
+          }
+          else if(ended == 1) {
+            cpu->preemptions++;
+            preempted = 1;
+          }
+        } while(extended);
+        int waiting = hake_get_count(cpu->schedule->ready_queue);
+        pthread_mutex_unlock(&cpu->lock);
+        // More Ready here than this CPU runs next, so an idle CPU could steal one
+        if(waiting > 1 && num_cpus > 1) {
+          cs_work_arrived(cpu, 0);
         }
       }
     }
     // Nothing selected, IDLE CPU
     else {
+      pthread_mutex_unlock(&cpu->lock);
       PRINT_DEBUG("Schedule Select Returned Nothing");
       if(last_run_cpu != 0) {
-        print_empty_cs();
+        print_empty_cs(cpu->id);
       }
       last_run_cpu = 0; // Nothing on the CPU for this iteration
-      usleep(delay);
+      cpu->last_stop_ns = 0; // Idle time is not part of a switch
+      // Park until a process arrives (no between delay, so it is dispatched right away)
+      trace_event(TRACE_IDLE, cpu->id, 0, 0);
+      cs_idle_wait(cpu);
+      trace_event(TRACE_WAKE, cpu->id, 0, 0);
+      continue;
     }
 
-    // Delay after the run quantum, but before we pick a new one (to help with debugging)
-    usleep(between_usec_time);
+    // Delay after the run quantum, but before we pick a new one (to help with debugging, unless pipelined or preempted)
+    if(!preempted && !__atomic_load_n(&dispatch_pipelined, __ATOMIC_RELAXED)) {
+      if(mark_ns == 0) {
+        mark_ns = monotonic_ns();
+      }
+      cs_sleep_until(cpu, 0, mark_ns + between_usec_time * 1000LL);
+    }
   }
   // CS System has ended the main loop, we can now properly exit the thread.
   pthread_exit(0);
 }
 
-/* Direct the Scheduler to suspend a process from execution */
+/* Direct the Scheduler to suspend a process from execution
+ * - A pid of 0 suspends the lowest Ready PID on the first CPU that has one.
+ * - A process that is on a CPU right now is suspended when its quantum ends.
+ */
 void cs_suspend(pid_t pid) {
-  int last_state = -1;
-
-  // There IS a race condition here, but it's a pretty minor one.  
-  // If it WAS running when we shut it off, restart it when we finish.
-  // It's possible they shut it off manually in the microseconds between these,
-  // but it's not exactly the end of the world if they had.
-  pthread_mutex_lock(&cs_run_m);
-  last_state = cs_run;
-  pthread_mutex_unlock(&cs_run_m);
-
-  stop_cs(); // Critical!  This ensures that all processes have been returned to Scheduler first
+  Cs_cpu_s *cpu = NULL;
+  sigset_t old_mask;
 
   PRINT_DEBUG("Suspending Process Now");
-  if(hake_suspend(schedule, pid) == -1) {
+  record_event(RECORD_SUSPEND, pid, 0, 0, 0, 0, NULL);
+  if(pid == 0) {
+    for(int i = 0; i < num_cpus; i++) {
+      cpu_lock(&cpus[i], &old_mask);
+      if(hake_suspend(cpus[i].schedule, 0) == 0) {
+        trace_event(TRACE_SUSPEND, cpus[i].id, 0, 0); // The default process, whichever PID that was
+        cpu_unlock(&cpus[i], &old_mask);
+        return;
+      }
+      cpu_unlock(&cpus[i], &old_mask);
+    }
+    // Nothing Ready anywhere, so fall back to the first process on a CPU
+    for(int i = 0; i < num_cpus; i++) {
+      cpu_lock(&cpus[i], &old_mask);
+      if(cpus[i].on_cpu && !cpus[i].suspend_pending) {
+        cpus[i].suspend_pending = 1;
+        cpu_unlock(&cpus[i], &old_mask);
+        return;
+      }
+      cpu_unlock(&cpus[i], &old_mask);
+    }
     ABORT_ERROR("Error reported by hake_suspend.");
   }
-  if(last_state == CS_RUN) {
-    start_cs();
-  }
-}
-
-/* Direct the Scheduler to resume a process from execution */
-void cs_resume(pid_t pid) {
-  int last_state = -1; // This is an invalid state that will be overwritten
-
-  // There IS a race condition here, but it's a pretty minor one.  
-  // If it WAS running when we shut it off, restart it when we finish.
-  // It's possible they shut it off manually in the microseconds between these,
-  // but it's not exactly the end of the world if they had.
-  pthread_mutex_lock(&cs_run_m);
-  last_state = cs_run;
-  pthread_mutex_unlock(&cs_run_m);
-
-  stop_cs(); // Critical!  This ensures that all processes have been returned to Scheduler first
 
-  PRINT_DEBUG("Resuming Process Now");
-  if(hake_resume(schedule, pid) == -1) {
-    ABORT_ERROR("Error reported by hake_resume.");
+  cpu = cpu_lock_owner(pid, &old_mask);
+  if(cpu == NULL) {
+    ABORT_ERROR("Error reported by hake_suspend.");
   }
-  if(last_state == CS_RUN) {
-    start_cs();
+  if(cpu->on_cpu && cpu->on_cpu->pid == pid) {
+    cpu->suspend_pending = 1;
   }
+  else if(hake_suspend(cpu->schedule, pid) == -1) {
+    ABORT_ERROR("Error reported by hake_suspend.");
+  }
+  else {
+    trace_event(TRACE_SUSPEND, cpu->id, pid, 0);
+  }
+  cpu_unlock(cpu, &old_mask);
 }
 
-/* Return the process that was on the CPU back to the Scheduler during Termination
- * -  If process was NOT on CPU during termination, then it is handled in another function.
+/* Direct the Scheduler to resume a process from execution
+ * - A pid of 0 resumes the default process on the first CPU that has one.
+ * - Resuming a process whose suspend is still pending on a CPU just cancels the suspend.
  */
-void cs_exiting_process(int exit_code) {
-  // If a process *was* on the CPU, run the exit handler.
-  if(on_cpu) {
-    if(hake_exited(schedule, on_cpu, exit_code) == -1) {
-      ABORT_ERROR("Error reported by hake_exited.");
+void cs_resume(pid_t pid) {
+  int ret = -1;
+
+  PRINT_DEBUG("Resuming Process Now");
+  record_event(RECORD_RESUME, pid, 0, 0, 0, 0, NULL);
+  for(int i = 0; i < num_cpus && ret == -1; i++) {
+    sigset_t old_mask;
+    cpu_lock(&cpus[i], &old_mask);
+    if(pid != 0 && cpus[i].on_cpu && cpus[i].on_cpu->pid == pid && cpus[i].suspend_pending) {
+      cpus[i].suspend_pending = 0;
+      ret = 0;
+    }
+    else if((ret = hake_resume(cpus[i].schedule, pid)) == 0) {
+      trace_event(TRACE_RESUME, cpus[i].id, pid, 0);
+      pid_t outranked = cpu_outranked(&cpus[i]);
+      cpu_unlock(&cpus[i], &old_mask);
+      cs_work_arrived(&cpus[i], outranked); // Back in Ready, wake the CPU if it went idle (or preempt)
+      return;
     }
-    PRINT_DEBUG("Exiting PID %d, with exit code %d with hake_exited\n", on_cpu->pid, exit_code);
-    on_cpu = NULL;
+    cpu_unlock(&cpus[i], &old_mask);
   }
-  else {
-    PRINT_WARNING("Tried to exit a non-existing process on the CPU");
+  if(ret == -1) {
+    ABORT_ERROR("Error reported by hake_resume.");
   }
 }
 
-/* Add a newly created process to the schedule system */
+/* Add a newly created process to the schedule system (on the least loaded CPU)
+ * - A process with a deadline goes to the first CPU (least loaded first) whose EDF capacity admits it.
+ *   If none does, it is rejected: tracked just long enough to be killed and reported Terminated.
+ */
 void cs_hake_process(Process_data_s *proc) {
+  Cs_cpu_s *cpu = cpu_least_loaded();
+  sigset_t old_mask;
+  int rejected = 0;
+
   // Create the new Process with the given parameters (from the Shell)
   Hake_process_s *proc_node = hake_new_process(proc->input_orig, proc->pid, proc->priority_level, proc->is_critical);
   if(proc_node == NULL) {
     ABORT_ERROR("Error reported by hake_new_process.");
   }
+  record_event(RECORD_START, proc->pid, proc->priority_level, proc->is_critical, 0, 0, proc->input_orig);
+
+  // Admission control for deadline processes
+  if(proc->deadline_ns > 0) {
+    long long runtime_ns = (proc->runtime_ns > 0) ? proc->runtime_ns : get_run_usec() * 1000LL;
+    int admitted = 0;
+    for(int i = 0; i < num_cpus && !admitted; i++) {
+      Cs_cpu_s *candidate = &cpus[(cpu->id + i) % num_cpus];
+      cpu_lock(candidate, &old_mask);
+      admitted = (hake_admit(candidate->schedule, proc_node, proc->deadline_ns, runtime_ns) == 0);
+      cpu_unlock(candidate, &old_mask);
+      if(admitted) {
+        cpu = candidate;
+      }
+    }
+    if(!admitted) {
+      PRINT_WARNING("Rejected PID %d: %lld usec every %lld usec would exceed the EDF capacity of every CPU",
+          proc->pid, runtime_ns / 1000, proc->deadline_ns / 1000);
+      rejected = 1;
+    }
+  }
+
+  // A rejected process is killed first and goes straight to the Terminated Queue, so it is never
+  //   Ready (it can't preempt or be continued); its SIGCHLD only reaps it (see cs_hake_terminated)
+  if(rejected) {
+    kill(proc->pid, SIGKILL);
+    cpu_lock(cpu, &old_mask);
+    if(hake_insert(cpu->schedule, proc_node) == -1) {
+      ABORT_ERROR("Error reported by hake_insert.");
+    }
+    if(hake_terminated(cpu->schedule, proc->pid, 0) == -1) {
+      ABORT_ERROR("Error reported by hake_terminated.");
+    }
+    trace_event(TRACE_TERMINATE, cpu->id, proc->pid, 0);
+    cpu_unlock(cpu, &old_mask);
+    return;
+  }
+
   // Then Insert it into the Queue
-  if(hake_insert(schedule, proc_node) == -1) {
+  cpu_lock(cpu, &old_mask);
+  if(hake_insert(cpu->schedule, proc_node) == -1) {
     ABORT_ERROR("Error reported by hake_insert.");
   }
+  trace_event(TRACE_INSERT, cpu->id, proc_node->pid, proc_node->priority);
   // Finally, print the schedule out (Debug Mode Only) to see it there.
-  print_hake_debug(schedule, get_on_cpu());
+  print_hake_debug(cpu->schedule, cpu->on_cpu);
+  pid_t outranked = cpu_outranked(cpu);
+  cpu_unlock(cpu, &old_mask);
+  // Wake an idle CPU for it, or take this CPU at once if it outranks the process running there
+  cs_work_arrived(cpu, outranked);
 }
 
-/* Directs Scheduler that a process had terminated with the given exit code. */
+/* Directs Scheduler that a process had terminated with the given exit code.
+ * - Finding the owning CPU and removing the process happen under one lock, so this is safe
+ *   while the dispatchers keep running.
+ */
 void cs_hake_terminated(pid_t pid, int exit_code) {
-  int last_state = -1; // Illegal state that will be set in this function
-
-  // There IS a race condition here, but it's a pretty minor one.  
-  // If it WAS running when we shut it off, restart it when we finish.
-  // It's possible they shut it off manually in the microseconds between these,
-  // but it's not exactly the end of the world if they had.
-  pthread_mutex_lock(&cs_run_m);
-  last_state = cs_run;
-  pthread_mutex_unlock(&cs_run_m);
+  sigset_t old_mask;
+  Cs_cpu_s *cpu = cpu_lock_owner(pid, &old_mask);
 
-  stop_cs(); // Critical! This ensures the state is consistent first.
+  if(cpu == NULL) {
+    ABORT_ERROR("Error reported by hake_terminated.");
+  }
+  // Record what it used, for replays (the CPU time charged so far, since it's already been reaped)
+  Hake_process_s *node = (cpu->on_cpu && cpu->on_cpu->pid == pid) ? cpu->on_cpu : hake_find(cpu->schedule, pid);
+  if(node != NULL) {
+    record_event(RECORD_EXIT, pid, exit_code, node->runs, node->cpu_ns, hake_get_wait(node), NULL);
+  }
+  // A rejected deadline process is already Terminated (see cs_hake_process), so this only reaps it
+  if(node != NULL && (node->state & HAKE_STATE_TERMINATED)) {
+    cpu_unlock(cpu, &old_mask);
+    return;
+  }
 
   // Check if the terminted process is on the cpu.  If so, treat it as an exiting process.
-  if(on_cpu && on_cpu->pid == pid) {
+  if(cpu->on_cpu && cpu->on_cpu->pid == pid) {
     // Exit from the CPU directly (terminated while being run)
-    cs_exiting_process(exit_code);
+    cpu_exit_on_cpu(cpu, exit_code);
   }
   // Otherwise, it was terminated while in a Queue; treat as a terminated process.
   else {
     // Exit from the Ready or Suspended Queues (terminated by command)
-    if(hake_terminated(schedule, pid, exit_code) == -1) {
+    if(hake_terminated(cpu->schedule, pid, exit_code) == -1) {
       ABORT_ERROR("Error reported by hake_terminated.");
     }
-
+    trace_event(TRACE_TERMINATE, cpu->id, pid, exit_code);
     PRINT_DEBUG("Terminating PID %d with exit code %d with hake_terminated\n", pid, exit_code);
   }
+  cpu_unlock(cpu, &old_mask);
+}
 
-  // Finally, if the CS system had been running before this interruption, resume it.
-  if(last_state == CS_RUN) {
-    start_cs();
-  }
-} 
-
-/* Starts the CS Processing System */
+/* Starts the CS Processing System (opens the Run Gate, waking every dispatcher) */
 void start_cs() {
-  pthread_mutex_lock(&cs_run_m);
+  sigset_t old_mask;
+  gate_lock(&old_mask);
   if(cs_run == CS_STOP) {
     cs_run = CS_RUN;
-    pthread_mutex_unlock(&cs_cv_m);
+    __atomic_store_n(&cs_changed_ns, monotonic_ns(), __ATOMIC_RELEASE);
+    gate_broadcast();
+    record_event(RECORD_CS_START, 0, 0, 0, 0, 0, NULL);
   }
-  pthread_mutex_unlock(&cs_run_m);
+  gate_unlock(&old_mask);
 }
 
-/* Stops the CS Processing System */
+/* Stops the CS Processing System (closes the Run Gate, cutting any running quantum short) */
 void stop_cs() {
-  pthread_mutex_lock(&cs_run_m);
+  sigset_t old_mask;
+  gate_lock(&old_mask);
   if(cs_run == CS_RUN) {
     cs_run = CS_STOP;
-    pthread_mutex_lock(&cs_cv_m);
+    __atomic_store_n(&cs_changed_ns, monotonic_ns(), __ATOMIC_RELEASE);
+    gate_broadcast();
+    record_event(RECORD_CS_STOP, 0, 0, 0, 0, 0, NULL);
   }
-  pthread_mutex_unlock(&cs_run_m);
+  gate_unlock(&old_mask);
+}
+
+/* Returns whether the Run Gate is open (CS_RUN) or closed (CS_STOP). */
+static int cs_state() {
+  sigset_t old_mask;
+  gate_lock(&old_mask);
+  int state = cs_run;
+  gate_unlock(&old_mask);
+  return state;
 }
 
 /* Helper to print messages on USER toggling of the CS system */
 void handle_ctrlc() {
-  pthread_mutex_lock(&cs_run_m);
-  int is_running = cs_run;
-  pthread_mutex_unlock(&cs_run_m);
-
-  if(is_running == CS_RUN) {
+  if(cs_state() == CS_RUN) {
     print_stop_cs();
   }
   else {
@@ -313,11 +1277,7 @@ void handle_ctrlc() {
 
 /* Toggles the CS Processing System */
 void toggle_cs() {
-  pthread_mutex_lock(&cs_run_m);
-  int is_running = cs_run;
-  pthread_mutex_unlock(&cs_run_m);
-
-  if(is_running == CS_RUN) { // Run -> Stop
+  if(cs_state() == CS_RUN) { // Run -> Stop
     stop_cs();
   }
   else {  // Stop -> Run
@@ -327,7 +1287,14 @@ void toggle_cs() {
 
 /* Helper to print status when a USER starts the CS system. */
 void print_start_cs() {
-  PRINT_STATUS("Starting CS System: %d usec Run, %d usec Between", sleep_usec_time, between_usec_time);
+  if(dispatch_pipelined) {
+    PRINT_STATUS("Starting CS System: %d usec Run, Pipelined (no Between), %d CPU%s", sleep_usec_time,
+        num_cpus, num_cpus==1?"":"s");
+  }
+  else {
+    PRINT_STATUS("Starting CS System: %d usec Run, %d usec Between, %d CPU%s", sleep_usec_time, between_usec_time,
+        num_cpus, num_cpus==1?"":"s");
+  }
 }
 
 /* Helper to print status when a USER stops the CS system. */
@@ -336,16 +1303,24 @@ void print_stop_cs() {
 }
 
 /* Helper to print status when select returns NULL */
-void print_empty_cs() {
-  PRINT_STATUS("No Processes Ready to Run");
+void print_empty_cs(int cpu) {
+  PRINT_STATUS("No Processes Ready to Run on CPU %d", cpu);
 }
 
+/* Prints every CPU's slot and local schedule */
+void print_cs_schedule() {
+  for(int i = 0; i < num_cpus; i++) {
+    sigset_t old_mask;
+    PRINT_STATUS("=== CPU %d (host core %d) ===", cpus[i].id, cpus[i].host_cpu);
+    cpu_lock(&cpus[i], &old_mask);
+    print_schedule(cpus[i].schedule, cpus[i].on_cpu);
+    cpu_unlock(&cpus[i], &old_mask);
+  }
+}
 
 /* Prints the state of the CS System */
 void print_cs_status() {
-  pthread_mutex_lock(&cs_run_m);
-  int state = cs_run;
-  pthread_mutex_unlock(&cs_run_m);
+  int state = cs_state();
 
   if(state == CS_RUN) {
     PRINT_STATUS("CS System Running: runtime %d usec, delaytime %d usec", sleep_usec_time, between_usec_time);
@@ -353,9 +1328,428 @@ void print_cs_status() {
   else {
     PRINT_STATUS("CS System Stopped: runtime %d usec, delaytime %d usec", sleep_usec_time, between_usec_time);
   }
+  PRINT_STATUS("...Scheduling Policy: %s", cpus[0].schedule->policy->name);
+  PRINT_STATUS("...Dispatch: %s", dispatch_pipelined ? "pipelined (no between delay, delaytime unused)" : "delayed (delaytime after every quantum)");
+#if ADAPTIVE_QUANTUM > 0
+  PRINT_STATUS("...Quantum: adaptive per process (starts at runtime, %d to %d usec)", SLEEP_MIN_USEC, SLEEP_MAX_USEC);
+#else
+  PRINT_STATUS("...Quantum: runtime for every process");
+#endif
+  if(get_block_poll_usec() > 0) {
+    PRINT_STATUS("...Block Polling: every %d usec (slices end early when the process blocks)", get_block_poll_usec());
+  }
+  else {
+    PRINT_STATUS("...Block Polling: off (slices run their full quantum)");
+  }
+
+  // One line per CPU slot, plus its EDF load when it has deadline processes
+  for(int i = 0; i < num_cpus; i++) {
+    sigset_t old_mask;
+    cpu_lock(&cpus[i], &old_mask);
+    if(cpus[i].schedule->edf_util_ppm > 0 || cpus[i].schedule->edf_misses > 0) {
+      PRINT_STATUS("...CPU %d EDF: %d.%d%% reserved, %d deadline miss%s", cpus[i].id,
+          cpus[i].schedule->edf_util_ppm / 10000, (cpus[i].schedule->edf_util_ppm / 1000) % 10,
+          cpus[i].schedule->edf_misses, cpus[i].schedule->edf_misses==1?"":"es");
+    }
+    if(cpus[i].on_cpu) {
+      PRINT_STATUS("...CPU %d (host core %d): PID %d (%s), %d Ready, %d stolen", cpus[i].id, cpus[i].host_cpu,
+          cpus[i].on_cpu->pid, cpus[i].on_cpu->cmd, hake_get_count(cpus[i].schedule->ready_queue), cpus[i].steals);
+    }
+    else {
+      PRINT_STATUS("...CPU %d (host core %d): Idle, %d Ready, %d stolen", cpus[i].id, cpus[i].host_cpu,
+          hake_get_count(cpus[i].schedule->ready_queue), cpus[i].steals);
+    }
+    print_cpu_jitter(&cpus[i]);
+    if(cpus[i].arrivals > 0) {
+      PRINT_STATUS("...CPU %d Arrival to First Run: %lld process%s, mean %lld usec, max %lld usec", cpus[i].id,
+          cpus[i].arrivals, cpus[i].arrivals==1?"":"es", cpus[i].arrival_total_ns / cpus[i].arrivals / 1000,
+          cpus[i].arrival_max_ns / 1000);
+    }
+    if(cpus[i].crit_arrivals > 0 || cpus[i].preemptions > 0) {
+      PRINT_STATUS("...CPU %d Critical Arrival to Dispatch: %lld process%s, mean %lld usec, max %lld usec, %lld preemption%s",
+          cpus[i].id, cpus[i].crit_arrivals, cpus[i].crit_arrivals==1?"":"es",
+          cpus[i].crit_arrivals ? cpus[i].crit_total_ns / cpus[i].crit_arrivals / 1000 : 0, cpus[i].crit_max_ns / 1000,
+          cpus[i].preemptions, cpus[i].preemptions==1?"":"s");
+    }
+    if(cpus[i].stops > 0 || cpus[i].stop_failures > 0) {
+      PRINT_STATUS("...CPU %d Stops: %lld confirmed, mean %lld usec, max %lld usec, %lld escalated to SIGSTOP, %lld failed",
+          cpus[i].id, cpus[i].stops, cpus[i].stops ? cpus[i].stop_total_ns / cpus[i].stops / 1000 : 0,
+          cpus[i].stop_max_ns / 1000, cpus[i].stop_escalations, cpus[i].stop_failures);
+    }
+    if(cpus[i].blocked_ends > 0) {
+      PRINT_STATUS("...CPU %d Blocked Early: %lld slice%s ended when the process blocked, %lld.%03lld sec reclaimed",
+          cpus[i].id, cpus[i].blocked_ends, cpus[i].blocked_ends==1?"":"s",
+          cpus[i].reclaimed_ns / 1000000000LL, cpus[i].reclaimed_ns / 1000000LL % 1000);
+    }
+    if(cpus[i].gaps > 0 || cpus[i].elided > 0) {
+      PRINT_STATUS("...CPU %d Switching: busy %lld.%lld%% of the time, switch gap mean %lld usec, max %lld usec, %lld elided",
+          cpus[i].id, cpus[i].busy_ns * 100 / (cpus[i].busy_ns + cpus[i].gap_total_ns),
+          cpus[i].busy_ns * 1000 / (cpus[i].busy_ns + cpus[i].gap_total_ns) % 10,
+          cpus[i].gaps ? cpus[i].gap_total_ns / cpus[i].gaps / 1000 : 0, cpus[i].gap_max_ns / 1000, cpus[i].elided);
+    }
+    if(cpus[i].start_lat_max_ns > 0 || cpus[i].stop_lat_max_ns > 0) {
+      PRINT_STATUS("...CPU %d Gate Latency: start %lld usec (max %lld), stop %lld usec (max %lld)", cpus[i].id,
+          cpus[i].start_lat_ns / 1000, cpus[i].start_lat_max_ns / 1000,
+          cpus[i].stop_lat_ns / 1000, cpus[i].stop_lat_max_ns / 1000);
+    }
+    cpu_unlock(&cpus[i], &old_mask);
+  }
   return;
 }
 
+/* Prints a CPU's quantum error summary and its non-empty histogram buckets (called with the CPU locked). */
+static void print_cpu_jitter(Cs_cpu_s *cpu) {
+  Cs_jitter_s *jitter = &cpu->jitter;
+  char line[MAX_STATUS] = "";
+  int used = 0;
+
+  if(jitter->slices == 0) {
+    return;
+  }
+  PRINT_STATUS("...CPU %d Quantum Error: %lld slices (%lld early), mean %lld usec, max %lld usec, carry %lld usec",
+      cpu->id, jitter->slices, jitter->early, jitter->total_abs_ns / jitter->slices / 1000,
+      jitter->max_abs_ns / 1000, cpu->carry_ns / 1000);
+  for(int b = 0; b < JITTER_BUCKETS && used < (int)sizeof(line); b++) {
+    if(jitter->buckets[b] == 0) {
+      continue;
+    }
+    if(b == 0) {
+      used += snprintf(line + used, sizeof(line) - used, " <1:%lld", jitter->buckets[b]);
+    }
+    else if(b == JITTER_BUCKETS - 1) {
+      used += snprintf(line + used, sizeof(line) - used, " >=%lld:%lld", 1LL << (b - 1), jitter->buckets[b]);
+    }
+    else {
+      used += snprintf(line + used, sizeof(line) - used, " %lld-%lld:%lld", 1LL << (b - 1), 1LL << b, jitter->buckets[b]);
+    }
+  }
+  PRINT_STATUS("...CPU %d |Error| usec:%s", cpu->id, line);
+}
+
+/* Copies one process into the stats samples (called with its CPU locked).
+ * - A running process is charged its current slice so far, and a Ready one its current wait.
+ */
+static void stats_add(Cs_stats_s *stats, Hake_process_s *process, char state, long long now_wall_ns) {
+  Cs_sample_s *sample = NULL;
+
+  if(stats->count == stats->capacity) {
+    int capacity = stats->capacity ? stats->capacity * 2 : 64;
+    Cs_sample_s *grown = realloc(stats->samples, capacity * sizeof(Cs_sample_s));
+    if(grown == NULL) {
+      return; // Stats are best effort; this process is left out
+    }
+    stats->samples = grown;
+    stats->capacity = capacity;
+  }
+  sample = &stats->samples[stats->count++];
+  sample->pid = process->pid;
+  snprintf(sample->cmd, sizeof(sample->cmd), "%s", process->cmd ? process->cmd : "");
+  sample->state = state;
+  sample->runs = process->runs;
+  sample->cpu_ns = process->cpu_ns;
+  sample->run_ns = process->run_ns;
+  if(state == 'U' && process->run_start_ns > 0) {
+    sample->run_ns += monotonic_ns() - process->run_start_ns;
+  }
+  sample->wait_ns = hake_get_wait(process);
+  sample->response_ns = process->first_run_ns > 0 ? process->first_run_ns - process->start_ns : -1;
+  sample->turnaround_ns = (state == 'T' && process->end_ns > 0) ? process->end_ns - process->start_ns : -1;
+  sample->lifetime_ns = ((state == 'T' && process->end_ns > 0) ? process->end_ns : now_wall_ns) - process->start_ns;
+  stats->states[state == 'R' ? 0 : state == 'U' ? 1 : state == 'S' ? 2 : 3]++;
+}
+
+/* Orders long longs ascending for qsort. */
+static int stats_compare(const void *a, const void *b) {
+  long long x = *(const long long *)a;
+  long long y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+/* Sorts n values in place and sets out to their nearest-rank p50, p95, and p99 (all 0 if n is 0). */
+static void stats_percentiles(long long *values, int n, long long out[3]) {
+  const int pct[3] = {50, 95, 99};
+
+  if(n == 0) {
+    out[0] = out[1] = out[2] = 0;
+    return;
+  }
+  qsort(values, n, sizeof(long long), stats_compare);
+  for(int i = 0; i < 3; i++) {
+    int rank = (pct[i] * n + 99) / 100; // ceil(p * n / 100), 1-based
+    out[i] = values[(rank < 1 ? 1 : rank) - 1];
+  }
+}
+
+/* Samples every process on every CPU and works out the aggregate statistics.
+ * - The caller frees stats->samples.
+ * Returns 0 on success, or -1 if the samples could not be sorted (out of memory).
+ */
+static int stats_collect(Cs_stats_s *stats) {
+  struct timespec now;
+  long long now_wall_ns = 0;
+  long long *values = NULL;
+  double sum = 0.0;
+  double sum_sq = 0.0;
+  int shares = 0;
+  int n = 0;
+
+  memset(stats, 0, sizeof(*stats));
+  clock_gettime(CLOCK_REALTIME, &now); // start_ns and end_ns are wall clock time
+  now_wall_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+  for(int i = 0; i < num_cpus; i++) {
+    sigset_t old_mask;
+    Hake_schedule_s *schedule = cpus[i].schedule;
+    cpu_lock(&cpus[i], &old_mask);
+    if(cpus[i].on_cpu != NULL) {
+      stats_add(stats, cpus[i].on_cpu, 'U', now_wall_ns);
+    }
+    for(Hake_process_s *walker = hake_ready_first(schedule); walker; walker = hake_ready_next(schedule, walker)) {
+      stats_add(stats, walker, 'R', now_wall_ns);
+    }
+    for(Hake_process_s *walker = schedule->suspended_queue->head; walker; walker = walker->next) {
+      stats_add(stats, walker, 'S', now_wall_ns);
+    }
+    for(Hake_process_s *walker = schedule->terminated_queue->head; walker; walker = walker->next) {
+      stats_add(stats, walker, 'T', now_wall_ns);
+    }
+    stats->completed += schedule->terminated_queue->count; // Counts archived processes too
+    cpu_unlock(&cpus[i], &old_mask);
+  }
+
+  // Throughput is over the whole run, so it also covers processes archived out of memory
+  stats->elapsed_ns = monotonic_ns() - stats_epoch_ns;
+  if(stats->elapsed_ns > 0) {
+    stats->throughput = stats->completed * 60e9 / stats->elapsed_ns;
+  }
+
+  // Jain's fairness index of the CPU share each process got over its lifetime: 1 is perfectly fair
+  for(int i = 0; i < stats->count; i++) {
+    Cs_sample_s *sample = &stats->samples[i];
+    double share = 0.0;
+    if(sample->lifetime_ns <= 0) {
+      continue;
+    }
+    share = (double)(sample->cpu_ns > 0 ? sample->cpu_ns : sample->run_ns) / sample->lifetime_ns;
+    sum += share;
+    sum_sq += share * share;
+    shares++;
+  }
+  stats->fairness = sum_sq > 0.0 ? sum * sum / (shares * sum_sq) : 1.0;
+
+  if(stats->count == 0) {
+    return 0;
+  }
+  values = malloc(stats->count * sizeof(long long));
+  if(values == NULL) {
+    return -1;
+  }
+  for(int i = 0; i < stats->count; i++) {
+    values[i] = stats->samples[i].wait_ns;
+  }
+  stats_percentiles(values, stats->count, stats->wait);
+  n = 0;
+  for(int i = 0; i < stats->count; i++) {
+    if(stats->samples[i].response_ns >= 0) {
+      values[n++] = stats->samples[i].response_ns;
+    }
+  }
+  stats_percentiles(values, n, stats->response);
+  stats->responses = n;
+  n = 0;
+  for(int i = 0; i < stats->count; i++) {
+    if(stats->samples[i].turnaround_ns >= 0) {
+      values[n++] = stats->samples[i].turnaround_ns;
+    }
+  }
+  stats_percentiles(values, n, stats->turnaround);
+  stats->turnarounds = n;
+  free(values);
+  return 0;
+}
+
+/* Prints per-process CPU, wait, and turnaround accounting, then the aggregate statistics */
+void print_cs_stats() {
+  Cs_stats_s stats;
+
+  if(stats_collect(&stats) == -1) {
+    PRINT_WARNING("Out of memory while collecting the statistics");
+    free(stats.samples);
+    return;
+  }
+  PRINT_STATUS("%7s %-16s %2s %6s %10s %10s %10s %10s %12s", "PID", "Command", "St", "Runs",
+      "CPU ms", "Run ms", "Wait ms", "Resp ms", "Turnaround");
+  for(int i = 0; i < stats.count; i++) {
+    Cs_sample_s *sample = &stats.samples[i];
+    char turnaround[24] = "-";
+    if(sample->turnaround_ns >= 0) {
+      snprintf(turnaround, sizeof(turnaround), "%lld", sample->turnaround_ns / 1000000);
+    }
+    PRINT_STATUS("%7d %-16.16s %2c %6d %10lld %10lld %10lld %10lld %12s", sample->pid, sample->cmd, sample->state,
+        sample->runs, sample->cpu_ns / 1000000, sample->run_ns / 1000000, sample->wait_ns / 1000000,
+        sample->response_ns >= 0 ? sample->response_ns / 1000000 : -1, turnaround);
+  }
+  PRINT_STATUS("...Processes: %d Ready, %d Running, %d Suspended, %d Terminated in memory (%lld completed in all)",
+      stats.states[0], stats.states[1], stats.states[2], stats.states[3], stats.completed);
+  PRINT_STATUS("...Throughput: %.2f completed per minute over %lld sec", stats.throughput, stats.elapsed_ns / 1000000000LL);
+  PRINT_STATUS("...Wait: p50 %lld ms, p95 %lld ms, p99 %lld ms", stats.wait[0] / 1000000,
+      stats.wait[1] / 1000000, stats.wait[2] / 1000000);
+  PRINT_STATUS("...Response (%d run): p50 %lld ms, p95 %lld ms, p99 %lld ms", stats.responses,
+      stats.response[0] / 1000000, stats.response[1] / 1000000, stats.response[2] / 1000000);
+  PRINT_STATUS("...Turnaround (%d terminated): p50 %lld ms, p95 %lld ms, p99 %lld ms", stats.turnarounds,
+      stats.turnaround[0] / 1000000, stats.turnaround[1] / 1000000, stats.turnaround[2] / 1000000);
+  PRINT_STATUS("...Fairness: Jain's index %.3f of CPU share over %d process%s (1.000 is perfectly fair)",
+      stats.fairness, stats.count, stats.count==1?"":"es");
+  if(STATS_FILE != NULL) {
+    PRINT_STATUS("...Written to %s every %d usec", STATS_FILE, STATS_INTERVAL_USEC);
+  }
+  free(stats.samples);
+}
+
+/* Writes the statistics to path in the Prometheus text exposition format.
+ * - Written to a temporary file and renamed over path, so a scraper never reads half a file.
+ * Returns 0 on success or a -1 on any error.
+ */
+static int stats_write(const char *path) {
+  const char *quantiles[3] = {"0.5", "0.95", "0.99"};
+  char tmp_path[MAX_PATH + 8];
+  Cs_stats_s stats;
+  FILE *file = NULL;
+
+  if(stats_collect(&stats) == -1) {
+    free(stats.samples);
+    return -1;
+  }
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  file = fopen(tmp_path, "w");
+  if(file == NULL) {
+    free(stats.samples);
+    return -1;
+  }
+
+  fprintf(file, "# HELP trilby_completed_total Processes terminated since startup.\n");
+  fprintf(file, "# TYPE trilby_completed_total counter\ntrilby_completed_total %lld\n", stats.completed);
+  fprintf(file, "# HELP trilby_throughput_per_minute Processes completed per minute since startup.\n");
+  fprintf(file, "# TYPE trilby_throughput_per_minute gauge\ntrilby_throughput_per_minute %.6f\n", stats.throughput);
+  fprintf(file, "# HELP trilby_fairness_jain Jain's fairness index of the CPU share of every process.\n");
+  fprintf(file, "# TYPE trilby_fairness_jain gauge\ntrilby_fairness_jain %.6f\n", stats.fairness);
+  fprintf(file, "# HELP trilby_processes Processes in memory by state.\n# TYPE trilby_processes gauge\n");
+  fprintf(file, "trilby_processes{state=\"ready\"} %d\ntrilby_processes{state=\"running\"} %d\n", stats.states[0], stats.states[1]);
+  fprintf(file, "trilby_processes{state=\"suspended\"} %d\ntrilby_processes{state=\"terminated\"} %d\n", stats.states[2], stats.states[3]);
+  fprintf(file, "# HELP trilby_wait_seconds Time processes spent Ready.\n# TYPE trilby_wait_seconds summary\n");
+  for(int q = 0; q < 3; q++) {
+    fprintf(file, "trilby_wait_seconds{quantile=\"%s\"} %.9f\n", quantiles[q], stats.wait[q] / 1e9);
+  }
+  fprintf(file, "# HELP trilby_response_seconds Time from arrival to first run.\n# TYPE trilby_response_seconds summary\n");
+  for(int q = 0; q < 3; q++) {
+    fprintf(file, "trilby_response_seconds{quantile=\"%s\"} %.9f\n", quantiles[q], stats.response[q] / 1e9);
+  }
+  fprintf(file, "trilby_response_seconds_count %d\n", stats.responses);
+  fprintf(file, "# HELP trilby_turnaround_seconds Time from arrival to termination.\n# TYPE trilby_turnaround_seconds summary\n");
+  for(int q = 0; q < 3; q++) {
+    fprintf(file, "trilby_turnaround_seconds{quantile=\"%s\"} %.9f\n", quantiles[q], stats.turnaround[q] / 1e9);
+  }
+  fprintf(file, "trilby_turnaround_seconds_count %d\n", stats.turnarounds);
+
+  // Per-process series, labelled by PID and command (label values escape \ " and newline)
+  fprintf(file, "# HELP trilby_process_cpu_seconds CPU time used by a process.\n# TYPE trilby_process_cpu_seconds counter\n");
+  fprintf(file, "# HELP trilby_process_wait_seconds Time a process spent Ready.\n# TYPE trilby_process_wait_seconds counter\n");
+  fprintf(file, "# HELP trilby_process_run_seconds Time a process held a CPU.\n# TYPE trilby_process_run_seconds counter\n");
+  for(int i = 0; i < stats.count; i++) {
+    Cs_sample_s *sample = &stats.samples[i];
+    char label[sizeof(sample->cmd) * 2] = "";
+    int used = 0;
+    for(const char *c = sample->cmd; *c; c++) {
+      if(*c == '\\' || *c == '"' || *c == '\n') {
+        label[used++] = '\\';
+      }
+      label[used++] = (*c == '\n') ? 'n' : *c;
+    }
+    label[used] = '\0';
+    fprintf(file, "trilby_process_cpu_seconds{pid=\"%d\",cmd=\"%s\",state=\"%c\"} %.9f\n", sample->pid, label, sample->state, sample->cpu_ns / 1e9);
+    fprintf(file, "trilby_process_wait_seconds{pid=\"%d\",cmd=\"%s\",state=\"%c\"} %.9f\n", sample->pid, label, sample->state, sample->wait_ns / 1e9);
+    fprintf(file, "trilby_process_run_seconds{pid=\"%d\",cmd=\"%s\",state=\"%c\"} %.9f\n", sample->pid, label, sample->state, sample->run_ns / 1e9);
+  }
+  free(stats.samples);
+
+  if(fclose(file) != 0 || rename(tmp_path, path) != 0) {
+    unlink(tmp_path);
+    return -1;
+  }
+  return 0;
+}
+
+/* Stats Thread Function: rewrites STATS_FILE every STATS_INTERVAL_USEC until the CS System shuts down.
+ * - Sleeps on the Run Gate's cs_cv, so the shutdown broadcast in cs_cleanup wakes it at once.
+ */
+static void *cs_stats_thread(void *args) {
+  int warned = 0;
+  sigset_t mask;
+
+  // Like the dispatchers, this thread leaves the asynchronous signals to the shell thread.
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigaddset(&mask, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  while(1) {
+    long long deadline_ns = monotonic_ns() + STATS_INTERVAL_USEC * 1000LL;
+    struct timespec deadline = {deadline_ns / 1000000000LL, deadline_ns % 1000000000LL};
+    int done = 0;
+
+    pthread_mutex_lock(&cs_cv_m);
+    while(cs_do_cs == CS_RUN && monotonic_ns() < deadline_ns) {
+      pthread_cond_timedwait(&cs_cv, &cs_cv_m, &deadline);
+    }
+    done = (cs_do_cs != CS_RUN);
+    pthread_mutex_unlock(&cs_cv_m);
+    if(stats_write(STATS_FILE) == -1 && !warned) {
+      PRINT_WARNING("Could not write the statistics to %s", STATS_FILE);
+      warned = 1;
+    }
+    if(done) {
+      break; // One final write on the way out, so the file covers the whole run
+    }
+  }
+  return NULL;
+}
+
+/* Switches every CPU's schedule to a policy, given by name or as a shared object path.
+ * - A spec containing a '/' that isn't registered yet is loaded with hake_load_policy.
+ * - Ready processes move over to the new policy with their ages; nothing else is touched.
+ */
+void cs_set_policy(const char *spec) {
+  const Hake_policy_s *policy = hake_get_policy(spec);
+
+  if(policy == NULL && strchr(spec, '/') != NULL) {
+    policy = hake_load_policy(spec);
+  }
+  if(policy == NULL) {
+    PRINT_WARNING("Unknown policy %s (use 'policy' to list them, or give a path like ./hake_policy_fifo.so)", spec);
+    return;
+  }
+
+  for(int i = 0; i < num_cpus; i++) {
+    sigset_t old_mask;
+    cpu_lock(&cpus[i], &old_mask);
+    if(hake_set_policy(cpus[i].schedule, policy) == -1) {
+      PRINT_WARNING("CPU %d could not switch to policy %s, keeping %s", i, policy->name, cpus[i].schedule->policy->name);
+    }
+    cpu_unlock(&cpus[i], &old_mask);
+  }
+  PRINT_STATUS("Scheduling Policy is now %s", policy->name);
+}
+
+/* Lists the registered policies, marking the one in use */
+void print_cs_policies() {
+  const Hake_policy_s *current = cpus[0].schedule->policy;
+  const Hake_policy_s *policy = NULL;
+
+  PRINT_STATUS("Scheduling Policies (load more with: policy ./file.so)");
+  for(int i = 0; (policy = hake_get_policy_at(i)) != NULL; i++) {
+    PRINT_STATUS("...%s %s", policy == current ? "*" : " ", policy->name);
+  }
+}
+
 /* Set the time for each process to run for (Quantum) */
 void set_run_usec(useconds_t time) {
   sleep_usec_time = time;
@@ -378,12 +1772,44 @@ useconds_t get_between_usec() {
   return between_usec_time;
 }
 
-/* Accessor for the process currently on the CPU */
-Hake_process_s *get_on_cpu() {
-  return on_cpu;
+/* Set whether dispatch is pipelined (1) or waits the between time after every quantum (0) */
+void set_dispatch_pipelined(int pipelined) {
+  __atomic_store_n(&dispatch_pipelined, pipelined ? 1 : 0, __ATOMIC_RELAXED);
+  PRINT_STATUS("Setting CS System: %s dispatch", pipelined ? "pipelined" : "delayed");
+}
+
+/* Get whether dispatch is pipelined */
+int get_dispatch_pipelined() {
+  return __atomic_load_n(&dispatch_pipelined, __ATOMIC_RELAXED);
+}
+
+/* Set how often the running child is checked for blocking (0 turns early slice ends off) */
+void set_block_poll_usec(useconds_t time) {
+  __atomic_store_n(&block_poll_usec, time, __ATOMIC_RELAXED);
+  if(time == 0) {
+    PRINT_STATUS("Setting CS System: slices always run their full quantum");
+  }
+  else {
+    PRINT_STATUS("Setting CS System: slices end early when the process blocks, checked every %d usec", time);
+  }
+}
+
+/* Get how often the running child is checked for blocking */
+useconds_t get_block_poll_usec() {
+  return __atomic_load_n(&block_poll_usec, __ATOMIC_RELAXED);
+}
+
+/* Accessor for the number of CPUs in the CS system */
+int get_num_cpus() {
+  return num_cpus;
+}
+
+/* Accessor for the process currently on a CPU */
+Hake_process_s *get_on_cpu(int cpu) {
+  return (cpu >= 0 && cpu < num_cpus) ? cpus[cpu].on_cpu : NULL;
 }
 
-/* Accessor for the local schedule copy */
-Hake_schedule_s *get_schedule() {
-  return schedule;
+/* Accessor for a CPU's local schedule */
+Hake_schedule_s *get_schedule(int cpu) {
+  return (cpu >= 0 && cpu < num_cpus) ? cpus[cpu].schedule : NULL;
 }
@@ -0,0 +1,112 @@
+/* vm_record.c (Trilby VM Session Recorder)
+ *
+ *   Events are appended to one buffered file under a mutex.  The SIGCHLD and SIGINT handlers
+ *   record too (exits, and Ctrl-C toggling the CS system), so signals are blocked while the
+ *   mutex is held: a handler can never interrupt the thread that holds it.
+ *   Recording is off unless record_open was called, and then costs one small fwrite per event.
+ */
+
+/* Standard Library Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+/* Linux System API Includes */
+#include <signal.h>
+#include <pthread.h>
+/* Local Includes */
+#include "vm_support.h"
+#include "vm_record.h"
+
+/* Globals (static means it's private to this file only) */
+static FILE *record_file = NULL;       // Open recording, or NULL when not recording
+static long long record_start_ns = 0;  // Monotonic time the recording began
+static pthread_mutex_t record_m = PTHREAD_MUTEX_INITIALIZER;
+
+/* Local Prototypes */
+static void record_lock(sigset_t *old_mask);
+static void record_unlock(sigset_t *old_mask);
+
+/* Locks the recording with every signal blocked (restored by record_unlock). */
+static void record_lock(sigset_t *old_mask) {
+  sigset_t all;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, old_mask);
+  pthread_mutex_lock(&record_m);
+}
+
+/* Unlocks the recording and restores the signal mask. */
+static void record_unlock(sigset_t *old_mask) {
+  pthread_mutex_unlock(&record_m);
+  pthread_sigmask(SIG_SETMASK, old_mask, NULL);
+}
+
+/* Starts recording to path (replacing the file); the caller then records RECORD_BEGIN.
+ * Returns 0 on success or -1 if the file could not be created.
+ */
+int record_open(const char *path) {
+  sigset_t old_mask;
+  FILE *file = fopen(path, "wb");
+
+  if(file == NULL) {
+    return -1;
+  }
+  if(fwrite(RECORD_MAGIC, 1, RECORD_MAGIC_LEN, file) != RECORD_MAGIC_LEN) {
+    fclose(file);
+    return -1;
+  }
+  record_lock(&old_mask);
+  record_start_ns = monotonic_ns();
+  record_file = file;
+  record_unlock(&old_mask);
+  return 0;
+}
+
+/* Records one event (dropped if not recording).
+ * - text may be NULL; it is cut at 65535 bytes.
+ * - Shell commands are flushed at once, so a crash loses at most the events since the last one.
+ */
+void record_event(int type, pid_t pid, int arg, int arg2, long long value, long long value2, const char *text) {
+  Record_event_s event;
+  size_t len = (text != NULL) ? strlen(text) : 0;
+  sigset_t old_mask;
+
+  if(__atomic_load_n(&record_file, __ATOMIC_ACQUIRE) == NULL) {
+    return;
+  }
+  memset(&event, 0, sizeof(event)); // Padding is written too, so keep it deterministic
+  event.value = value;
+  event.value2 = value2;
+  event.pid = pid;
+  event.arg = arg;
+  event.arg2 = arg2;
+  event.type = (unsigned short)type;
+  event.len = (unsigned short)(len > 65535 ? 65535 : len);
+
+  record_lock(&old_mask);
+  if(record_file != NULL) {
+    event.ns = monotonic_ns() - record_start_ns; // Stamped under the lock, so the file stays in time order
+    fwrite(&event, sizeof(event), 1, record_file);
+    if(event.len > 0) {
+      fwrite(text, 1, event.len, record_file);
+    }
+    if(type == RECORD_COMMAND) {
+      fflush(record_file);
+    }
+  }
+  record_unlock(&old_mask);
+}
+
+/* Stops recording and closes the file (safe to call when not recording). */
+void record_close() {
+  sigset_t old_mask;
+
+  record_lock(&old_mask);
+  if(record_file != NULL) {
+    if(fclose(record_file) != 0) {
+      PRINT_WARNING("Could not finish writing the recording.");
+    }
+    record_file = NULL;
+  }
+  record_unlock(&old_mask);
+}
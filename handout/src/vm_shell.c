@@ -23,18 +23,20 @@
 #include "vm_process.h"
 #include "vm_printing.h"
 #include "vm_cs.h"
+#include "vm_trace.h"
+#include "vm_record.h"
 
 /* Local Definitions */
 
 /* Built-In Commands */
 enum builtin_commands {
   QUIT, EXIT, HELP, DEBUG, START, STOP, SUSPEND, RESUME,
-  SCHEDULE, STATUS, TERMINATE, DELAYTIME, RUNTIME,
+  SCHEDULE, STATUS, TERMINATE, DELAYTIME, RUNTIME, POLICY, DISPATCH, BLOCKPOLL, STATS, TRACE,
   NUM_BUILTINS
 };
 static char *builtin_commands[] = {
   "quit", "exit", "help", "debug", "start", "stop", "suspend", "resume", 
-  "schedule", "status", "terminate", "delaytime", "runtime"
+  "schedule", "status", "terminate", "delaytime", "runtime", "policy", "dispatch", "blockpoll", "stats", "trace"
 };
 
 /* Local Prototypes */
@@ -49,6 +51,10 @@ static void run_resume(Process_data_s *data);
 static void run_terminate(Process_data_s *data);
 static void run_delaytime(Process_data_s *data);
 static void run_runtime(Process_data_s *data);
+static void run_policy(Process_data_s *data);
+static void run_dispatch(Process_data_s *data);
+static void run_blockpoll(Process_data_s *data);
+static void run_trace(Process_data_s *data);
 static void execute_command(Process_data_s *data);
 static int builtin_string_to_enum(char *str);
 static int is_builtin(char *str);
@@ -88,6 +94,9 @@ void shell() {
         ABORT_ERROR("Error on getting user input.");
       }
     } while(ret != 0);
+    if(!is_whitespace(buffer)) {
+      record_event(RECORD_COMMAND, 0, 0, 0, 0, 0, buffer);
+    }
 
     // Step 2: Parse the User Input
     proc_data = parse_input(buffer);
@@ -137,11 +146,16 @@ static void execute_builtin(Process_data_s *data) {
     case STOP:  run_stop();               break;
     case SUSPEND: run_suspend(data);      break;
     case RESUME: run_resume(data);        break;
-    case SCHEDULE: print_schedule(get_schedule(), get_on_cpu()); break; // Self-contained action.
+    case SCHEDULE: print_cs_schedule();   break; // Self-contained action.
     case STATUS: print_cs_status();       break; // Self-contained action.
     case TERMINATE: run_terminate(data);  break;
     case DELAYTIME: run_delaytime(data);  break;
     case RUNTIME: run_runtime(data);      break;
+    case POLICY: run_policy(data);        break;
+    case DISPATCH: run_dispatch(data);    break;
+    case BLOCKPOLL: run_blockpoll(data);  break;
+    case STATS: print_cs_stats();         break; // Self-contained action.
+    case TRACE: run_trace(data);          break;
     default: // This should never happen, but if it does, assume user entered something wrong.
       print_help();   
   }
@@ -212,6 +226,7 @@ static void run_terminate(Process_data_s *data) {
 
   // Terminate the Process immediately (if PID is valid)
   if(pid > 1) {
+    record_event(RECORD_TERMINATE, pid, 0, 0, 0, 0, NULL);
     kill(pid, SIGKILL);
   }
   else {
@@ -250,11 +265,11 @@ static void run_delaytime(Process_data_s *data) {
 
   // Set the runtime if valid
   if(time >= BETWEEN_MIN_USEC && time <= BETWEEN_MAX_USEC) {
-    set_run_usec(time);
+    set_between_usec(time);
   }
   // If 0 was given, reset to the default value
   else if(time == 0) {
-    set_run_usec(BETWEEN_USEC);
+    set_between_usec(BETWEEN_USEC);
   }
   // Otherwise, provide the user some help.
   else {
@@ -266,6 +281,87 @@ static void run_delaytime(Process_data_s *data) {
   }
 }
 
+/* Handle the built-in for POLICY (list the policies, or switch every CPU to one) */
+static void run_policy(Process_data_s *data) {
+  // With no argument, just show what is available
+  if(data->argv[1] == NULL) {
+    print_cs_policies();
+    return;
+  }
+
+  // Switch to a registered policy by name, or load one from a shared object (eg. ./hake_policy_fifo.so)
+  cs_set_policy(data->argv[1]);
+}
+
+/* Handle the built-in for DISPATCH (show, or choose pipelined or delayed switching) */
+static void run_dispatch(Process_data_s *data) {
+  if(data->argv[1] == NULL) {
+    PRINT_STATUS("Dispatch is %s", get_dispatch_pipelined() ? "pipelined" : "delayed");
+  }
+  else if(strcmp(data->argv[1], "pipelined") == 0) {
+    set_dispatch_pipelined(1);
+  }
+  else if(strcmp(data->argv[1], "delayed") == 0) {
+    set_dispatch_pipelined(0);
+  }
+  else {
+    PRINT_WARNING("Dispatch is either pipelined or delayed.\n\teg. dispatch delayed");
+  }
+}
+
+/* Handle the built-in for BLOCKPOLL (show, or set how often the running process is checked for blocking) */
+static void run_blockpoll(Process_data_s *data) {
+  suseconds_t time = 0;
+
+  if(data->argv[1] == NULL) {
+    PRINT_STATUS("Block polling is %s (every %d usec)", get_block_poll_usec() ? "on" : "off", get_block_poll_usec());
+    return;
+  }
+  if(strcmp(data->argv[1], "off") == 0) {
+    set_block_poll_usec(0);
+    return;
+  }
+  time = extract_time(data->argv[1]);
+  // Set the interval if valid
+  if(time >= BLOCK_POLL_MIN_USEC && time <= BLOCK_POLL_MAX_USEC) {
+    set_block_poll_usec(time);
+  }
+  // If 0 was given, reset to the default value
+  else if(time == 0) {
+    set_block_poll_usec(BLOCK_POLL_USEC);
+  }
+  // Otherwise, provide the user some help.
+  else {
+    PRINT_WARNING("You need a valid time in usec, 0 for Default, or off.\n\teg. blockpoll %d", BLOCK_POLL_USEC);
+    PRINT_INFO("The minimum interval allowed is %d usec", BLOCK_POLL_MIN_USEC);
+    PRINT_INFO("The maximum interval allowed is %d usec", BLOCK_POLL_MAX_USEC);
+    PRINT_INFO("The current interval is %d usec", get_block_poll_usec());
+  }
+}
+
+/* Handle the built-in for TRACE (show the rings, write them out as Chrome JSON, or start over) */
+static void run_trace(Process_data_s *data) {
+  int count = 0;
+
+  if(data->argv[1] == NULL) {
+    print_trace_status();
+  }
+  else if(strcmp(data->argv[1], "dump") == 0 && data->argv[2] != NULL) {
+    count = trace_dump(data->argv[2]);
+    if(count == -1) {
+      PRINT_WARNING("Could not write the trace to %s", data->argv[2]);
+      return;
+    }
+    PRINT_STATUS("Wrote %d events to %s (open it in https://ui.perfetto.dev)", count, data->argv[2]);
+  }
+  else if(strcmp(data->argv[1], "clear") == 0) {
+    trace_clear();
+  }
+  else {
+    PRINT_WARNING("Trace takes dump <file> or clear.\n\teg. trace dump trilby_trace.json");
+  }
+}
+
 /* Executes a local (or /usr/bin) command */
 static void execute_command(Process_data_s *data) {
   // Creates the process and loads it into the Ready Queue
@@ -388,6 +484,9 @@ static void print_process_data(Process_data_s *data) {
   PRINT_DEBUG( "| - [CMD: %s]", data->cmd);
   PRINT_DEBUG( "| - [Priority: %d]", data->priority_level);
   PRINT_DEBUG( "| - [Is Critical: %s]", data->is_critical?"Yes":"No");
+  if(data->deadline_ns > 0) {
+    PRINT_DEBUG( "| - [Deadline: %lld usec, Runtime: %lld usec]", data->deadline_ns / 1000, data->runtime_ns / 1000);
+  }
   for(int i = 0; i < MAX_ARGS && data->argv[i] != NULL; i++) {
     PRINT_DEBUG( "| - [Arg %2d: %s]", i, data->argv[i]);
   }
@@ -433,6 +532,8 @@ static Process_data_s *parse_input(char *str) {
   int arg = 1;
   data->is_critical = 0;  // Without -c, non-critical process
   data->priority_level = DEFAULT_PRIORITY; // Without -p #, will be default
+  data->deadline_ns = 0;  // Without -d, no deadline
+  data->runtime_ns = 0;   // Without -e, the runtime quantum is expected per deadline
 
   // Iterate through all input tokens to perform the population
   do {
@@ -453,7 +554,29 @@ static Process_data_s *parse_input(char *str) {
         else if(data->priority_level > MAX_PRIORITY) {
           data->priority_level = MAX_PRIORITY;
         }
-      }      
+      }
+      // Look for the deadline (-d) and expected runtime (-e) flags, eg. -d 500ms -e 100ms
+      else if(strcmp(p_tok, "-d") == 0 || strcmp(p_tok, "-e") == 0) {
+        char *p_flag = p_tok;
+        long long duration = 0;
+        p_tok = strtok(NULL, " ");
+        duration = extract_duration(p_tok, NULL);
+        // Without a duration after it, the flag is the command's own (eg. echo -e hi)
+        if(duration <= 0) {
+          data->argv[arg++] = p_flag;
+          if(p_tok != NULL) {
+            data->argv[arg++] = p_tok;
+          }
+        }
+        else if(p_flag[1] == 'd') {
+          // Deadlines are only scheduled for Critical processes
+          data->deadline_ns = duration;
+          data->is_critical = 1;
+        }
+        else {
+          data->runtime_ns = duration;
+        }
+      }
       // Must be an argument if not a flag, so add it to the list of args
       else {
         data->argv[arg++] = p_tok; // All pointers reference data->input_toks
@@ -462,6 +585,22 @@ static Process_data_s *parse_input(char *str) {
     // Repeat until we're out of tokens (words) the user entered
   } while(p_tok != NULL);
 
+  // An expected runtime only means something per deadline
+  if(data->runtime_ns > 0 && data->deadline_ns == 0) {
+    PRINT_WARNING("Ignoring -e without -d (eg. -d 500ms -e 100ms)");
+    data->runtime_ns = 0;
+  }
+  // Each job has to fit in its deadline (without -e, the job is one runtime quantum)
+  if(data->deadline_ns > 0) {
+    long long runtime_ns = (data->runtime_ns > 0) ? data->runtime_ns : get_run_usec() * 1000LL;
+    if(runtime_ns > data->deadline_ns) {
+      PRINT_WARNING("The expected runtime (%lld usec%s) can't be longer than the deadline (%lld usec)",
+          runtime_ns / 1000, (data->runtime_ns > 0) ? "" : ", the runtime quantum", data->deadline_ns / 1000);
+      free_data_proc(data);
+      return NULL;
+    }
+  }
+
   return data;
 }
 
@@ -508,12 +647,18 @@ static void print_help() {
   PRINT_STATUS( "| start       Starts the CS Engine.");
   PRINT_STATUS( "| stop        Stops the CS Engine.");
   PRINT_STATUS( "| Ctrl-C      Toggle (Start/Stop) the CS Engine.");
-  PRINT_STATUS( "| schedule    Prints out the Current State of all Queues.");
+  PRINT_STATUS( "| schedule    Prints out the Current State of all Queues on every CPU.");
   PRINT_STATUS( "| terminate X Terminate Process with PID X.");
   PRINT_STATUS( "| status      Prints out the Current Settings.");
+  PRINT_STATUS( "| stats       Prints CPU, wait, and turnaround accounting, with percentiles.");
   PRINT_STATUS( "| debug       Toggles Debug Information.");
-  PRINT_STATUS( "| runtime X   Sets the runtime to X usec.");
-  PRINT_STATUS( "| delaytime X Sets the delaytime to X usec.");
+  PRINT_STATUS( "| runtime X   Sets the runtime to X usec (where adaptive quanta start).");
+  PRINT_STATUS( "| delaytime X Sets the delaytime to X usec (used by delayed dispatch).");
+  PRINT_STATUS( "| dispatch [M] Shows, or sets M to pipelined (no delay) or delayed (debugging).");
+  PRINT_STATUS( "| blockpoll [X] Shows, or checks for blocking every X usec (off runs full quanta).");
+  PRINT_STATUS( "| policy [P]  Lists the Policies, or switches to P (a name or ./file.so).");
+  PRINT_STATUS( "| trace [dump F|clear] Shows the event trace, writes it to F as Chrome JSON, or clears it.");
+  PRINT_STATUS( "| cmd -d D -e E  Runs cmd Critical with E runtime due every D (eg. -d 500ms -e 100ms).");
   PRINT_STATUS( "| quit        Exits TRILBY-VM.");
   PRINT_STATUS( "+------------------");
   }
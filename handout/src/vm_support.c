@@ -9,6 +9,8 @@
 /* Standard Library Includes */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 /* Linux System API Includes */
 #include <signal.h>
 #include <unistd.h>
@@ -120,7 +122,7 @@ void print_schedule(Hake_schedule_s *schedule, Hake_process_s *on_cpu) {
   // Ready Queue
   count = hake_get_count(schedule->ready_queue);
   PRINT_STATUS("...[Ready Queue      - %2d Process%s]", count, count==1?"":"es");
-  print_hake_queue(schedule->ready_queue);
+  print_hake_ready(schedule);
   // Suspended Queue
   count = hake_get_count(schedule->suspended_queue);
   PRINT_STATUS("...[Suspended Queue  - %2d Process%s]", count, count==1?"":"es");
@@ -129,6 +131,11 @@ void print_schedule(Hake_schedule_s *schedule, Hake_process_s *on_cpu) {
   count = hake_get_count(schedule->terminated_queue);
   PRINT_STATUS("...[Terminated Queue - %2d Process%s]", count, count==1?"":"es");
   print_hake_queue(schedule->terminated_queue);
+  if(schedule->archive != NULL && schedule->archive->archived > 0) {
+    PRINT_STATUS("     ... plus %d older Process%s %s %s", schedule->archive->archived,
+        schedule->archive->archived==1?"":"es", schedule->archive->log?"archived to":"dropped",
+        schedule->archive->log?schedule->archive->path:"(no archive)");
+  }
 }
 
 /* Prints a single Scheduler Queue */
@@ -146,6 +153,17 @@ void print_hake_queue(Hake_queue_s *queue) {
   }
 }
 
+/* Prints the Ready Queue in selection order (Critical, Starving, then by Priority) */
+void print_hake_ready(Hake_schedule_s *schedule) {
+  // Iterate the ready engine lanes and print each process
+  Hake_process_s *walker = hake_ready_first(schedule);
+  while(walker != NULL) {
+    hake_get_age(schedule, walker); // Ready ages are lazy, refresh before printing
+    print_process_node(walker);
+    walker = hake_ready_next(schedule, walker);
+  }
+}
+
 // Prints a schedule tracked process
 void print_process_node(Hake_process_s *node) {
   // If no process exists, print nothing.
@@ -176,4 +194,62 @@ void print_process_node(Hake_process_s *node) {
         ((node->state>>27)&1)?'C':' ',
         node->age);
   }
+  // Processes that have run show the CPU time they really used, and the quantum adapted to them
+  if(node->runs > 0 && !((node->state >> 28)&1)) {
+    PRINT_STATUS("     %17s CPU: %lld.%03lld sec (%lld usec in its last slice), Quantum: %lld usec", "",
+        node->cpu_ns / 1000000000LL, node->cpu_ns / 1000000LL % 1000,
+        node->slice_cpu_ns > 0 ? node->slice_cpu_ns / 1000 : 0, node->quantum_ns / 1000);
+  }
+  // Deadline (EDF) processes also show their timing and how many deadlines they have missed
+  if(node->deadline_ns > 0) {
+    PRINT_STATUS("     %17s EDF: runtime %lld usec every %lld usec, Deadline Misses: %d", "",
+        node->runtime_ns / 1000, node->deadline_ns / 1000, node->deadline_misses);
+  }
+}
+
+/* Returns the monotonic clock time in nanoseconds (the clock the dispatchers use). */
+long long monotonic_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/* Converts a duration with an optional unit (ns, us, ms, s; ms if none) to nanoseconds.
+ * - If end is given, parsing stops at the first character after the unit, which is stored there.
+ * Returns the duration or -1 on any error.
+ */
+long long extract_duration(const char *str, char **end) {
+  char *p_unit = NULL;
+  long long scale = 1000000LL; // Milliseconds by default
+  long long value = 0;
+
+  if(str == NULL) {
+    return -1;
+  }
+  value = strtoll(str, &p_unit, 10);
+  if(p_unit == str || value < 0) {
+    return -1;
+  }
+  if(strncmp(p_unit, "ns", 2) == 0) {
+    scale = 1;
+    p_unit += 2;
+  }
+  else if(strncmp(p_unit, "us", 2) == 0) {
+    scale = 1000LL;
+    p_unit += 2;
+  }
+  else if(strncmp(p_unit, "ms", 2) == 0) {
+    p_unit += 2;
+  }
+  else if(*p_unit == 's') {
+    scale = 1000000000LL;
+    p_unit++;
+  }
+  if(end != NULL) {
+    *end = p_unit;
+  }
+  else if(*p_unit != '\0') {
+    return -1;
+  }
+  return value * scale;
 }
@@ -0,0 +1,335 @@
+/* vm_trace.c (Trilby VM Scheduler Event Trace)
+ *
+ *   Every thread that records gets its own ring of TRACE_RING_EVENTS fixed-size events, so
+ *   recording takes no locks and no shared writes: fill the next slot, then publish it by
+ *   bumping the ring's head.  Once a ring is full, the oldest events are overwritten.
+ *
+ *   Dumping copies each ring without stopping its writer, then drops whatever the writer may
+ *   have overwritten during the copy (a ring never holds more than its last TRACE_RING_EVENTS).
+ *   The events are then turned into Chrome trace JSON: a track per process showing when it was
+ *   Ready, Running, and Suspended, and a track per CPU showing what it ran and when it was idle.
+ */
+
+/* Standard Library Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+/* Local Includes */
+#include "vm_settings.h"
+#include "vm_support.h"
+#include "vm_trace.h"
+
+#if (TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1)) != 0
+#error "TRACE_RING_EVENTS must be a power of 2"
+#endif
+
+// One thread's ring of events
+typedef struct trace_ring {
+  unsigned long long head;                  // Events ever recorded (only the owning thread writes it)
+  Trace_event_s events[TRACE_RING_EVENTS];  // Event n is in slot n % TRACE_RING_EVENTS
+} Trace_ring_s;
+
+/* Globals (static means it's private to this file only) */
+static Trace_ring_s *trace_rings[TRACE_MAX_RINGS]; // Published with a release store, once each
+static int trace_num_rings = 0;                    // Slots of trace_rings claimed so far
+static long long trace_since_ns = 0;               // Events before this are left out of dumps (trace clear)
+static __thread Trace_ring_s *trace_ring = NULL;   // This thread's ring
+static __thread int trace_ringless = 0;            // 1 if this thread could not get a ring (its events are dropped)
+
+static const char *trace_names[NUM_TRACE_EVENTS] = {
+  "insert", "select", "suspend", "resume", "exit", "terminate", "SIGCONT", "SIGTSTP", "idle", "wake"
+};
+
+/* Local Prototypes */
+static Trace_ring_s *trace_register();
+static int trace_collect(Trace_event_s **events);
+static int trace_by_pid(const void *a, const void *b);
+static int trace_by_cpu(const void *a, const void *b);
+static void trace_json_span(FILE *file, int *written, const char *name, int track, int tid, long long start_ns,
+    long long end_ns, long long base_ns);
+static void trace_json_instant(FILE *file, int *written, Trace_event_s *event, long long base_ns);
+
+/* Claims and allocates a ring for the calling thread.
+ * Returns the ring, or NULL if all TRACE_MAX_RINGS are taken (or out of memory).
+ */
+static Trace_ring_s *trace_register() {
+  int slot = __atomic_fetch_add(&trace_num_rings, 1, __ATOMIC_RELAXED);
+  Trace_ring_s *ring = NULL;
+
+  if(slot >= TRACE_MAX_RINGS) {
+    return NULL;
+  }
+  ring = calloc(1, sizeof(Trace_ring_s));
+  __atomic_store_n(&trace_rings[slot], ring, __ATOMIC_RELEASE); // NULL leaves the slot unused
+  return ring;
+}
+
+/* Records one event on the calling thread's ring (lock-free, wait-free once the thread has a ring).
+ * - Rings live until the VM exits, since threads may still record while it shuts down.
+ */
+void trace_event(int type, int cpu, pid_t pid, int arg) {
+  Trace_ring_s *ring = trace_ring;
+  Trace_event_s *event = NULL;
+  unsigned long long head = 0;
+
+  if(ring == NULL) {
+    if(trace_ringless) {
+      return;
+    }
+    ring = trace_ring = trace_register();
+    if(ring == NULL) {
+      trace_ringless = 1;
+      return;
+    }
+  }
+  head = ring->head;
+  event = &ring->events[head & (TRACE_RING_EVENTS - 1)];
+  event->ns = monotonic_ns();
+  event->pid = pid;
+  event->arg = arg;
+  event->cpu = cpu;
+  event->type = type;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* Leaves everything recorded so far out of later dumps (the rings themselves are left to their writers). */
+void trace_clear() {
+  __atomic_store_n(&trace_since_ns, monotonic_ns(), __ATOMIC_RELAXED);
+}
+
+/* Copies the events of every ring (since the last trace clear) into a new array, sorted by time.
+ * - The caller frees *events.
+ * Returns the number of events, or -1 if out of memory.
+ */
+static int trace_collect(Trace_event_s **events) {
+  int rings = __atomic_load_n(&trace_num_rings, __ATOMIC_RELAXED);
+  long long since_ns = __atomic_load_n(&trace_since_ns, __ATOMIC_RELAXED);
+  int count = 0;
+
+  rings = (rings < TRACE_MAX_RINGS) ? rings : TRACE_MAX_RINGS;
+  *events = malloc((size_t)(rings ? rings : 1) * TRACE_RING_EVENTS * sizeof(Trace_event_s));
+  if(*events == NULL) {
+    return -1;
+  }
+  for(int r = 0; r < rings; r++) {
+    Trace_ring_s *ring = __atomic_load_n(&trace_rings[r], __ATOMIC_ACQUIRE);
+    unsigned long long head = 0;
+    unsigned long long first = 0;
+    unsigned long long valid = 0;
+    int copied = count;
+    if(ring == NULL) {
+      continue;
+    }
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    first = (head > TRACE_RING_EVENTS) ? head - TRACE_RING_EVENTS : 0;
+    for(unsigned long long n = first; n < head; n++) {
+      (*events)[count++] = ring->events[n & (TRACE_RING_EVENTS - 1)];
+    }
+    // The writer may have gone on while the ring was copied; the slots it reached (and the one
+    // it may be filling now) hold newer events than the copy thinks, so those are dropped.
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    valid = __atomic_load_n(&ring->head, __ATOMIC_RELAXED) + 1;
+    valid = (valid > TRACE_RING_EVENTS) ? valid - TRACE_RING_EVENTS : 0;
+    if(valid > first) {
+      unsigned long long lost = (valid < head ? valid : head) - first;
+      memmove(&(*events)[copied], &(*events)[copied + lost], (count - copied - lost) * sizeof(Trace_event_s));
+      count -= lost;
+    }
+    // And anything from before the last trace clear (a ring is in time order)
+    int kept = copied;
+    while(kept < count && (*events)[kept].ns < since_ns) {
+      kept++;
+    }
+    memmove(&(*events)[copied], &(*events)[kept], (count - kept) * sizeof(Trace_event_s));
+    count -= kept - copied;
+  }
+  return count;
+}
+
+/* Orders events by process, then time, for qsort. */
+static int trace_by_pid(const void *a, const void *b) {
+  const Trace_event_s *x = a;
+  const Trace_event_s *y = b;
+  if(x->pid != y->pid) {
+    return (x->pid > y->pid) - (x->pid < y->pid);
+  }
+  return (x->ns > y->ns) - (x->ns < y->ns);
+}
+
+/* Orders events by CPU, then time, for qsort. */
+static int trace_by_cpu(const void *a, const void *b) {
+  const Trace_event_s *x = a;
+  const Trace_event_s *y = b;
+  if(x->cpu != y->cpu) {
+    return (x->cpu > y->cpu) - (x->cpu < y->cpu);
+  }
+  return (x->ns > y->ns) - (x->ns < y->ns);
+}
+
+/* Writes one complete ("X") event: a named span on a track (Chrome pid) and row (Chrome tid). */
+static void trace_json_span(FILE *file, int *written, const char *name, int track, int tid, long long start_ns,
+    long long end_ns, long long base_ns) {
+  fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+      *written ? "," : "", name, track, tid, (start_ns - base_ns) / 1000.0, (end_ns - start_ns) / 1000.0);
+  (*written)++;
+}
+
+/* Writes one instant ("i") event on the row of the process it is about. */
+static void trace_json_instant(FILE *file, int *written, Trace_event_s *event, long long base_ns) {
+  fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+      "\"args\":{\"cpu\":%d,\"arg\":%d}}", *written ? "," : "", trace_names[event->type], event->pid,
+      (event->ns - base_ns) / 1000.0, event->cpu, event->arg);
+  (*written)++;
+}
+
+/* Writes the trace to path as Chrome trace JSON (open it in https://ui.perfetto.dev).
+ * - Track 1 (Processes) has a row per PID: Ready, Running, and Suspended spans, plus every event.
+ * - Track 0 (CPUs) has a row per CPU: a span for each process it ran, and its idle time.
+ * - Spans still open are drawn up to now.  Times are in usec from the first event.
+ * Returns the number of events dumped, or -1 on any error.
+ */
+int trace_dump(const char *path) {
+  Trace_event_s *events = NULL;
+  long long now_ns = monotonic_ns();
+  long long base_ns = 0;
+  int count = trace_collect(&events);
+  int written = 0;
+  FILE *file = NULL;
+
+  if(count == -1) {
+    return -1;
+  }
+  file = fopen(path, "w");
+  if(file == NULL) {
+    free(events);
+    return -1;
+  }
+  for(int i = 0; i < count; i++) {
+    if(base_ns == 0 || events[i].ns < base_ns) {
+      base_ns = events[i].ns;
+    }
+  }
+
+  fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  fprintf(file, "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPUs\"}}");
+  fprintf(file, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Processes\"}}");
+  written = 2;
+
+  // Process rows: a span for each state it was in, from the event that put it there to the one that ended it
+  qsort(events, count, sizeof(Trace_event_s), trace_by_pid);
+  for(int i = 0; i < count; ) {
+    pid_t pid = events[i].pid;
+    long long ready_ns = 0;
+    long long run_ns = 0;
+    long long suspended_ns = 0;
+    if(pid <= 0) {
+      i++;
+      continue;
+    }
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"PID %d\"}}", pid, pid);
+    written++;
+    for(; i < count && events[i].pid == pid; i++) {
+      Trace_event_s *event = &events[i];
+      trace_json_instant(file, &written, event, base_ns);
+      // Every event but a new run or insert ends the Ready span; only an insert or resume starts one
+      if(ready_ns && event->type != TRACE_SIGCONT && event->type != TRACE_INSERT) {
+        trace_json_span(file, &written, "Ready", 1, pid, ready_ns, event->ns, base_ns);
+        ready_ns = 0;
+      }
+      if(run_ns && (event->type == TRACE_SIGTSTP || event->type == TRACE_EXIT || event->type == TRACE_SIGCONT)) {
+        trace_json_span(file, &written, "Running", 1, pid, run_ns, event->ns, base_ns);
+        run_ns = 0;
+      }
+      if(suspended_ns && (event->type == TRACE_RESUME || event->type == TRACE_TERMINATE)) {
+        trace_json_span(file, &written, "Suspended", 1, pid, suspended_ns, event->ns, base_ns);
+        suspended_ns = 0;
+      }
+      if((event->type == TRACE_INSERT || event->type == TRACE_RESUME) && !ready_ns) {
+        ready_ns = event->ns;
+      }
+      else if(event->type == TRACE_SIGCONT) {
+        run_ns = event->ns;
+      }
+      else if(event->type == TRACE_SUSPEND) {
+        suspended_ns = event->ns;
+      }
+    }
+    if(ready_ns) {
+      trace_json_span(file, &written, "Ready", 1, pid, ready_ns, now_ns, base_ns);
+    }
+    if(run_ns) {
+      trace_json_span(file, &written, "Running", 1, pid, run_ns, now_ns, base_ns);
+    }
+    if(suspended_ns) {
+      trace_json_span(file, &written, "Suspended", 1, pid, suspended_ns, now_ns, base_ns);
+    }
+  }
+
+  // CPU rows: what ran there (SIGCONT until SIGTSTP or exit), and when it sat idle
+  qsort(events, count, sizeof(Trace_event_s), trace_by_cpu);
+  for(int i = 0; i < count; ) {
+    int cpu = events[i].cpu;
+    long long run_ns = 0;
+    long long idle_ns = 0;
+    pid_t running = 0;
+    char name[32];
+    if(cpu < 0) {
+      i++;
+      continue;
+    }
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"CPU %d\"}}", cpu, cpu);
+    written++;
+    for(; i < count && events[i].cpu == cpu; i++) {
+      Trace_event_s *event = &events[i];
+      if(run_ns && (event->type == TRACE_SIGCONT || event->type == TRACE_IDLE ||
+         ((event->type == TRACE_SIGTSTP || event->type == TRACE_EXIT) && event->pid == running))) {
+        snprintf(name, sizeof(name), "PID %d", running);
+        trace_json_span(file, &written, name, 0, cpu, run_ns, event->ns, base_ns);
+        run_ns = 0;
+      }
+      if(idle_ns && event->type == TRACE_WAKE) {
+        trace_json_span(file, &written, "Idle", 0, cpu, idle_ns, event->ns, base_ns);
+        idle_ns = 0;
+      }
+      if(event->type == TRACE_SIGCONT) {
+        run_ns = event->ns;
+        running = event->pid;
+      }
+      else if(event->type == TRACE_IDLE) {
+        idle_ns = event->ns;
+      }
+    }
+    if(run_ns) {
+      snprintf(name, sizeof(name), "PID %d", running);
+      trace_json_span(file, &written, name, 0, cpu, run_ns, now_ns, base_ns);
+    }
+    if(idle_ns) {
+      trace_json_span(file, &written, "Idle", 0, cpu, idle_ns, now_ns, base_ns);
+    }
+  }
+  fprintf(file, "\n]}\n");
+  free(events);
+  if(fclose(file) != 0) {
+    return -1;
+  }
+  return count;
+}
+
+/* Prints how much each thread's ring has recorded */
+void print_trace_status() {
+  int rings = __atomic_load_n(&trace_num_rings, __ATOMIC_RELAXED);
+
+  rings = (rings < TRACE_MAX_RINGS) ? rings : TRACE_MAX_RINGS;
+  PRINT_STATUS("Trace: %d ring%s of %d events (%d bytes each)", rings, rings==1?"":"s", TRACE_RING_EVENTS,
+      (int)sizeof(Trace_event_s));
+  for(int r = 0; r < rings; r++) {
+    Trace_ring_s *ring = __atomic_load_n(&trace_rings[r], __ATOMIC_ACQUIRE);
+    unsigned long long head = 0;
+    if(ring == NULL) {
+      continue;
+    }
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    PRINT_STATUS("...Ring %d: %llu recorded, %llu kept", r, head, head < TRACE_RING_EVENTS ? head : TRACE_RING_EVENTS);
+  }
+}